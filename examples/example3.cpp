@@ -0,0 +1,169 @@
+/*
+    src/example3.cpp -- C++ example application that draws one million
+    instanced quads with a single draw call
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/screen.h>
+#include <nanogui/window.h>
+#include <nanogui/layout.h>
+#include <nanogui/label.h>
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <nanogui/glutil.h>
+#include <iostream>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+
+class InstancingApplication : public nanogui::Screen {
+public:
+    InstancingApplication() : nanogui::Screen(nanogui::Vector2i(1024, 768), "NanoGUI Instancing") {
+        using namespace nanogui;
+
+        mShader.init(
+            "instanced_quads",
+
+            /* Vertex shader: 'corner' advances per vertex, 'offset' and
+               'color' advance once per instance */
+            "#version 330\n"
+            "uniform vec2 scale;\n"
+            "uniform float time;\n"
+            "in vec2 corner;\n"
+            "in vec2 offset;\n"
+            "in vec4 color;\n"
+            "out vec4 frag_color;\n"
+            "void main() {\n"
+            "    float s = 0.35 + 0.15 * sin(time * 2.0 + offset.x * 9.0 + offset.y * 7.0);\n"
+            "    gl_Position = vec4((offset + corner * s * scale.y) * scale.x, 0.0, 1.0);\n"
+            "    frag_color = color;\n"
+            "}",
+
+            /* Fragment shader */
+            "#version 330\n"
+            "in vec4 frag_color;\n"
+            "out vec4 color;\n"
+            "void main() {\n"
+            "    color = frag_color;\n"
+            "}"
+        );
+
+        const int n = 1000;
+        mInstances = n * n;
+
+        std::vector<Vector2f> corners = {
+            Vector2f(-1, -1), Vector2f(1, -1), Vector2f(1, 1), Vector2f(-1, 1)
+        };
+        std::vector<uint32_t> indices = { 0, 1, 2, 2, 3, 0 };
+        std::vector<Vector2f> offsets((size_t) mInstances);
+        std::vector<uint8_t> colors(4 * (size_t) mInstances);
+
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                size_t i = (size_t) y * n + x;
+                offsets[i] = Vector2f((x + 0.5f) / n * 2.f - 1.f,
+                                      (y + 0.5f) / n * 2.f - 1.f);
+                colors[4 * i + 0] = (uint8_t) (x * 255 / (n - 1));
+                colors[4 * i + 1] = (uint8_t) (y * 255 / (n - 1));
+                colors[4 * i + 2] = 160;
+                colors[4 * i + 3] = 255;
+            }
+        }
+
+        mShader.bind();
+        mShader.uploadIndices(indices);
+        mShader.uploadAttrib("corner", corners);
+        mShader.uploadAttrib("offset", offsets, -1, 1);
+        mShader.uploadAttrib<uint8_t, 4>("color", colors, -1, 1);
+
+        mScale = mShader.uniformHandle<Vector2f>("scale");
+        mTime = mShader.uniformHandle<float>("time");
+    }
+
+    ~InstancingApplication() {
+        mShader.free();
+    }
+
+    int instances() const { return mInstances; }
+
+    virtual bool keyboardEvent(int key, int scancode, int action, int modifiers) {
+        if (Screen::keyboardEvent(key, scancode, action, modifiers))
+            return true;
+        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+            setVisible(false);
+            return true;
+        }
+        return false;
+    }
+
+    virtual void drawContents() {
+        using namespace nanogui;
+
+        mShader.bind();
+
+        /* Keep the quads square, with one quad per grid cell */
+        float aspect = (float) mSize.y / (float) mSize.x;
+        mShader.setUniform(mScale, Vector2f(0.95f, 1.f / 1000.f));
+        mShader.setUniform(mTime, (float) glfwGetTime());
+
+        glViewport(0, 0, mFBSize.x, mFBSize.y);
+        if (aspect < 1) {
+            int width = (int) (mFBSize.x * aspect);
+            glViewport((mFBSize.x - width) / 2, 0, width, mFBSize.y);
+        }
+
+        /* Two triangles per quad, one million quads, one draw call */
+        mShader.drawIndexedInstanced(GL_TRIANGLES, 0, 2, (uint32_t) mInstances);
+
+        glViewport(0, 0, mFBSize.x, mFBSize.y);
+    }
+
+private:
+    nanogui::GLShader mShader;
+    nanogui::GLShader::Uniform<nanogui::Vector2f> mScale;
+    nanogui::GLShader::Uniform<float> mTime;
+    int mInstances;
+};
+
+int main(int /* argc */, char ** /* argv */) {
+    try {
+        nanogui::init();
+
+        {
+            using namespace nanogui;
+
+            ref<InstancingApplication> app = makeref<InstancingApplication>();
+
+            ref<Window> window = makewidget<Window>(app, "Instancing");
+            window->setPosition(Vector2i(15, 15));
+            window->setLayout(makeref<GroupLayout>());
+            makewidget<Label>(window, std::to_string(app->instances()) +
+                              " quads in a single draw call");
+
+            app->performLayout();
+            app->drawAll();
+            app->setVisible(true);
+            nanogui::mainloop();
+        }
+
+        nanogui::shutdown();
+    } catch (const std::runtime_error &e) {
+        std::string error_msg = std::string("Caught a fatal error: ") + std::string(e.what());
+        #if defined(WIN32)
+            MessageBoxA(nullptr, error_msg.c_str(), NULL, MB_ICONERROR | MB_OK);
+        #else
+            cerr << error_msg << endl;
+        #endif
+        return -1;
+    }
+
+    return 0;
+}
@@ -48,6 +48,11 @@
 #    define NANOGUI_EXPORT
 #endif
 
+/* SIMD instruction sets available to vectorized kernels */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define NANOGUI_SSE2 1
+#endif
+
 #if defined(_WIN32)
 #if defined(NANOGUI_BUILD)
 /* Quench a few warnings on when compiling NanoGUI on Windows */
@@ -142,24 +147,45 @@ class CheckBox;
 class ColorWheel;
 class ColorPicker;
 class ComboBox;
+class GLBufferArena;
+class GLCanvas;
 class GLFramebuffer;
+class GLOffscreenTarget;
+class GLReadback;
+class GLReadbackRing;
+class GLRenderTarget;
+class GLRenderTargetPool;
 class GLShader;
+class GLShaderVariants;
+class GLTexture;
+class GLTimer;
+class GLUniformBuffer;
 class GridLayout;
 class GroupLayout;
+class Histogram;
+class ImageCache;
 class ImagePanel;
 class Label;
 class Layout;
 class MessageDialog;
 class Object;
+class Plot;
+class PlotData;
 class Popup;
 class PopupButton;
 class ProgressBar;
+class SampleRing;
+class ScatterPlot;
 class Screen;
+class ScreenRecorder;
 class Slider;
+class SparklineGrid;
 class TextBox;
 class Theme;
 class ToolButton;
+class VideoView;
 class VScrollPanel;
+class Waterfall;
 class Widget;
 class Window;
 
@@ -213,7 +239,7 @@ extern NANOGUI_EXPORT void chdir_to_bundle_parent();
  */
 extern NANOGUI_EXPORT std::array<char, 8> utf8(int c);
 
-/// Load a directory of PNG images and upload them to the GPU (suitable for use with ImagePanel)
+/// Load a directory of PNG images and upload them to the GPU (suitable for use with ImagePanel); they are pinned in the context's ImageCache
 extern NANOGUI_EXPORT std::vector<std::pair<int, std::string>>
     loadImageDirectory(NVGcontext *ctx, const std::string &path);
 
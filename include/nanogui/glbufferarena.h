@@ -0,0 +1,164 @@
+/*
+    nanogui/glbufferarena.h -- Sub-allocation of many small meshes from
+    shared vertex and index buffers
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/glutil.h>
+#include <map>
+#include <set>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Stores many small meshes in one interleaved vertex buffer and one
+ * index buffer
+ *
+ * Every mesh occupies a range of vertices and a range of indices, which are
+ * handed out by a best-fit free-list allocator that merges neighboring free
+ * ranges on release. Indices are relative to the first vertex of their mesh
+ * and drawn with base-vertex draw calls, so all meshes share a single vertex
+ * array object per shader and whole sets of meshes can be submitted with one
+ * \c glMultiDrawElementsBaseVertex() call. The vertex array object of a
+ * shader is deleted along with it (see \ref GLShader::free()).
+ *
+ * The buffers grow (on the GPU, using \c glCopyBufferSubData()) when a
+ * request does not fit, and \ref compact() removes the holes left by
+ * released meshes. Neither operation changes mesh handles.
+ */
+class NANOGUI_EXPORT GLBufferArena {
+public:
+    /// Description of one interleaved vertex attribute
+    struct Attribute {
+        std::string name;
+        GLint dim;
+        GLenum type;
+        bool normalized;
+
+        Attribute(const std::string &name, GLint dim, GLenum type = GL_FLOAT,
+                  bool normalized = false)
+            : name(name), dim(dim), type(type), normalized(normalized) { }
+    };
+
+    GLBufferArena() : mStride(0), mVertexBuffer(0), mIndexBuffer(0) { }
+
+    /// Stop tracking shaders (call \ref free() first to release the OpenGL objects)
+    ~GLBufferArena();
+
+    /// Create the buffers for the given vertex layout and initial capacities
+    void init(const std::vector<Attribute> &layout, uint32_t vertexCapacity = 1 << 16,
+              uint32_t indexCapacity = 3 << 16);
+
+    /// Release all buffers and vertex array objects
+    void free();
+
+    /// Return whether or not the arena has been initialized
+    bool ready() const { return mVertexBuffer != 0; }
+
+    /// Return the size of one interleaved vertex in bytes
+    uint32_t stride() const { return mStride; }
+
+    /// Reserve space for a mesh and return its handle
+    int allocate(uint32_t vertexCount, uint32_t indexCount);
+
+    /**
+     * \brief Upload the data of a mesh
+     *
+     * \c vertices holds \c vertexCount interleaved vertices and \c indices
+     * holds \c indexCount indices counted from the first vertex of the mesh.
+     */
+    void upload(int mesh, const void *vertices, const uint32_t *indices);
+
+    /// Return the space occupied by a mesh to the arena
+    void release(int mesh);
+
+    /// Move all meshes to the start of the buffers, removing any holes
+    void compact();
+
+    /// Select the shader and the arena's vertex array object for it
+    void bind(GLShader &shader);
+
+    /// Draw a single mesh (the arena must be bound)
+    void draw(int mesh, GLenum type = GL_TRIANGLES);
+
+    /// Draw a set of meshes with a single call (the arena must be bound)
+    void drawBatch(const std::vector<int> &meshes, GLenum type = GL_TRIANGLES);
+
+    /// Return the number of live meshes
+    size_t meshCount() const { return mMeshes.size() - mFreeHandles.size(); }
+
+    /// Return the number of vertices that fit into the vertex buffer
+    uint32_t vertexCapacity() const { return mVertices.capacity; }
+    /// Return the number of vertices occupied by live meshes
+    uint32_t vertexUsage() const { return mVertices.used; }
+
+    /// Return the number of indices that fit into the index buffer
+    uint32_t indexCapacity() const { return mIndices.capacity; }
+    /// Return the number of indices occupied by live meshes
+    uint32_t indexUsage() const { return mIndices.used; }
+
+    /// Return the fraction of free vertex space outside the largest free range
+    float fragmentation() const;
+
+    /// Delete the vertex array objects of all arenas for a shader that is being freed
+    static void releaseShader(const GLShader *shader);
+
+protected:
+    /// Best-fit allocator of ranges within [0, capacity)
+    struct RangeAllocator {
+        uint32_t capacity = 0, used = 0;
+        std::map<uint32_t, uint32_t> freeByOffset;
+        std::multimap<uint32_t, uint32_t> freeBySize;
+
+        void reset(uint32_t capacity, uint32_t used = 0);
+        bool allocate(uint32_t size, uint32_t &offset);
+        void release(uint32_t offset, uint32_t size);
+        void grow(uint32_t capacity);
+        uint32_t largestFree() const;
+    protected:
+        void insertFree(uint32_t offset, uint32_t size);
+        void eraseFree(std::map<uint32_t, uint32_t>::iterator it);
+    };
+
+    struct Mesh {
+        uint32_t vertexOffset, vertexCount;
+        uint32_t indexOffset, indexCount;
+        bool live;
+    };
+
+    /// Return the mesh for a handle, throwing if the handle is invalid
+    Mesh &mesh(int handle);
+
+    /// Replace a buffer by a larger one, preserving its contents
+    void growBuffer(GLuint &buffer, size_t oldSize, size_t newSize);
+
+    /// Delete all vertex array objects (they reference the old buffers)
+    void resetVertexArrays();
+
+protected:
+    std::vector<Attribute> mLayout;
+    std::vector<size_t> mOffsets;
+    uint32_t mStride;
+    GLuint mVertexBuffer, mIndexBuffer;
+    RangeAllocator mVertices, mIndices;
+    std::vector<Mesh> mMeshes;
+    std::vector<int> mFreeHandles;
+    /* Vertex array object per shader, with the program it was set up for */
+    std::map<const GLShader *, std::pair<GLuint, GLuint>> mVertexArrays;
+
+    /* Scratch space for batched draws */
+    std::vector<GLsizei> mBatchCounts;
+    std::vector<const void *> mBatchIndices;
+    std::vector<GLint> mBatchBaseVertices;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,94 @@
+/*
+    nanogui/glcanvas.h -- Widget that embeds custom OpenGL rendering
+    into the widget hierarchy
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
+#include <functional>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Displays OpenGL content rendered into an offscreen framebuffer
+ *
+ * The canvas renders into a render target of its screen's pool (see
+ * \ref Screen::renderTargetPool()) that matches its size in framebuffer
+ * pixels, and shows the result as an image within the regular NanoVG
+ * drawing order, so it is clipped and stacked like any other widget.
+ *
+ * \ref drawGL() (or the callback set with \ref setDrawCallback()) only
+ * runs after \ref invalidate() or a resize; otherwise drawing the canvas
+ * costs a single textured quad. When it runs, the framebuffer is bound,
+ * the viewport covers the canvas and the color (and depth) buffer has been
+ * cleared; blending, depth testing, face culling and the scissor test are
+ * disabled. The result is composited as premultiplied alpha. Changes of
+ * other OpenGL state need not be undone.
+ */
+class NANOGUI_EXPORT GLCanvas : public Widget {
+public:
+    GLCanvas(ref<Widget> parent);
+
+    /// Return the function that renders the contents
+    const std::function<void()> &drawCallback() const { return mDrawCallback; }
+    /// Set the function that renders the contents (and redraw)
+    void setDrawCallback(const std::function<void()> &callback) {
+        mDrawCallback = callback;
+        mDirty = true;
+    }
+
+    /// Request that the contents are rendered again before the next frame is shown
+    void invalidate() { mDirty = true; }
+
+    /// Return the number of MSAA samples
+    int samples() const { return mSamples; }
+    /// Set the number of MSAA samples
+    void setSamples(int samples) { mSamples = samples; mDirty = true; }
+
+    /// Return whether there is a depth/stencil buffer
+    bool depthBuffer() const { return mDepthBuffer; }
+    /// Set whether there is a depth/stencil buffer
+    void setDepthBuffer(bool depth) { mDepthBuffer = depth; mDirty = true; }
+
+    /// Return the color that the framebuffer is cleared to
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    /// Set the color that the framebuffer is cleared to
+    void setBackgroundColor(const Color &color) { mBackgroundColor = color; mDirty = true; }
+
+    /// Return whether a border is drawn around the canvas
+    bool drawBorder() const { return mDrawBorder; }
+    void setDrawBorder(bool drawBorder) { mDrawBorder = drawBorder; }
+
+    /// Return the size of the framebuffer in pixels
+    Vector2i framebufferSize() const {
+        return mOffscreen.target() ? mOffscreen.target()->size() : Vector2i(0);
+    }
+
+    /// Render the contents (calls the draw callback by default)
+    virtual void drawGL();
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    /// Return the NanoVG image of the (updated) render target
+    int renderContents(NVGcontext *ctx);
+
+protected:
+    std::function<void()> mDrawCallback;
+    Color mBackgroundColor;
+    int mSamples;
+    bool mDepthBuffer, mDrawBorder, mDirty;
+    GLOffscreenTarget mOffscreen;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,303 @@
+/*
+    nanogui/glrendertarget.h -- Offscreen render targets that are reused
+    across frames and resize without reallocating every time
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/glutil.h>
+#include <memory>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Framebuffer object with a color and an optional depth/stencil
+ * attachment whose color can be sampled as a texture
+ *
+ * The storage (the \a capacity) may be larger than the area that is
+ * rendered to (the \a size); \ref bind() restricts the viewport to the
+ * latter and \ref uvScale() maps texture coordinates onto it. With more
+ * than one sample, rendering goes to multisampled renderbuffers and
+ * \ref resolve() copies the result into the texture.
+ */
+class NANOGUI_EXPORT GLRenderTarget {
+public:
+    GLRenderTarget()
+        : mFramebuffer(0), mResolveFramebuffer(0), mColor(0), mDepth(0),
+          mFormat(GL_RGBA8), mSamples(1), mHasDepth(false), mSize(0), mCapacity(0) { }
+
+    /// Allocate storage of the given capacity (\c format must be a non-integer color format)
+    void init(const Vector2i &capacity, GLenum format = GL_RGBA8, int samples = 1,
+              bool depth = true);
+
+    /// Release all associated resources
+    void free();
+
+    /// Bind the framebuffer and set the viewport to the current size
+    void bind();
+
+    /// Bind the default framebuffer
+    void release();
+
+    /// Copy the multisampled color into the texture (no-op without multisampling)
+    void resolve();
+
+    /// Set the area that is rendered to (must fit into the capacity)
+    void setSize(const Vector2i &size);
+
+    /// Return the area that is rendered to
+    const Vector2i &size() const { return mSize; }
+
+    /// Return the size of the storage
+    const Vector2i &capacity() const { return mCapacity; }
+
+    /// Return the factor that maps [0, 1] texture coordinates onto \ref size()
+    Vector2f uvScale() const {
+        return Vector2f((float) mSize.x / mCapacity.x, (float) mSize.y / mCapacity.y);
+    }
+
+    /// Return the texture with the (resolved) color
+    const GLTexture &texture() const { return mTexture; }
+
+    /// Return the framebuffer that is rendered to
+    GLuint framebuffer() const { return mFramebuffer; }
+
+    /// Return the internal format of the color attachment
+    GLenum format() const { return mFormat; }
+
+    /// Return the number of MSAA samples
+    int samples() const { return mSamples; }
+
+    /// Return whether there is a depth/stencil attachment
+    bool hasDepth() const { return mHasDepth; }
+
+    /// Return whether or not the render target has been initialized
+    bool ready() const { return mFramebuffer != 0; }
+
+    /// Return the GPU memory of all attachments in bytes
+    size_t bytes() const;
+
+    /// Return the size of a pixel of a color format in bytes
+    static size_t formatSize(GLenum format);
+
+protected:
+    GLuint mFramebuffer, mResolveFramebuffer;
+    GLuint mColor, mDepth; /* Renderbuffers */
+    GLTexture mTexture;
+    GLenum mFormat;
+    int mSamples;
+    bool mHasDepth;
+    Vector2i mSize, mCapacity;
+};
+
+/**
+ * \brief Hands out render targets and keeps released ones for reuse
+ *
+ * Targets are grouped by size class, format, sample count and depth
+ * attachment. Size classes grow geometrically (by a factor of 1.5 per
+ * class), so a target that is resized by a few pixels at a time (e.g.
+ * while a window is being dragged larger) keeps its storage most of the
+ * time. Released targets that are not reused within a few frames are
+ * deleted.
+ *
+ * Each NanoVG context (and thus each \ref Screen) has one pool, see
+ * \ref get() and \ref Screen::renderTargetPool().
+ */
+class NANOGUI_EXPORT GLRenderTargetPool {
+public:
+    /// Usage statistics
+    struct Statistics {
+        /// Targets that are currently handed out
+        size_t inUse = 0;
+        /// Released targets that are kept for reuse
+        size_t idle = 0;
+        /// GPU memory of all targets in bytes
+        size_t bytes = 0;
+        /// Number of targets allocated since the pool was created
+        size_t allocations = 0;
+        /// Number of requests served by an existing target
+        size_t reuses = 0;
+        /// Number of resizes that kept the storage of the target
+        size_t resizesInPlace = 0;
+        /// Number of idle targets that were deleted
+        size_t evictions = 0;
+    };
+
+    /// Return the pool of a NanoVG context, optionally creating it
+    static GLRenderTargetPool *get(NVGcontext *ctx, bool create = true);
+
+    /// Delete the pool of a NanoVG context and all of its targets
+    static void release(NVGcontext *ctx);
+
+    /// Return the smallest size class that holds \c value pixels
+    static int sizeClass(int value);
+
+    /// Return a target with at least the requested size (the pool keeps ownership)
+    GLRenderTarget *acquire(const Vector2i &size, GLenum format = GL_RGBA8,
+                            int samples = 1, bool depth = true);
+
+    /**
+     * \brief Change the size of a target that was handed out
+     *
+     * The storage is kept if the new size falls into the same or a smaller
+     * neighboring size class; otherwise the target is returned to the pool
+     * and a different one is handed out.
+     */
+    GLRenderTarget *resize(GLRenderTarget *target, const Vector2i &size);
+
+    /// Return a target to the pool
+    void release(GLRenderTarget *target);
+
+    /// Mark the start of a new frame and delete targets that have been idle for too long
+    void beginFrame();
+
+    /// Return the number of frames an idle target is kept
+    int maxIdleFrames() const { return mMaxIdleFrames; }
+
+    /// Set the number of frames an idle target is kept
+    void setMaxIdleFrames(int frames) { mMaxIdleFrames = frames; }
+
+    /// Return usage statistics
+    Statistics statistics() const;
+
+    /// Delete all targets (including those that are handed out)
+    void free();
+
+    ~GLRenderTargetPool() { free(); }
+
+protected:
+    struct Entry {
+        std::unique_ptr<GLRenderTarget> target;
+        bool inUse = false;
+        uint64_t lastUsed = 0;
+    };
+
+    GLRenderTargetPool() { }
+
+    /// Return the entry of a target that was handed out
+    Entry &entry(GLRenderTarget *target);
+
+protected:
+    std::vector<Entry> mEntries;
+    int mMaxIdleFrames = 3;
+    uint64_t mFrame = 1;
+    size_t mAllocations = 0, mReuses = 0, mResizesInPlace = 0, mEvictions = 0;
+};
+
+/**
+ * \brief Offscreen pass of a widget that shows its contents as a NanoVG image
+ *
+ * Holds a render target of the pool of a NanoVG context (see
+ * \ref GLRenderTargetPool) along with the NanoVG image that shows it, and
+ * implements the offscreen pass of widgets like \ref GLCanvas or
+ * \ref ScatterPlot. The pass is meant to run from \ref Widget::draw():
+ * NanoVG has not flushed yet at that point, so it executes before any of
+ * the frame's widget geometry. \ref begin() binds the target and disables
+ * blending, depth testing, the scissor test and face culling;
+ * \ref end() restores the framebuffer and viewport, which is all that
+ * NanoVG depends on.
+ *
+ * Since widgets may outlive the \ref Screen that created their context,
+ * \ref release() (and the destructor) only touch OpenGL and NanoVG while
+ * the pool of the context still exists, see \ref contextAlive().
+ */
+class NANOGUI_EXPORT GLOffscreenTarget {
+public:
+    GLOffscreenTarget()
+        : mContext(nullptr), mTarget(nullptr), mTexture(0), mImage(0),
+          mImageFlags(0), mFramebuffer(0) { }
+
+    /// Return the target to the pool and delete the image
+    ~GLOffscreenTarget() { release(); }
+
+    /**
+     * \brief Make sure that a target of \c size pixels and its image exist
+     *
+     * \c imageFlags are NanoVG image flags (e.g. \c NVG_IMAGE_PREMULTIPLIED).
+     * Returns \c true if the target or image were (re)created, in which case
+     * the contents have to be rendered again.
+     */
+    bool prepare(NVGcontext *ctx, const Vector2i &size, int imageFlags = 0,
+                 int samples = 1, bool depth = false);
+
+    /**
+     * \brief Variant of \ref prepare() that renders a widget area of
+     * \c logicalSize at the resolution of the framebuffer
+     *
+     * The pixel size of the target is \c logicalSize scaled by
+     * \c pixelRatio (see \ref Screen::pixelRatio()) and rounded up.
+     */
+    bool prepare(NVGcontext *ctx, const Vector2i &logicalSize, float pixelRatio,
+                 int imageFlags = 0, int samples = 1, bool depth = false);
+
+    /// Bind the target for rendering (see the class documentation)
+    void begin();
+
+    /// Resolve the target and restore the framebuffer and viewport of NanoVG
+    void end();
+
+    /// Return a paint that shows the rendered area in the given rectangle
+    NVGpaint paint(NVGcontext *ctx, float x, float y, float w, float h, float alpha = 1.f) const;
+
+    /// Return the target to the pool and delete the image (if the context still exists)
+    void release();
+
+    /**
+     * \brief Release the target if the contexts of its \ref Screen still exist
+     *
+     * Returns \c false if the screen has destroyed the OpenGL and NanoVG
+     * contexts already (along with everything created in them), so that
+     * widget destructors can skip freeing their other resources. \c ctx
+     * defaults to the context of the target.
+     */
+    bool releaseIfAlive(NVGcontext *ctx = nullptr);
+
+    /// Return the render target (nullptr before \ref prepare())
+    GLRenderTarget *target() { return mTarget; }
+    /// Return the render target (nullptr before \ref prepare())
+    const GLRenderTarget *target() const { return mTarget; }
+
+    /// Return the NanoVG image that shows the target
+    int image() const { return mImage; }
+
+    /// Return the NanoVG context of the target
+    NVGcontext *context() const { return mContext; }
+
+    /// Return whether the OpenGL and NanoVG contexts of a \ref Screen still exist
+    static bool contextAlive(NVGcontext *ctx) {
+        return ctx && GLRenderTargetPool::get(ctx, false) != nullptr;
+    }
+
+    /**
+     * \brief Return the source of a vertex shader that covers the viewport
+     *
+     * The shader generates a triangle strip of four vertices from
+     * \c gl_VertexID (no attributes) and outputs \c uv in [0, 1].
+     */
+    static const char *fullscreenVertexShader();
+
+    /// Draw the triangle strip of \ref fullscreenVertexShader() with a bound shader
+    static void drawFullscreen(GLShader &shader) { shader.drawArray(GL_TRIANGLE_STRIP, 0, 4); }
+
+protected:
+    GLOffscreenTarget(const GLOffscreenTarget &) = delete;
+    GLOffscreenTarget &operator=(const GLOffscreenTarget &) = delete;
+
+protected:
+    NVGcontext *mContext;
+    GLRenderTarget *mTarget;
+    GLuint mTexture;
+    int mImage, mImageFlags;
+    GLint mViewport[4];
+    GLuint mFramebuffer;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,129 @@
+/*
+    nanogui/glshadervariants.h -- Cache of shader permutations that are
+    selected by a bit mask of features
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/glutil.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Compiles the permutations of one shader on demand
+ *
+ * Each feature is a bit that turns on a preprocessor definition (see
+ * \ref GLShader::define()), so the shader sources test features with
+ * \c \#ifdef. A variant is compiled the first time its combination of
+ * feature bits is requested and kept for later use.
+ *
+ * All vertex data is uploaded once to the first variant (the \a owner);
+ * the other variants reference the owner's buffers through
+ * \ref GLShader::shareAttrib() when they are bound, which only involves
+ * GL calls for buffers that were created or changed since the last time.
+ *
+ * \ref prewarm() starts compiling a list of variants up front. With
+ * \c GL_KHR_parallel_shader_compile, the driver does this on background
+ * threads and \ref ready() tells whether a variant can be used without
+ * stalling.
+ */
+class NANOGUI_EXPORT GLShaderVariants {
+public:
+    GLShaderVariants() : mOwner(nullptr), mOwnerFeatures(0) { }
+
+    /// Store the sources of the shader (nothing is compiled yet)
+    void init(const std::string &name, const std::string &vertex_str,
+              const std::string &fragment_str,
+              const std::string &geometry_str = "");
+
+    /// Associate the feature bit(s) \c mask with a preprocessor definition
+    void addFeature(uint32_t mask, const std::string &key, const std::string &value = "1");
+
+    /// Set a preprocessor definition shared by all variants
+    void define(const std::string &key, const std::string &value) { mDefinitions[key] = value; }
+
+    /// Return the variant for a set of features, compiling it if necessary
+    GLShader &variant(uint32_t features);
+
+    /// Select a variant for drawing and connect it to the shared buffers
+    GLShader &bind(uint32_t features);
+
+    /// Start compiling the given variants without waiting for them
+    void prewarm(const std::vector<uint32_t> &features);
+
+    /// Return whether a variant has been compiled (or is ready to be finished without stalling)
+    bool ready(uint32_t features) const;
+
+    /// Upload a vertex attribute shared by all variants (see \ref GLShader::uploadAttrib())
+    template <typename... Args> void uploadAttrib(const std::string &name, Args&&... args) {
+        GLShader &shader = owner();
+        shader.bind();
+        shader.uploadAttrib(name, std::forward<Args>(args)...);
+    }
+
+    /// Upload the index buffer shared by all variants (see \ref GLShader::uploadIndices())
+    template <typename... Args> void uploadIndices(Args&&... args) {
+        GLShader &shader = owner();
+        shader.bind();
+        shader.uploadIndices(std::forward<Args>(args)...);
+    }
+
+    /**
+     * \brief Return the variant that holds the shared buffers
+     *
+     * The plain variant becomes the owner if no variant exists yet. Uploads
+     * that need explicit template arguments (e.g. \ref
+     * GLShader::uploadAttrib<T, Dim>()) go through it directly after it is bound.
+     */
+    GLShader &owner();
+
+    /// Return the number of variants that have been created
+    size_t variantCount() const { return mVariants.size(); }
+
+    /// Release all variants and buffers
+    void free();
+
+protected:
+    /* Buffer properties that a variant's vertex array object depends on */
+    struct Signature {
+        GLuint id, glType, dim, divisor;
+        bool integral;
+
+        bool operator==(const Signature &s) const {
+            return id == s.id && glType == s.glType && dim == s.dim &&
+                   divisor == s.divisor && integral == s.integral;
+        }
+    };
+
+    struct Variant {
+        std::unique_ptr<GLShader> shader;
+        bool pending = false;
+        std::map<std::string, Signature> shared;
+    };
+
+    /// Create a variant and start compiling it
+    Variant &create(uint32_t features);
+
+    /// Make sure that a variant references the owner's current buffers
+    void share(Variant &variant);
+
+protected:
+    std::string mName, mVertexShader, mFragmentShader, mGeometryShader;
+    std::map<std::string, std::string> mDefinitions;
+    std::vector<std::pair<uint32_t, std::pair<std::string, std::string>>> mFeatures;
+    std::map<uint32_t, Variant> mVariants;
+    GLShader *mOwner;
+    uint32_t mOwnerFeatures;
+};
+
+NAMESPACE_END(nanogui)
@@ -12,7 +12,13 @@
 #pragma once
 
 #include <nanogui/opengl.h>
+#include <glm/gtc/quaternion.hpp>
+#include <array>
 #include <map>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace half_float { class half; }
 
@@ -31,22 +37,168 @@ template <> struct type_traits<double> { enum { type = GL_DOUBLE, integral = 0 }
 template <> struct type_traits<float> { enum { type = GL_FLOAT, integral = 0 }; };
 template <> struct type_traits<half_float::half> { enum { type = GL_HALF_FLOAT, integral = 0 }; };
 
+/// Scalar type and number of components of one element of an attribute array
+template <typename T> struct attrib_traits { typedef T Scalar; enum { components = 1 }; };
+template <typename T, size_t N> struct attrib_traits<std::array<T, N>> { typedef T Scalar; enum { components = (int) N }; };
+template <> struct attrib_traits<glm::vec2> { typedef float Scalar; enum { components = 2 }; };
+template <> struct attrib_traits<glm::vec3> { typedef float Scalar; enum { components = 3 }; };
+template <> struct attrib_traits<glm::vec4> { typedef float Scalar; enum { components = 4 }; };
+template <> struct attrib_traits<glm::ivec2> { typedef int32_t Scalar; enum { components = 2 }; };
+template <> struct attrib_traits<glm::ivec3> { typedef int32_t Scalar; enum { components = 3 }; };
+template <> struct attrib_traits<glm::ivec4> { typedef int32_t Scalar; enum { components = 4 }; };
+template <> struct attrib_traits<glm::uvec2> { typedef uint32_t Scalar; enum { components = 2 }; };
+template <> struct attrib_traits<glm::uvec3> { typedef uint32_t Scalar; enum { components = 3 }; };
+template <> struct attrib_traits<glm::uvec4> { typedef uint32_t Scalar; enum { components = 4 }; };
+
+class GLReadback;
+class GLTimer;
+
+/**
+ * \brief Shadow copy of frequently changed OpenGL state
+ *
+ * The functions below mirror their OpenGL counterparts and record the
+ * program, the vertex array object, buffer bindings, the framebuffers, the
+ * viewport, blending, the scissor test and a few capabilities
+ * (\c GL_BLEND, \c GL_SCISSOR_TEST, \c GL_DEPTH_TEST, \c GL_CULL_FACE,
+ * \c GL_MULTISAMPLE and \c GL_PROGRAM_POINT_SIZE). Other targets and
+ * capabilities are passed through. Each OpenGL context (identified by its
+ * GLFW window) has its own shadow.
+ *
+ * Calls that would not change anything are only skipped within a tracked
+ * \ref Scope, which asserts that all changes of this state go through the
+ * tracker. \ref Screen draws its widgets within one; elsewhere (e.g. in
+ * \ref Screen::drawContents() or in event handlers) every call is issued,
+ * so mixing these functions with direct OpenGL calls is safe. Code running
+ * within a tracked scope that calls OpenGL directly must be followed by
+ * \ref invalidate() or wrapped in an untracked scope; deleting a tracked
+ * object requires \ref forget().
+ *
+ * When counting is enabled, the number of issued and skipped calls is
+ * recorded per frame (see \ref beginFrame() and \ref lastFrame()).
+ */
+class NANOGUI_EXPORT GLState {
+public:
+    /// Number of state changes that were issued or skipped
+    struct Statistics {
+        size_t calls = 0, skipped = 0;
+    };
+
+    /**
+     * \brief Enables (or disables) skipping of redundant calls while it exists
+     *
+     * Entering a tracked scope forgets the state of the current context, as
+     * does leaving an untracked scope that was nested in a tracked one.
+     */
+    class NANOGUI_EXPORT Scope {
+    public:
+        Scope(bool tracking = true);
+        ~Scope();
+    private:
+        bool mPrevious;
+    };
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vao);
+    static void bindBuffer(GLenum target, GLuint buffer);
+    /// Bind an indexed buffer target (also changes the generic binding)
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    /// Bind a range of a buffer to an indexed target (also changes the generic binding)
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                GLintptr offset, GLsizeiptr size);
+    /// Bind a framebuffer (\c GL_FRAMEBUFFER sets both the read and draw framebuffer)
+    static void bindFramebuffer(GLenum target, GLuint framebuffer);
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void blendFunc(GLenum sfactor, GLenum dfactor);
+    static void enable(GLenum cap) { setEnabled(cap, true); }
+    static void disable(GLenum cap) { setEnabled(cap, false); }
+    static void setEnabled(GLenum cap, bool value);
+
+    /// Return the current draw framebuffer (cached within a tracked scope)
+    static GLuint drawFramebuffer();
+
+    /// Return the current viewport (cached within a tracked scope)
+    static void getViewport(GLint viewport[4]);
+
+    /// Forget all state, e.g. after other code has called OpenGL directly
+    static void invalidate();
+
+    /// Forget any binding of an object that is about to be deleted
+    static void forget(GLuint object);
+
+    /// Return whether redundant calls are currently skipped (see \ref Scope)
+    static bool tracking();
+
+    /// Discard the shadow of the context of a window that is about to be destroyed
+    static void release(GLFWwindow *window);
+
+    /// Enable or disable the per-frame call statistics
+    static void setCounting(bool counting);
+    /// Return whether calls are being counted
+    static bool counting();
+
+    /// Start a new frame: forgets all state and moves the statistics to \ref lastFrame()
+    static void beginFrame();
+
+    /// Return the statistics of the frame so far
+    static Statistics currentFrame();
+    /// Return the statistics of the previous frame
+    static Statistics lastFrame();
+};
+
 /**
  * Helper class for compiling and linking OpenGL shaders and uploading
- * associated vertex and index buffers from Eigen matrices
+ * associated vertex and index buffers from Eigen matrices or contiguous
+ * arrays (\c std::vector, \c std::array or pointer and count) of scalars,
+ * glm vectors or other types described by \ref attrib_traits
+ *
+ * The locations of all active uniforms and attributes are queried once
+ * when the program is linked, so that looking them up by name afterwards
+ * does not involve the driver. Typed \ref Uniform handles additionally
+ * avoid the name lookup on hot paths.
  */
 class NANOGUI_EXPORT GLShader {
 public:
     /// Create an unitialized OpenGL shader
     GLShader()
         : mVertexShader(0), mFragmentShader(0), mGeometryShader(0),
-          mProgramShader(0), mVertexArrayObject(0) { }
-
-    /// Initialize the shader using the specified source strings
+          mProgramShader(0), mVertexArrayObject(0), mPendingWrites(false),
+          mIndexType(GL_UNSIGNED_INT), mLoadedFromCache(false), mInitPending(false),
+          mKeepInactiveAttribs(false), mInitStart(0), mInitTime(0), mTimer(nullptr),
+          mTimerPhase(-1) { }
+
+    /**
+     * \brief Initialize the shader using the specified source strings
+     *
+     * If a program binary cache is enabled (see \ref setBinaryCacheDirectory()),
+     * a binary matching the sources, the definitions and the driver is loaded
+     * instead of compiling; when there is none or the driver rejects it, the
+     * program is compiled from source and its binary is stored for the next run.
+     */
     bool init(const std::string &name, const std::string &vertex_str,
               const std::string &fragment_str,
               const std::string &geometry_str = "");
 
+    /**
+     * \brief Start compiling and linking the shader without waiting for the result
+     *
+     * Drivers supporting \c GL_KHR_parallel_shader_compile do this on
+     * background threads. \ref initComplete() polls the progress, and
+     * \ref finishInit() must be called before the shader is used.
+     */
+    bool beginInit(const std::string &name, const std::string &vertex_str,
+                   const std::string &fragment_str,
+                   const std::string &geometry_str = "");
+
+    /// Return whether \ref finishInit() would return without blocking
+    bool initComplete() const;
+
+    /// Complete an initialization started with \ref beginInit() (waiting for it if needed)
+    bool finishInit();
+
+    /// Return whether the driver compiles shaders on background threads
+    static bool parallelCompileSupported();
+
     /// Initialize the shader using the specified files on disk
     bool initFromFiles(const std::string &name,
                        const std::string &vertex_fname,
@@ -56,10 +208,47 @@ public:
     /// Return the name of the shader
     const std::string &name() const { return mName; }
 
+    /// Return the OpenGL program handle
+    GLuint program() const { return mProgramShader; }
+
     /// Set a preprocessor definition
     void define(const std::string &key, const std::string &value) { mDefinitions[key] = value; }
 
-    /// Select this shader for subsequent draw calls
+    /// Return whether the last \ref init() call loaded a cached program binary
+    bool loadedFromCache() const { return mLoadedFromCache; }
+
+    /// Return the time taken by the last \ref init() call in seconds
+    double initTime() const { return mInitTime; }
+
+    /**
+     * \brief Enable the on-disk program binary cache (disabled by default)
+     *
+     * The directory must exist. Passing an empty string disables the cache.
+     * Program binaries require OpenGL 4.1 or \c GL_ARB_get_program_binary;
+     * without them, programs are always compiled from source.
+     */
+    static void setBinaryCacheDirectory(const std::string &directory);
+
+    /// Return the directory of the program binary cache (empty if disabled)
+    static const std::string &binaryCacheDirectory();
+
+    /// Statistics of the program binary cache
+    struct BinaryCacheStats {
+        size_t hits = 0;          ///< Programs loaded from the cache
+        size_t misses = 0;        ///< Programs compiled from source with the cache enabled
+        double warmSeconds = 0;   ///< Total initialization time of cache hits
+        double coldSeconds = 0;   ///< Total initialization time of cache misses
+    };
+
+    /// Return the statistics of the program binary cache since startup
+    static const BinaryCacheStats &binaryCacheStats();
+
+    /**
+     * \brief Select this shader for subsequent draw calls
+     *
+     * The program and vertex array object are bound through \ref GLState,
+     * i.e. the calls are only skipped within a tracked \ref GLState::Scope.
+     */
     void bind();
 
     /// Release underlying OpenGL objects
@@ -71,18 +260,81 @@ public:
     /// Return the handle of a uniform attribute (-1 if it does not exist)
     GLint uniform(const std::string &name, bool warn = true) const;
 
-    /// Upload an Eigen matrix as a vertex buffer object (refreshing it as needed)
-    template <typename Matrix> void uploadAttrib(const std::string &name, const Matrix &M, int version = -1) {
+    /// Typed handle of a uniform, which can be set without a name lookup
+    template <typename T> struct Uniform {
+        GLint location;
+        Uniform(GLint location = -1) : location(location) { }
+        bool valid() const { return location >= 0; }
+    };
+
+    /// Return a typed handle of a uniform (invalid if it does not exist)
+    template <typename T> Uniform<T> uniformHandle(const std::string &name, bool warn = true) const {
+        return Uniform<T>(uniform(name, warn));
+    }
+
+    /// Return the index of a uniform block (GL_INVALID_INDEX if it does not exist)
+    GLuint uniformBlock(const std::string &name, bool warn = true) const;
+
+    /// Connect a uniform block to a binding point (see \ref GLUniformBuffer::bind())
+    void bindUniformBlock(const std::string &name, GLuint binding, bool warn = true);
+
+    /**
+     * \brief Upload an Eigen matrix as a vertex buffer object (refreshing it as needed)
+     *
+     * If \c version is not -1 and matches the version of the existing buffer,
+     * the data is assumed to be unchanged and nothing is uploaded. A nonzero
+     * \c divisor turns the attribute into a per-instance attribute that
+     * advances once every \c divisor instances (see \ref drawArrayInstanced()).
+     */
+    template <typename Matrix, typename Scalar = typename Matrix::Scalar>
+    void uploadAttrib(const std::string &name, const Matrix &M, int version = -1, GLuint divisor = 0) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
         GLuint glType = (GLuint) type_traits<typename Matrix::Scalar>::type;
         bool integral = (bool) type_traits<typename Matrix::Scalar>::integral;
 
         uploadAttrib(name, (uint32_t) M.size(), (int) M.rows(), compSize,
-                     glType, integral, (const uint8_t *) M.data(), version);
+                     glType, integral, (const uint8_t *) M.data(), version, divisor);
+    }
+
+    /**
+     * \brief Upload \c count vertices stored contiguously at \c data
+     *
+     * Each vertex has \c Dim components, which defaults to the number of
+     * components of \c T; e.g. an array of \c glm::vec3 has three
+     * components per vertex, while an array of \c uint8_t can be uploaded
+     * with four components per vertex using <tt>uploadAttrib<uint8_t, 4></tt>.
+     * The data is passed to the driver directly, without an intermediate copy.
+     */
+    template <typename T, int Dim = attrib_traits<T>::components>
+    void uploadAttrib(const std::string &name, const T *data, size_t count,
+                      int version = -1, GLuint divisor = 0) {
+        typedef typename attrib_traits<T>::Scalar Scalar;
+        static_assert(sizeof(T) == sizeof(Scalar) * attrib_traits<T>::components,
+                      "uploadAttrib(): array elements must be tightly packed!");
+        uploadAttrib(name, (uint32_t) (count * Dim), Dim, (uint32_t) sizeof(Scalar),
+                     (GLuint) type_traits<Scalar>::type, (bool) type_traits<Scalar>::integral,
+                     (const uint8_t *) data, version, divisor);
+    }
+
+    /// Upload a \c std::vector (see the pointer version for the meaning of \c Dim)
+    template <typename T, int Dim = attrib_traits<T>::components>
+    void uploadAttrib(const std::string &name, const std::vector<T> &v,
+                      int version = -1, GLuint divisor = 0) {
+        uploadAttrib<T, Dim>(name, v.data(), v.size() * attrib_traits<T>::components / Dim,
+                             version, divisor);
+    }
+
+    /// Upload a \c std::array (see the pointer version for the meaning of \c Dim)
+    template <typename T, size_t N, int Dim = attrib_traits<T>::components>
+    void uploadAttrib(const std::string &name, const std::array<T, N> &a,
+                      int version = -1, GLuint divisor = 0) {
+        uploadAttrib<T, Dim>(name, a.data(), N * attrib_traits<T>::components / Dim,
+                             version, divisor);
     }
 
     /// Download a vertex buffer object into an Eigen matrix
-    template <typename Matrix> void downloadAttrib(const std::string &name, Matrix &M) {
+    template <typename Matrix, typename Scalar = typename Matrix::Scalar>
+    void downloadAttrib(const std::string &name, Matrix &M) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
         GLuint glType = (GLuint) type_traits<typename Matrix::Scalar>::type;
 
@@ -96,11 +348,120 @@ public:
         downloadAttrib(name, M.size(), M.rows(), compSize, glType, (uint8_t *) M.data());
     }
 
-    /// Upload an index buffer
-    template <typename Matrix> void uploadIndices(const Matrix &M) {
-        uploadAttrib("indices", M);
+    /// Download a vertex buffer object into a \c std::vector
+    template <typename T> void downloadAttrib(const std::string &name, std::vector<T> &v) {
+        typedef typename attrib_traits<T>::Scalar Scalar;
+        auto it = mBufferObjects.find(name);
+        if (it == mBufferObjects.end())
+            throw std::runtime_error("downloadAttrib(" + mName + ", " + name + ") : buffer not found!");
+
+        const Buffer &buf = it->second;
+        v.resize(buf.size / attrib_traits<T>::components);
+        downloadAttrib(name, (uint32_t) (v.size() * attrib_traits<T>::components), buf.dim,
+                       (uint32_t) sizeof(Scalar), (GLuint) type_traits<Scalar>::type,
+                       (uint8_t *) v.data());
+    }
+
+    /**
+     * \brief Start an asynchronous download of a vertex buffer object
+     *
+     * The buffer is copied on the GPU into the staging buffer of
+     * \c readback, which can be polled with \ref GLReadback::ready() and
+     * read once the copy has completed, typically in a later frame.
+     */
+    void downloadAttribAsync(const std::string &name, GLReadback &readback);
+
+    /// Storage formats for \ref uploadAttrib() calls that quantize floating point data
+    enum class AttribFormat {
+        Float32, ///< No conversion
+        Float16, ///< Half precision
+        SNorm16, ///< 16-bit signed integers representing [-1, 1] (e.g. normals)
+        UNorm16, ///< 16-bit unsigned integers representing [0, 1] (e.g. texture coordinates)
+        SNorm8,  ///< 8-bit signed integers representing [-1, 1]
+        UNorm8   ///< 8-bit unsigned integers representing [0, 1] (e.g. colors)
+    };
+
+    /**
+     * \brief Upload a floating point Eigen matrix as a vertex buffer object,
+     * converting it to a more compact format
+     *
+     * Values are clamped to the range of normalized formats. Shaders read
+     * the attribute as \c float or \c vec* in all cases.
+     */
+    template <typename Matrix, typename Scalar = typename Matrix::Scalar>
+    void uploadAttrib(const std::string &name, const Matrix &M, AttribFormat format,
+                      int version = -1, GLuint divisor = 0) {
+        static_assert(std::is_same<Scalar, float>::value,
+                      "uploadAttrib(): quantization requires single precision input!");
+        uploadAttrib(name, (const float *) M.data(), (uint32_t) M.size(), (int) M.rows(),
+                     format, version, divisor);
+    }
+
+    /// Quantized upload of a \c std::vector of \c float or glm vectors
+    template <typename T, int Dim = attrib_traits<T>::components>
+    void uploadAttrib(const std::string &name, const std::vector<T> &v, AttribFormat format,
+                      int version = -1, GLuint divisor = 0) {
+        static_assert(std::is_same<typename attrib_traits<T>::Scalar, float>::value,
+                      "uploadAttrib(): quantization requires single precision input!");
+        uploadAttrib(name, (const float *) v.data(),
+                     (uint32_t) (v.size() * attrib_traits<T>::components), Dim,
+                     format, version, divisor);
+    }
+
+    /**
+     * \brief Upload an index buffer
+     *
+     * 32-bit indices are stored as 16-bit values when all of them are
+     * smaller than 65536; the draw functions use whichever type was stored.
+     * This is transparent to \ref downloadAttrib(), which widens the values
+     * again, and to \ref updateAttribRange(), which narrows 32-bit indices
+     * (or switches the buffer to 32-bit storage if one does not fit).
+     */
+    template <typename Matrix, typename Scalar = typename Matrix::Scalar>
+    void uploadIndices(const Matrix &M, int version = -1) {
+        uploadIndices(M.data(), (uint32_t) M.size(), (int) M.rows(), version);
     }
 
+    /// Upload an index buffer from a \c std::vector of integers or glm integer vectors
+    template <typename T> void uploadIndices(const std::vector<T> &v, int version = -1) {
+        typedef typename attrib_traits<T>::Scalar Scalar;
+        uploadIndices((const Scalar *) v.data(), (uint32_t) (v.size() * attrib_traits<T>::components),
+                      attrib_traits<T>::components, version);
+    }
+
+    /// Return the type of the stored indices (\c GL_UNSIGNED_SHORT or \c GL_UNSIGNED_INT)
+    GLenum indexType() const { return mIndexType; }
+
+    /// Return the size of one stored index in bytes
+    size_t indexSize() const { return mIndexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+    /**
+     * \brief Overwrite \c count vertices of an existing buffer, starting at vertex \c offset
+     *
+     * \c data holds <tt>count * dim</tt> values of the type used for the
+     * original upload (as scalars or as elements described by
+     * \ref attrib_traits). Updates are only recorded here; they are
+     * coalesced into as few \c glBufferSubData() calls as possible by
+     * \ref flushAttribs(), which the draw functions call automatically.
+     */
+    template <typename T> void updateAttribRange(const std::string &name, uint32_t offset,
+                                                 uint32_t count, const T *data, int version = -1) {
+        updateAttribRange(name, offset, count, (uint32_t) sizeof(typename attrib_traits<T>::Scalar),
+                          (const uint8_t *) data, version);
+    }
+
+    /// Submit all pending \ref updateAttribRange() writes to the GPU
+    void flushAttribs();
+
+    /**
+     * \brief Mark an attribute as being replaced every frame
+     *
+     * Uploads to streaming attributes orphan the previous storage before
+     * writing the new data, so the driver can hand out fresh memory instead
+     * of waiting for draw calls that still read the old contents.
+     */
+    void setAttribStreaming(const std::string &name, bool streaming);
+
     /// Invalidate the version numbers assiciated with attribute data
     void invalidateAttribs();
 
@@ -136,39 +497,76 @@ public:
     /// Draw a sequence of primitives
     void drawArray(int type, uint32_t offset, uint32_t count);
 
-    /// Draw a sequence of primitives using a previously uploaded index buffer
-    void drawIndexed(int type, uint32_t offset, uint32_t count);
+    /**
+     * \brief Draw a sequence of primitives using a previously uploaded index buffer
+     *
+     * \c baseVertex is added to every index before it is used to fetch
+     * vertex attributes, which allows several meshes to share one buffer.
+     */
+    void drawIndexed(int type, uint32_t offset, uint32_t count, int32_t baseVertex = 0);
+
+    /**
+     * \brief Draw \c instanceCount instances of a sequence of primitives in one call
+     *
+     * Per-instance attributes start at instance \c baseInstance. This uses
+     * \c GL_ARB_base_instance when available; otherwise the per-instance
+     * attribute pointers are offset temporarily, which requires
+     * \c baseInstance to be a multiple of every divisor.
+     */
+    void drawArrayInstanced(int type, uint32_t offset, uint32_t count,
+                            uint32_t instanceCount, uint32_t baseInstance = 0);
+
+    /// Instanced version of \ref drawIndexed() (see \ref drawArrayInstanced())
+    void drawIndexedInstanced(int type, uint32_t offset, uint32_t count,
+                              uint32_t instanceCount, int32_t baseVertex = 0,
+                              uint32_t baseInstance = 0);
+
+    /// Return whether base instances are supported natively by the driver
+    static bool hasBaseInstance();
 
     /// Initialize a uniform parameter with a 4x4 matrix
     void setUniform(const std::string &name, const Matrix4f &mat, bool warn = true) {
-        glUniformMatrix4fv(uniform(name, warn), 1, GL_FALSE, glm::value_ptr(mat));
+        setUniformValue(uniform(name, warn), mat);
     }
 
     /// Initialize a uniform parameter with an integer value
     void setUniform(const std::string &name, int value, bool warn = true) {
-        glUniform1i(uniform(name, warn), value);
+        setUniformValue(uniform(name, warn), value);
     }
 
     /// Initialize a uniform parameter with a float value
     void setUniform(const std::string &name, float value, bool warn = true) {
-        glUniform1f(uniform(name, warn), value);
+        setUniformValue(uniform(name, warn), value);
     }
 
     /// Initialize a uniform parameter with a 2D vector
     void setUniform(const std::string &name, const Vector2f &v, bool warn = true) {
-        glUniform2f(uniform(name, warn), v.x, v.y);
+        setUniformValue(uniform(name, warn), v);
     }
 
     /// Initialize a uniform parameter with a 3D vector
     void setUniform(const std::string &name, const Vector3f &v, bool warn = true) {
-        glUniform3f(uniform(name, warn), v.x, v.y, v.z);
+        setUniformValue(uniform(name, warn), v);
     }
 
     /// Initialize a uniform parameter with a 4D vector
     void setUniform(const std::string &name, const Vector4f &v, bool warn = true) {
-        glUniform4f(uniform(name, warn), v.x, v.y, v.z, v.w);
+        setUniformValue(uniform(name, warn), v);
+    }
+
+    /// Initialize a uniform parameter through a handle obtained from \ref uniformHandle()
+    template <typename T> void setUniform(const Uniform<T> &handle, const T &value) {
+        setUniformValue(handle.location, value);
     }
 
+    /**
+     * \brief Measure the GPU time of this shader's draw calls
+     *
+     * All draw calls are recorded as the given phase of \c timer (e.g.
+     * \ref Screen::gpuTimer()). Passing \c nullptr stops measuring.
+     */
+    void setTimer(GLTimer *timer, const std::string &phase);
+
     /// Return the size of all registered buffers in bytes
     size_t bufferSize() const {
         size_t size = 0;
@@ -179,9 +577,49 @@ public:
 protected:
     void uploadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, bool integral, 
-                       const uint8_t *data, int version = -1);
+                       const uint8_t *data, int version = -1, GLuint divisor = 0);
     void downloadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, uint8_t *data);
+    void updateAttribRange(const std::string &name, uint32_t offset, uint32_t count,
+                           uint32_t compSize, const uint8_t *data, int version);
+    void uploadAttrib(const std::string &name, const float *data, uint32_t size, int dim,
+                      AttribFormat format, int version, GLuint divisor);
+    void uploadIndices(const uint32_t *data, uint32_t size, int dim, int version);
+    void uploadIndices(const int32_t *data, uint32_t size, int dim, int version) {
+        uploadIndices((const uint32_t *) data, size, dim, version);
+    }
+    void uploadIndices(const uint16_t *data, uint32_t size, int dim, int version) {
+        uploadAttrib("indices", size, dim, sizeof(uint16_t), GL_UNSIGNED_SHORT, true,
+                     (const uint8_t *) data, version);
+    }
+    /// Convert 16-bit index storage to 32 bits (keeping pending range updates)
+    void widenIndices();
+
+    /// Point per-instance attributes at instance 'baseInstance' (emulation of base instances)
+    void offsetInstanceAttribs(uint32_t baseInstance);
+
+    /// Convert a primitive offset and count of \ref drawIndexed() into indices
+    static void indexRange(int type, size_t &offset, size_t &count);
+
+    /// Query the locations of all active uniforms, attributes and uniform blocks
+    void queryLocations();
+
+    /// Return the cache file of a program, or an empty string if the cache is unavailable
+    std::string binaryCachePath(const std::string &vertex_str, const std::string &fragment_str,
+                                const std::string &geometry_str, const std::string &defines) const;
+
+    /// Try to create the program from a cached binary
+    bool loadBinary(const std::string &filename);
+
+    /// Store the binary of the linked program
+    void saveBinary(const std::string &filename) const;
+
+    static void setUniformValue(GLint id, const Matrix4f &mat) { glUniformMatrix4fv(id, 1, GL_FALSE, glm::value_ptr(mat)); }
+    static void setUniformValue(GLint id, int value) { glUniform1i(id, value); }
+    static void setUniformValue(GLint id, float value) { glUniform1f(id, value); }
+    static void setUniformValue(GLint id, const Vector2f &v) { glUniform2f(id, v.x, v.y); }
+    static void setUniformValue(GLint id, const Vector3f &v) { glUniform3f(id, v.x, v.y, v.z); }
+    static void setUniformValue(GLint id, const Vector4f &v) { glUniform4f(id, v.x, v.y, v.z, v.w); }
 protected:
     struct Buffer {
         GLuint id;
@@ -190,6 +628,14 @@ protected:
         GLuint compSize;
         GLuint size;
         int version;
+        bool integral;
+        GLuint divisor;
+        bool streaming;
+        /* Writes recorded by updateAttribRange(): destination and length
+           in bytes, and the position of the data within 'pendingData' */
+        struct Write { size_t offset, size, source; };
+        std::vector<Write> pendingWrites;
+        std::vector<uint8_t> pendingData;
     };
     std::string mName;
     GLuint mVertexShader;
@@ -197,14 +643,250 @@ protected:
     GLuint mGeometryShader;
     GLuint mProgramShader;
     GLuint mVertexArrayObject;
-    std::map<std::string, Buffer> mBufferObjects;
+    std::unordered_map<std::string, Buffer> mBufferObjects;
     std::map<std::string, std::string> mDefinitions;
+    std::set<std::string> mStreamingAttribs;
+    bool mPendingWrites;
+    GLenum mIndexType;
+    bool mLoadedFromCache, mInitPending;
+    /* Create buffers for attributes that this program does not use (so
+       that other programs can share them) */
+    bool mKeepInactiveAttribs;
+    double mInitStart, mInitTime;
+
+    /* State of an initialization started by beginInit() */
+    std::vector<std::string> mPendingSources;
+    std::string mPendingCacheFile;
+
+    /* Optional GPU time measurement of draw calls */
+    GLTimer *mTimer;
+    int mTimerPhase;
+
+    /* Locations resolved at link time; names that are not active (e.g.
+       individual array elements) are added on their first lookup */
+    mutable std::unordered_map<std::string, GLint> mUniforms, mAttribs;
+    std::unordered_map<std::string, GLuint> mUniformBlocks;
+
+    friend class GLShaderVariants;
+};
+
+/**
+ * \brief Uniform buffer object that can be shared by several shaders
+ *
+ * Each shader connects its uniform block to a binding point using
+ * \ref GLShader::bindUniformBlock(); binding the buffer to the same point
+ * makes its contents visible to all of them, so shared parameters (e.g.
+ * camera matrices) are uploaded once per frame instead of once per shader.
+ * The layout of the data must follow the \c std140 rules.
+ */
+class NANOGUI_EXPORT GLUniformBuffer {
+public:
+    GLUniformBuffer() : mBuffer(0), mSize(0) { }
+
+    /// Allocate storage for \c size bytes and optionally upload initial data
+    void init(size_t size, const void *data = nullptr);
+
+    /// Upload \c size bytes at the given byte offset
+    void update(const void *data, size_t size, size_t offset = 0);
+
+    /// Upload a struct with \c std140 layout
+    template <typename T> void update(const T &value) { update(&value, sizeof(T)); }
+
+    /// Bind the whole buffer to a uniform block binding point
+    void bind(GLuint binding) const;
+
+    /// Bind a range of the buffer to a uniform block binding point
+    void bind(GLuint binding, size_t offset, size_t size) const;
+
+    /// Release the buffer object
+    void free();
+
+    /// Return whether or not the buffer has been initialized
+    bool ready() const { return mBuffer != 0; }
+
+    /// Return the OpenGL buffer handle
+    GLuint id() const { return mBuffer; }
+
+    /// Return the size of the buffer in bytes
+    size_t size() const { return mSize; }
+protected:
+    GLuint mBuffer;
+    size_t mSize;
+};
+
+/**
+ * \brief Future-like handle of an asynchronous buffer download
+ *
+ * \ref copy() copies a range of a buffer object into a staging buffer on
+ * the GPU and inserts a fence after the copy. The CPU only waits if the
+ * data is read before the fence has signaled, so a download issued in one
+ * frame and read in the next does not stall the pipeline.
+ */
+class NANOGUI_EXPORT GLReadback {
+public:
+    GLReadback() : mBuffer(0), mCapacity(0), mSize(0), mFence(nullptr), mFlushed(false) { }
+
+    /// Start copying \c size bytes of \c buffer, starting at \c offset (replaces a pending download)
+    void copy(GLuint buffer, size_t offset, size_t size);
+
+    /// Return whether a download was started and has not been read yet
+    bool pending() const { return mFence != nullptr; }
+
+    /// Return whether a pending download has completed (never blocks)
+    bool ready();
+
+    /// Block until a pending download has completed
+    void wait();
+
+    /// Return the size of the pending download in bytes
+    size_t size() const { return mSize; }
+
+    /// Copy the downloaded data to \c data (waiting if needed) and release the download
+    void read(void *data);
+
+    /// Read the downloaded data into a \c std::vector of elements of type \c T
+    template <typename T> void read(std::vector<T> &v) {
+        v.resize(mSize / sizeof(T));
+        read((void *) v.data());
+    }
+
+    /// Release the staging buffer and any pending fence
+    void free();
+protected:
+    GLuint mBuffer;
+    size_t mCapacity, mSize;
+    GLsync mFence;
+    bool mFlushed;
+};
+
+/**
+ * \brief Ring of \ref GLReadback slots for downloads issued every frame
+ *
+ * With a depth of two or three, the data read in one frame was requested
+ * one or two frames earlier, so the copy overlaps with rendering. If all
+ * slots are busy when a new download is requested, the oldest download is
+ * discarded.
+ */
+class NANOGUI_EXPORT GLReadbackRing {
+public:
+    GLReadbackRing(int depth = 3) : mSlots(std::max(depth, 1)), mHead(0), mCount(0), mDropped(0) { }
+
+    /// Return the slot to be used for a new download
+    GLReadback &acquire();
+
+    /// Return the oldest download if it has completed, otherwise nullptr (never blocks)
+    GLReadback *poll();
+
+    /// Return the oldest pending download, or nullptr if there is none
+    GLReadback *oldest();
+
+    /// Return the number of downloads that were discarded before being read
+    size_t dropped() const { return mDropped; }
+
+    /// Release all slots
+    void free();
+protected:
+    std::vector<GLReadback> mSlots;
+    int mHead, mCount;
+    size_t mDropped;
+};
+
+/**
+ * \brief Measures the GPU time of named phases with timestamp queries
+ *
+ * \ref begin() and \ref end() record \c glQueryCounter() timestamps, so
+ * phases may nest. Results are never waited for: \ref beginFrame() reads
+ * back the queries of earlier frames once the GPU has processed them
+ * (usually a few frames later) and returns their query objects to a free
+ * list. Each phase keeps a rolling window of per-frame totals.
+ */
+class NANOGUI_EXPORT GLTimer {
+public:
+    /// Times of one phase in milliseconds
+    struct Times {
+        std::string name;
+        /// Total of the most recent frame with results
+        double last;
+        /// Average over the rolling window
+        double average;
+        /// Maximum over the rolling window
+        double maximum;
+    };
+
+    GLTimer(int window = 60) : mWindow(std::max(window, 1)) { }
+
+    /// Return the index of a phase, creating it if necessary
+    int phase(const std::string &name);
+
+    /// Start a frame and collect the results of earlier frames that are available
+    void beginFrame();
+
+    /// Record the start of a phase
+    void begin(int phase);
+    void begin(const std::string &name) { begin(phase(name)); }
+
+    /// Record the end of a phase
+    void end(int phase);
+    void end(const std::string &name) { end(phase(name)); }
+
+    /// Return the rolling times of a phase (zero if it has no results yet)
+    Times times(const std::string &name) const;
+
+    /// Return the rolling times of all phases
+    std::vector<Times> times() const;
+
+    /// Return the number of frames whose results are still outstanding
+    size_t pendingFrames() const { return mFrames.size(); }
+
+    /// Release all query objects
+    void free();
+
+    /// Measures the enclosing block as a phase (does nothing without a timer)
+    struct Scope {
+        Scope(GLTimer *timer, int phase) : timer(timer), phase(phase) {
+            if (timer)
+                timer->begin(phase);
+        }
+        ~Scope() {
+            if (timer)
+                timer->end(phase);
+        }
+        GLTimer *timer;
+        int phase;
+    };
+
+protected:
+    struct Phase {
+        std::string name;
+        std::vector<double> history;
+        size_t head = 0, count = 0;
+        GLuint open = 0;
+        bool isOpen = false;
+    };
+
+    struct Interval {
+        int phase;
+        GLuint begin, end;
+    };
+
+    /// Return an unused query object
+    GLuint query();
+
+    /// Read back the queries of a completed frame
+    void collect(const std::vector<Interval> &frame);
+
+protected:
+    std::vector<Phase> mPhases;
+    std::vector<std::vector<Interval>> mFrames; /* Oldest first, the last one is being recorded */
+    std::vector<GLuint> mFreeQueries, mAllQueries;
+    std::vector<double> mTotals;
+    int mWindow;
 };
 
 /// Helper class for creating framebuffer objects
 class NANOGUI_EXPORT GLFramebuffer {
 public:
-    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mSamples(0) { }
+    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mSize(0), mCapacity(0), mSamples(0) { }
 
     /// Create a new framebuffer with the specified size and number of MSAA samples
     void init(const Vector2i &size, int nSamples);
@@ -221,15 +903,103 @@ public:
     /// Blit the framebuffer object onto the screen
     void blit();
 
+    /**
+     * \brief Change the size of the framebuffer
+     *
+     * Storage is allocated in geometrically growing size classes (see \ref
+     * GLRenderTargetPool::sizeClass()) and only reallocated when the new size
+     * does not fit or is much smaller, so that resizing a window by a few
+     * pixels at a time does not reallocate each time. Only the region of
+     * the current size is blitted.
+     */
+    void resize(const Vector2i &size);
+
     /// Return whether or not the framebuffer object has been initialized
     bool ready() { return mFramebuffer != 0; }
 
     /// Return the number of MSAA samples
     int samples() const { return mSamples; }
+
+    /// Return the size of the region that is used
+    const Vector2i &size() const { return mSize; }
+
+    /// Return the size of the storage
+    const Vector2i &capacity() const { return mCapacity; }
 protected:
     GLuint mFramebuffer, mDepth, mColor;
-    Vector2i mSize;
+    Vector2i mSize, mCapacity;
     int mSamples;
 };
 
+/// Helper class for creating and updating 2D textures
+class NANOGUI_EXPORT GLTexture {
+public:
+    GLTexture()
+        : mTexture(0), mSize(0), mInternalFormat(0), mFormat(0), mType(0) { }
+
+    /**
+     * \brief Allocate texture storage and optionally upload initial data
+     *
+     * \c format and \c type describe the layout of \c data (e.g. \c GL_RGBA
+     * and \c GL_UNSIGNED_BYTE). Storage is only reallocated if the size or
+     * internal format differ from the current ones.
+     */
+    void init(const Vector2i &size, GLuint internalFormat, GLuint format,
+              GLuint type, const void *data = nullptr);
+
+    /**
+     * \brief Upload a sub-rectangle of the texture
+     *
+     * If a buffer object is bound to \c GL_PIXEL_UNPACK_BUFFER, \c data is
+     * interpreted as a byte offset into that buffer and the transfer happens
+     * asynchronously.
+     */
+    void update(const Vector2i &offset, const Vector2i &size, const void *data);
+
+    /// Upload the entire texture
+    void update(const void *data) { update(Vector2i(0), mSize, data); }
+
+    /// Set the minification and magnification filters
+    void setFilter(GLuint minFilter, GLuint magFilter);
+
+    /// Set the wrap mode along both axes
+    void setWrap(GLuint wrap);
+
+    /// Remap the channels seen by shaders (e.g. luminance to gray)
+    void setSwizzle(GLint r, GLint g, GLint b, GLint a);
+
+    /// Bind the texture to the given texture unit
+    void bind(int unit = 0) const;
+
+    /// Unbind the texture from the given texture unit
+    void release(int unit = 0) const;
+
+    /// Release the texture object
+    void free();
+
+    /// Return whether or not the texture has been initialized
+    bool ready() const { return mTexture != 0; }
+
+    /// Return the OpenGL texture handle
+    GLuint id() const { return mTexture; }
+
+    /// Return the size of the texture
+    const Vector2i &size() const { return mSize; }
+
+    /// Return the internal format of the texture
+    GLuint internalFormat() const { return mInternalFormat; }
+
+    /// Return the size of the texture storage in bytes
+    size_t bytes() const {
+        return (size_t) mSize.x * (size_t) mSize.y * pixelSize(mFormat, mType);
+    }
+
+    /// Return the size of a pixel of the given format and type in bytes
+    static size_t pixelSize(GLuint format, GLuint type);
+protected:
+    GLuint mTexture;
+    Vector2i mSize;
+    GLuint mInternalFormat, mFormat, mType;
+};
+
 NAMESPACE_END(nanogui)
@@ -12,10 +12,30 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/samplering.h>
 #include <vector>
 
 NAMESPACE_BEGIN(nanogui)
 
+/**
+ * \brief Simple graph widget for showing a function plot
+ *
+ * Long series are reduced to a per-pixel-column min/max envelope before
+ * drawing, so the path never has more than two points per column and
+ * spikes remain visible. The envelope is cached until the values or the
+ * widget width change. Note that the non-const \ref values() accessor
+ * marks the values as modified; call \ref invalidate() when changing them
+ * through a reference that was obtained earlier.
+ *
+ * In streaming mode (see \ref setStreaming()), samples are instead pushed
+ * from arbitrary threads into a lock-free \ref SampleRing. Each push
+ * provides one value per series, so all series share the same time axis.
+ * At draw time, the graph drains the queue into a fixed-size history of the
+ * most recent samples and displays it; producers are never blocked. The
+ * minimum and maximum of fixed blocks of the history are kept up to date as
+ * samples arrive, so that the envelope of a long window only has to scan
+ * the partial blocks at the edges of each pixel column.
+ */
 class NANOGUI_EXPORT Graph : public Widget {
 public:
     Graph(ref<Widget> parent, const std::string &caption = "Untitled");
@@ -39,15 +59,98 @@ public:
     void setTextColor(const Color &textColor) { mTextColor = textColor; }
 
     const std::vector<float> &values() const { return mValues; }
-    std::vector<float> &values() { return mValues; }
-    void setValues(const std::vector<float> &values) { mValues = values; }
+    std::vector<float> &values() { mDirty = true; return mValues; }
+    void setValues(const std::vector<float> &values) { mValues = values; mDirty = true; }
+
+    /// Mark the values as modified so that the cached envelope is recomputed
+    void invalidate() { mDirty = true; }
+
+    /// Return whether values are rescaled to their [min, max] range (otherwise they must lie in [0, 1])
+    bool autoRange() const { return mAutoRange; }
+    /// Set whether values are rescaled to their [min, max] range
+    void setAutoRange(bool autoRange) { mAutoRange = autoRange; mDirty = true; }
+
+    /// Return the [min, max] range of the values as of the last draw call
+    const Vector2f &range() const { return mRange; }
+
+    /**
+     * \brief Switch the graph to streaming mode
+     *
+     * \param series
+     *     Number of values per time step. Passing 0 returns the graph to
+     *     displaying \ref values().
+     * \param window
+     *     Number of most recent time steps which are displayed
+     * \param capacity
+     *     Number of time steps which can be queued between two draw calls
+     *     (defaults to \c window)
+     *
+     * This function must not be called while other threads are pushing samples.
+     */
+    void setStreaming(int series, size_t window, size_t capacity = 0);
+    /// Return whether the graph is in streaming mode
+    bool streaming() const { return (bool) mRing; }
+    /// Return the number of series (1 unless in streaming mode)
+    int seriesCount() const { return mRing ? mRing->frameSize() : 1; }
+    /// Return the number of time steps displayed in streaming mode
+    size_t window() const { return mWindow; }
+
+    /// Return the line color of a series (used when more than one series is shown)
+    const Color &seriesColor(int series) const { return mSeriesColors[series]; }
+    /// Set the line color of a series (used when more than one series is shown)
+    void setSeriesColor(int series, const Color &color) { mSeriesColors[series] = color; }
+
+    /// Push one value per series (thread-safe). Returns \c false if the sample was dropped.
+    bool push(const float *values);
+    /// Push a sample of a graph with a single series (thread-safe)
+    bool push(float value) { return push(&value); }
+    /// Return the number of samples which were dropped because the queue was full
+    size_t droppedSamples() const { return mRing ? mRing->dropped() : 0; }
 
     virtual Vector2i preferredSize(NVGcontext *ctx) const;
     virtual void draw(NVGcontext *ctx);
+protected:
+    /// Recompute the normalized (and possibly decimated) points for a given number of pixel columns
+    void updateEnvelope(int columns);
+
+    /// Return the oldest displayed sample of a series and the number of samples
+    const float *seriesData(int series, size_t &count) const;
+
+    /// Move queued samples into the streaming history
+    void drainSamples();
+
+    /// Recompute the blocks covering \c count history slots starting at slot \c first
+    void updateBlocks(size_t first, size_t count);
+
+    /// Compute the minimum and maximum of the history slots [begin, end) (which may wrap around)
+    void historyMinMax(int series, size_t begin, size_t end, float &lo, float &hi) const;
+
+    /// Add the path of a series to the current NanoVG path
+    void tracePath(NVGcontext *ctx, int series, bool closed);
+
 protected:
     std::string mCaption, mHeader, mFooter;
     Color mBackgroundColor, mForegroundColor, mTextColor;
     std::vector<float> mValues;
+
+    /* Cached path: normalized values, or min/max pairs per pixel column */
+    std::vector<float> mEnvelope;
+    int mEnvelopeColumns;
+    bool mDecimated;
+    Vector2f mRange;
+    bool mAutoRange, mDirty;
+    size_t mEnvelopeStride;
+
+    /* Streaming mode: per series, the last 'mWindow' samples are stored
+       twice in a row so that they can always be read as one contiguous span */
+    std::unique_ptr<SampleRing> mRing;
+    std::vector<float> mHistory, mIncoming;
+    std::vector<Color> mSeriesColors;
+    size_t mWindow, mHead, mFilled;
+
+    /* Streaming mode: per series, (min, max) of each block of history slots */
+    std::vector<float> mBlocks;
+    std::atomic<bool> mWakeupPending;
 };
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,142 @@
+/*
+    nanogui/histogram.h -- Histogram widget with parallel binning of
+    large data sets
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Histogram of a (potentially very large) array of values
+ *
+ * Binning runs on a background thread owned by the widget, so the UI
+ * thread never waits for it; the displayed counts are replaced once a
+ * result is available. The kernel splits the data across all hardware
+ * threads, each of which accumulates into private bins (vectorized with
+ * SSE2 where available) that are merged at the end.
+ *
+ * Data appended with \ref appendValues() is binned incrementally. A full
+ * pass over all values only happens when the bin count or range change,
+ * or when appended values fall outside of an automatically chosen range.
+ */
+class NANOGUI_EXPORT Histogram : public Widget {
+public:
+    Histogram(ref<Widget> parent, const std::string &caption = "Untitled", int bins = 64);
+
+    /// Stop the binning thread
+    virtual ~Histogram();
+
+    const std::string &caption() const { return mCaption; }
+    void setCaption(const std::string &caption) { mCaption = caption; }
+
+    /// Replace the data set (the widget takes ownership of the values)
+    void setValues(std::vector<float> values);
+
+    /// Append values to the data set; only the new values are binned
+    void appendValues(const float *values, size_t count);
+
+    /// Return the number of bins
+    int binCount() const { return mBinCount; }
+    /// Set the number of bins (rebins the data in the background)
+    void setBinCount(int bins);
+
+    /// Return the range covered by the bins as of the latest result
+    const Vector2f &range() const { return mRange; }
+    /// Use a fixed range; values outside of it are counted as outliers
+    void setRange(const Vector2f &range);
+    /// Derive the range from the minimum and maximum of the data (the default)
+    void setAutoRange();
+
+    /// Return whether bar heights use a logarithmic scale
+    bool logScale() const { return mLogScale; }
+    void setLogScale(bool logScale) { mLogScale = logScale; }
+
+    /// Return the bin counts as of the latest result
+    const std::vector<uint64_t> &counts() const { return mCounts; }
+    /// Return the total number of values as of the latest result
+    uint64_t total() const { return mTotal; }
+    /// Return the number of values outside of the range (or NaN) as of the latest result
+    uint64_t outliers() const { return mOutliers; }
+
+    /// Return whether binning work is queued or in progress
+    bool busy() const { return mPendingJobs > 0; }
+
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    void setBackgroundColor(const Color &backgroundColor) { mBackgroundColor = backgroundColor; }
+
+    const Color &foregroundColor() const { return mForegroundColor; }
+    void setForegroundColor(const Color &foregroundColor) { mForegroundColor = foregroundColor; }
+
+    const Color &textColor() const { return mTextColor; }
+    void setTextColor(const Color &textColor) { mTextColor = textColor; }
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    /// Unit of work for the binning thread (parameters are captured at submission)
+    struct Job {
+        enum Type { Reset, Append, Rebin } type;
+        std::vector<float> values;
+        int bins;
+        Vector2f range;
+        bool autoRange;
+    };
+
+    void submit(Job::Type type, std::vector<float> values = std::vector<float>());
+
+    /// Main loop of the binning thread
+    void worker();
+
+    /// Bin all values from scratch (binning thread only)
+    void binAll(const Job &job);
+
+    /// Fetch the latest result from the binning thread (UI thread only)
+    void fetchResult();
+
+protected:
+    std::string mCaption;
+    Color mBackgroundColor, mForegroundColor, mTextColor;
+    bool mLogScale;
+
+    /* State seen by the UI thread */
+    int mBinCount;
+    bool mAutoRange;
+    Vector2f mRange, mFixedRange;
+    std::vector<uint64_t> mCounts;
+    uint64_t mTotal, mOutliers;
+
+    /* Job queue and latest result (guarded by mMutex) */
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Job> mJobs;
+    bool mStop, mResultReady;
+    std::vector<uint64_t> mResultCounts;
+    Vector2f mResultRange;
+    uint64_t mResultTotal, mResultOutliers;
+    std::atomic<int> mPendingJobs;
+
+    /* Owned by the binning thread */
+    std::vector<float> mValues;
+    std::vector<uint64_t> mWorkerCounts;
+    Vector2f mWorkerRange;
+};
+
+NAMESPACE_END(nanogui)
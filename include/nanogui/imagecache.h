@@ -0,0 +1,155 @@
+/*
+    nanogui/imagecache.h -- Per-context cache of NanoVG images with
+    memory accounting and LRU eviction
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Keeps track of the images created in a NanoVG context
+ *
+ * Each NanoVG context owns exactly one cache (see \ref get()). Every image
+ * is registered under a string key and accounts for its texture memory.
+ * Images which know how to recreate themselves (files, data segments,
+ * user-provided loaders) may be evicted in least-recently-used order when
+ * the memory budget is exceeded; they are reloaded lazily the next time
+ * they are requested through \ref image(). Image IDs obtained this way are
+ * only guaranteed to remain valid until the end of the current frame, so
+ * widgets should look them up whenever they draw.
+ *
+ * Pinned images (including those handed out by \ref nvgImageIcon and
+ * \ref loadImageDirectory(), whose IDs are retained by callers) are
+ * accounted for but never evicted.
+ */
+class NANOGUI_EXPORT ImageCache {
+public:
+    /// Function which (re)creates an image and returns its NanoVG ID (0 on failure)
+    typedef std::function<int(NVGcontext *)> Loader;
+
+    /// Return the cache of a NanoVG context, optionally creating it
+    static ImageCache *get(NVGcontext *ctx, bool create = true);
+
+    /// Delete the cache of a NanoVG context and all images it owns
+    static void release(NVGcontext *ctx);
+
+    /// Return the NanoVG context associated with this cache
+    NVGcontext *context() const { return mContext; }
+
+    /**
+     * \brief Return the image registered under \c key
+     *
+     * If the image was evicted, it is reloaded. If it does not exist yet and
+     * a \c loader is provided, the loader is invoked and the result is
+     * registered as an evictable image. Returns 0 if the image is unknown.
+     */
+    int image(const std::string &key, const Loader &loader = Loader());
+
+    /// Return an image loaded from a file (evictable; reloaded from disk on demand)
+    int imageFromFile(const std::string &filename, int imageFlags = 0);
+
+    /// Return an image decoded from memory that outlives the cache (evictable)
+    int imageFromMemory(const std::string &key, const uint8_t *data,
+                        uint32_t size, int imageFlags = 0);
+
+    /**
+     * \brief Register an image that was created elsewhere
+     *
+     * The cache takes ownership of the image and accounts for its memory.
+     * Without a \c loader, the image can not be reloaded and is never evicted.
+     */
+    void insert(const std::string &key, int image, const Loader &loader = Loader());
+
+    /// Delete the image registered under \c key
+    void remove(const std::string &key);
+
+    /// Check whether an image is registered under \c key (loaded or not)
+    bool contains(const std::string &key) const { return mEntries.count(key) != 0; }
+
+    /// Prevent (or allow) eviction of a registered image
+    void setPinned(const std::string &key, bool pinned);
+
+    /// Mark the start of a new frame; images used in the current frame are never evicted
+    void beginFrame() { mFrame++; evict(); }
+
+    /// Return the texture memory budget in bytes (0: unlimited)
+    size_t budget() const { return mBudget; }
+
+    /// Set the texture memory budget in bytes (0: unlimited)
+    void setBudget(size_t budget) { mBudget = budget; evict(); }
+
+    /// Return the texture memory currently used by loaded images in bytes
+    size_t usage() const { return mUsage; }
+
+    /// Return the number of registered images
+    size_t imageCount() const { return mEntries.size(); }
+
+    /// Return the number of currently loaded images
+    size_t loadedCount() const { return mLoaded; }
+
+    /// Return the number of evictions since the cache was created
+    size_t evictions() const { return mEvictions; }
+
+    /// Return the number of (re)loads since the cache was created
+    size_t loads() const { return mLoads; }
+
+    ~ImageCache();
+
+protected:
+    struct Entry {
+        int image = 0;
+        size_t bytes = 0;
+        int flags = 0;
+        Loader loader;
+        bool pinned = false;
+        uint64_t lastUsed = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    ImageCache(NVGcontext *ctx) : mContext(ctx) { }
+
+    /// Register a new evictable image and load it
+    int create(const std::string &key, const Loader &loader, int imageFlags);
+
+    /// Load an image through its loader and account for its memory
+    bool load(Entry &entry);
+
+    /// Free an image but keep its entry so that it can be reloaded
+    void unload(Entry &entry);
+
+    /// Mark an entry as most recently used
+    void touch(Entry &entry);
+
+    /// Evict least recently used images until the budget is met
+    void evict();
+
+    /// Return the texture memory of an image in bytes
+    size_t imageBytes(int image, int imageFlags) const;
+
+protected:
+    NVGcontext *mContext;
+    std::unordered_map<std::string, Entry> mEntries;
+    std::list<std::string> mLRU; /* Most recently used first */
+    size_t mBudget = 0;
+    size_t mUsage = 0;
+    size_t mLoaded = 0;
+    size_t mEvictions = 0;
+    size_t mLoads = 0;
+    uint64_t mFrame = 1;
+};
+
+NAMESPACE_END(nanogui)
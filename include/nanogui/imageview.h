@@ -13,9 +13,20 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
 
 NAMESPACE_BEGIN(nanogui)
 
+/**
+ * \brief Shows a NanoVG image or a high dynamic range texture
+ *
+ * Besides regular NanoVG images, the widget can display 8 bit, half and
+ * single precision pixel data with 1-4 channels. Such data is uploaded
+ * as-is into a floating point texture, and exposure, gamma and false-color
+ * mapping are applied by a fragment shader which renders into an RGBA8
+ * texture that NanoVG then composites. The shader only runs again when the
+ * data or one of the mapping parameters changes.
+ */
 class NANOGUI_EXPORT ImageView : public Widget {
 public:
     enum class SizePolicy {
@@ -25,18 +36,66 @@ public:
 
     ImageView(ref<Widget> parent, int image = 0, SizePolicy policy = SizePolicy::Fixed);
 
-    void setImage(int img)      { mImage = img; }
+    /// Release the textures used for high dynamic range images
+    virtual ~ImageView();
+
+    void setImage(int img)      { freeImageData(); mImage = img; }
     int  image() const          { return mImage; }
 
     void       setPolicy(SizePolicy policy) { mPolicy = policy; }
     SizePolicy policy() const { return mPolicy; }
 
+    /**
+     * \brief Display raw pixel data (\c uint8_t, \c half_float::half or \c float)
+     *
+     * Rows are expected from top to bottom with \c channels interleaved
+     * components per pixel (1: luminance, 2: luminance+alpha, 3: RGB, 4: RGBA).
+     * The data is uploaded immediately, so the OpenGL context of the
+     * surrounding \ref Screen must be current.
+     */
+    template <typename T> void setImageData(const T *data, const Vector2i &size, int channels = 4) {
+        setImageData((const uint8_t *) data, size, channels, (GLuint) type_traits<T>::type);
+    }
+
+    /// Byte-level version of \ref setImageData(); \c glType is e.g. \c GL_FLOAT
+    void setImageData(const uint8_t *data, const Vector2i &size, int channels, GLuint glType);
+
+    /// Free the texture used by \ref setImageData(), if any
+    void freeImageData();
+
+    /// Return the exposure (in stops) applied to high dynamic range data
+    float exposure() const { return mExposure; }
+    /// Set the exposure (in stops) applied to high dynamic range data
+    void setExposure(float exposure) { mExposure = exposure; mDirty = true; }
+
+    /// Return the display gamma applied to high dynamic range data
+    float gamma() const { return mGamma; }
+    /// Set the display gamma applied to high dynamic range data
+    void setGamma(float gamma) { mGamma = gamma; mDirty = true; }
+
+    /// Return whether luminance is shown using a false-color map
+    bool falseColor() const { return mFalseColor; }
+    /// Show luminance using a false-color map instead of the gamma curve
+    void setFalseColor(bool falseColor) { mFalseColor = falseColor; mDirty = true; }
+
     virtual Vector2i preferredSize(NVGcontext *ctx);
     virtual void draw(NVGcontext* ctx);
 
+protected:
+    /// Run the tone mapping shader (if needed) and return the resulting NanoVG image
+    int toneMappedImage(NVGcontext *ctx);
+
 protected:
     int mImage;
     SizePolicy mPolicy;
+
+    /* High dynamic range display */
+    NVGcontext *mContext;
+    GLShader mToneMapShader;
+    GLTexture mSourceTexture;
+    GLOffscreenTarget mOffscreen;
+    float mExposure, mGamma;
+    bool mFalseColor, mDirty;
 };
 
 NAMESPACE_END(nanogui)
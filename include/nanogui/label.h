@@ -19,7 +19,9 @@ NAMESPACE_BEGIN(nanogui)
  * \brief Text label widget
  *
  * The font and color can be customized. When \ref Widget::setFixedWidth()
- * is used, the text is wrapped when it surpasses the specified width
+ * is used, the text is wrapped when it surpasses the specified width.
+ * Otherwise, it is wrapped when it surpasses the width that the layout
+ * of the parent makes available.
  */
 class NANOGUI_EXPORT Label : public Widget {
 public:
@@ -14,6 +14,8 @@
 #pragma once
 
 #include <nanogui/object.h>
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 
 NAMESPACE_BEGIN(nanogui)
@@ -30,11 +32,103 @@ enum class Orientation {
     Vertical
 };
 
-/// Basic interface of a layout engine
+/**
+ * \brief Bounds on the size of a widget that is being measured
+ *
+ * An axis whose maximum is \ref Unbounded is unconstrained. Layouts pass
+ * the space that is available to a child (e.g. the width of a column) to
+ * \ref Widget::measure(), so that its size can depend on it.
+ */
+struct NANOGUI_EXPORT LayoutConstraints {
+    static constexpr int Unbounded = std::numeric_limits<int>::max();
+
+    Vector2i min, max;
+
+    /// Create constraints without any bounds
+    LayoutConstraints() : min(0), max(Unbounded) { }
+
+    LayoutConstraints(const Vector2i &min, const Vector2i &max) : min(min), max(max) { }
+
+    /// Return whether the maximum along an axis is bounded
+    bool bounded(int axis) const { return max[axis] != Unbounded; }
+
+    /// Set the maximum along an axis (a negative value means zero)
+    void setMax(int axis, int value) {
+        max[axis] = std::max(value, 0);
+        min[axis] = std::min(min[axis], max[axis]);
+    }
+
+    /// Return the constraints that remain after subtracting \c amount (e.g. margins) on each axis
+    LayoutConstraints shrink(const Vector2i &amount) const {
+        LayoutConstraints result(glm::max(min - amount, Vector2i(0)), max);
+        for (int i = 0; i < 2; ++i)
+            if (bounded(i))
+                result.setMax(i, max[i] - amount[i]);
+        return result;
+    }
+
+    /// Clamp a size to the constraints
+    Vector2i constrain(const Vector2i &size) const {
+        return glm::min(glm::max(size, min), max);
+    }
+
+    bool operator==(const LayoutConstraints &c) const { return min == c.min && max == c.max; }
+    bool operator!=(const LayoutConstraints &c) const { return !operator==(c); }
+};
+
+/**
+ * \brief Scope of a layout pass
+ *
+ * While at least one pass is active, \ref Widget::measure() reuses the
+ * size computed for the same constraints, so that every widget of a deeply
+ * nested hierarchy is measured once per pass instead of once for each
+ * ancestor that asks. The cache is discarded when the outermost pass ends.
+ * \ref Widget::measure(), \ref Widget::preferredSize() and
+ * \ref Widget::performLayout() open a pass if none is active; code that
+ * measures and arranges in separate calls should wrap them in one pass.
+ */
+class NANOGUI_EXPORT LayoutPass {
+public:
+    LayoutPass();
+    ~LayoutPass();
+
+    /// Return the id of the active pass (zero if there is none)
+    static uint64_t current();
+};
+
+/**
+ * \brief Basic interface of a layout engine
+ *
+ * Layouts implement two passes: \ref measure() computes the size that a
+ * widget needs for its children under the given constraints, and
+ * \ref arrange() positions and sizes the children within the current size
+ * of the widget. Children are measured with \ref Widget::measure() (which
+ * accounts for fixed sizes and caches its result) and placed with
+ * \ref Widget::arrange().
+ *
+ * \ref preferredSize() and \ref performLayout() are the previous form of
+ * this interface and remain the entry points that \ref Widget calls. By
+ * default they forward to the new one (with the constraints of the
+ * measurement in progress), and vice versa, so a layout has to override one
+ * method of each pair. Subclasses of the built-in layouts may therefore
+ * customize either form. If a layout overrides neither, the default
+ * implementations throw \c std::runtime_error instead of calling each
+ * other forever.
+ */
 class NANOGUI_EXPORT Layout : public std::enable_shared_from_this<Layout> {
 public:
-    virtual void performLayout(NVGcontext *ctx, ref<Widget> widget) const = 0;
-    virtual Vector2i preferredSize(NVGcontext *ctx, ref<Widget> widget) const = 0;
+    /// Return the size that \c widget needs for its children under \c constraints
+    virtual Vector2i measure(NVGcontext *ctx, ref<Widget> widget,
+                             const LayoutConstraints &constraints) const;
+
+    /// Position and size the children within the current size of \c widget
+    virtual void arrange(NVGcontext *ctx, ref<Widget> widget) const;
+
+    /// Previous form of \ref arrange(), called by \ref Widget::performLayout()
+    virtual void performLayout(NVGcontext *ctx, ref<Widget> widget) const;
+
+    /// Previous form of \ref measure(), called by \ref Widget::preferredSize()
+    virtual Vector2i preferredSize(NVGcontext *ctx, ref<Widget> widget) const;
 protected:
     virtual ~Layout() { }
 };
@@ -73,16 +167,15 @@ public:
     void setSpacing(int spacing) { mSpacing = spacing; }
 
     /* Implementation of the layout interface */
-    Vector2i preferredSize(NVGcontext *ctx, const ref<Widget> widget) const;
-    void performLayout(NVGcontext *ctx, ref<Widget> widget) const;
+    Vector2i measure(NVGcontext *ctx, ref<Widget> widget,
+                     const LayoutConstraints &constraints) const;
+    void arrange(NVGcontext *ctx, ref<Widget> widget) const;
 
 protected:
     Orientation mOrientation;
     Alignment mAlignment;
     int mMargin;
     int mSpacing;
-
-	mutable float maxAxis2Size = 0;
 };
 
 /**
@@ -115,8 +208,9 @@ public:
     void setGroupSpacing(int groupSpacing) { mGroupSpacing = groupSpacing; }
 
     /* Implementation of the layout interface */
-    Vector2i preferredSize(NVGcontext *ctx, const ref<Widget> widget) const;
-    void performLayout(NVGcontext *ctx, ref<Widget> widget) const;
+    Vector2i measure(NVGcontext *ctx, ref<Widget> widget,
+                     const LayoutConstraints &constraints) const;
+    void arrange(NVGcontext *ctx, ref<Widget> widget) const;
 
 protected:
     int mMargin;
@@ -172,13 +266,14 @@ public:
     void setRowAlignment(const std::vector<Alignment> &value) { mAlignment[1] = value; }
 
     /* Implementation of the layout interface */
-    Vector2i preferredSize(NVGcontext *ctx, const ref<Widget> widget) const;
-    void performLayout(NVGcontext *ctx, ref<Widget> widget) const;
+    Vector2i measure(NVGcontext *ctx, ref<Widget> widget,
+                     const LayoutConstraints &constraints) const;
+    void arrange(NVGcontext *ctx, ref<Widget> widget) const;
 
 protected:
-    // Compute the maximum row and column sizes
+    // Compute the maximum row and column sizes (and the sizes of the children)
     void computeLayout(NVGcontext *ctx, const ref<Widget> widget,
-                       std::vector<int> *grid) const;
+                       std::vector<int> *grid, std::vector<Vector2i> *sizes = nullptr) const;
 
 protected:
     Orientation mOrientation;
@@ -284,8 +379,9 @@ public:
     }
 
     /* Implementation of the layout interface */
-    Vector2i preferredSize(NVGcontext *ctx, const ref<Widget> widget) const;
-    void performLayout(NVGcontext *ctx, ref<Widget> widget) const;
+    Vector2i measure(NVGcontext *ctx, ref<Widget> widget,
+                     const LayoutConstraints &constraints) const;
+    void arrange(NVGcontext *ctx, ref<Widget> widget) const;
 
 protected:
     void computeLayout(NVGcontext *ctx, const ref<Widget> widget,
@@ -29,10 +29,19 @@
 #include <nanogui/messagedialog.h>
 #include <nanogui/textbox.h>
 #include <nanogui/slider.h>
+#include <nanogui/imagecache.h>
 #include <nanogui/imagepanel.h>
 #include <nanogui/imageview.h>
+#include <nanogui/videoview.h>
 #include <nanogui/vscrollpanel.h>
+#include <nanogui/samplering.h>
 #include <nanogui/graph.h>
+#include <nanogui/histogram.h>
+#include <nanogui/plot.h>
+#include <nanogui/scatterplot.h>
+#include <nanogui/sparklinegrid.h>
+#include <nanogui/waterfall.h>
+#include <nanogui/glcanvas.h>
 #include <nanogui/divider.h>
 //#include <nanogui/formhelper.h>
 //#include <nanogui/colorwheel.h>
@@ -0,0 +1,218 @@
+/*
+    nanogui/plot.h -- Zoomable multi-channel time series plot backed by a
+    memory-mapped sample file and a precomputed min/max pyramid
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Out-of-core multi-channel sample recording
+ *
+ * The sample file contains interleaved 32-bit floats (one value per channel
+ * and frame) without a header; it is memory-mapped rather than read. Next
+ * to it lives a sidecar file (\ref indexFilename()) holding a min/max
+ * pyramid: level \c l stores, for each block of <tt>LevelFactor^l</tt>
+ * frames, the minimum and maximum of every channel. The pyramid is about
+ * <tt>2 / (LevelFactor - 1)</tt> times the size of the recording.
+ *
+ * The sidecar records the size and modification time of the recording;
+ * when it is missing or does not match the recording, it is built
+ * by a background thread (see \ref buildIndex()), and \ref indexed() becomes
+ * true once it is available. \ref envelope() reads only the level matching
+ * the requested resolution, so its cost depends on the number of columns
+ * but not on the length of the recording.
+ */
+class NANOGUI_EXPORT PlotData {
+public:
+    /// Reduction factor between two consecutive pyramid levels
+    static const int LevelFactor = 8;
+
+    /**
+     * \brief Open a recording
+     *
+     * \param filename   Path of the sample file
+     * \param channels   Number of interleaved channels
+     * \param sampleRate Number of frames per second
+     * \param indexInBackground
+     *     Build a missing or outdated sidecar file on a background thread.
+     *     Otherwise, zoomed-out views stay unavailable until the sidecar
+     *     exists, and \ref Plot shows "No index" instead of the progress.
+     */
+    PlotData(const std::string &filename, int channels, double sampleRate,
+             bool indexInBackground = true);
+    ~PlotData();
+
+    const std::string &filename() const { return mFilename; }
+    int channels() const { return mChannels; }
+    double sampleRate() const { return mSampleRate; }
+    /// Return the number of frames in the recording
+    uint64_t frameCount() const { return mFrameCount; }
+    /// Return the length of the recording in seconds
+    double duration() const { return mFrameCount / mSampleRate; }
+
+    /// Return a single sample
+    float sample(uint64_t frame, int channel) const;
+
+    /// Return whether the min/max pyramid is available (maps it once the indexer is done)
+    bool indexed();
+    /// Return the progress of the background indexer in [0, 1]
+    float indexProgress() const { return mProgress; }
+    /// Return whether the background indexer is running (or its result is not yet mapped)
+    bool indexing() const { return mIndexer.joinable(); }
+
+    /**
+     * \brief Compute the minimum and maximum of a channel over a number of columns
+     *
+     * The frame range <tt>[start, end)</tt> is split into \c columns equal
+     * parts, and their minima and maxima are written to <tt>out[2*i]</tt> and
+     * <tt>out[2*i+1]</tt> (NaN for columns outside of the recording).
+     * Returns \c false when the resolution requires the pyramid and it is not
+     * yet available.
+     */
+    bool envelope(int channel, double start, double end, int columns, float *out);
+
+    /// Return the name of the sidecar file for a sample file
+    static std::string indexFilename(const std::string &filename) { return filename + ".lod"; }
+
+    /**
+     * \brief Build the sidecar file for a sample file (blocking)
+     *
+     * The file is streamed once; memory usage is independent of its size.
+     * \c progress (if given) receives values in [0, 1], and setting
+     * \c cancel aborts the operation. Returns \c true on success.
+     */
+    static bool buildIndex(const std::string &filename, int channels,
+                           std::atomic<float> *progress = nullptr,
+                           const std::atomic<bool> *cancel = nullptr);
+
+protected:
+    struct MappedFile;
+
+    /// Map the sidecar file if it exists and matches the recording
+    bool openIndex();
+
+protected:
+    std::string mFilename;
+    int mChannels;
+    double mSampleRate;
+    uint64_t mFrameCount;
+    std::unique_ptr<MappedFile> mSamples, mIndex;
+
+    /* Pyramid levels 1, 2, ... within the mapped sidecar file (min/max pairs) */
+    std::vector<const float *> mLevels;
+    std::vector<uint64_t> mLevelSizes;
+
+    std::thread mIndexer;
+    std::atomic<float> mProgress;
+    std::atomic<bool> mIndexerDone, mCancel;
+};
+
+/**
+ * \brief Time series plot of a \ref PlotData recording
+ *
+ * Scroll to zoom around the mouse cursor and drag to pan. The plot shows a
+ * time axis, a value axis and a readout of all channels at the cursor
+ * position. Each channel is drawn as a min/max envelope with at most two
+ * points per pixel column.
+ */
+class NANOGUI_EXPORT Plot : public Widget {
+public:
+    Plot(ref<Widget> parent, const std::string &caption = "");
+
+    const std::string &caption() const { return mCaption; }
+    void setCaption(const std::string &caption) { mCaption = caption; }
+
+    ref<PlotData> data() const { return mData; }
+    /// Set the displayed recording and show it in its entirety
+    void setData(ref<PlotData> data);
+
+    /// Return the start of the visible time range in seconds
+    double viewStart() const { return mViewStart; }
+    /// Return the end of the visible time range in seconds
+    double viewEnd() const { return mViewEnd; }
+    /// Set the visible time range in seconds
+    void setView(double start, double end);
+
+    /// Return whether the value axis adapts to the visible data
+    bool autoScale() const { return mAutoScale; }
+    void setAutoScale(bool autoScale) { mAutoScale = autoScale; }
+
+    /// Return the displayed value range (updated on every draw in auto scale mode)
+    const Vector2f &valueRange() const { return mValueRange; }
+    /// Set a fixed value range (disables auto scale mode)
+    void setValueRange(const Vector2f &range) { mValueRange = range; mAutoScale = false; }
+
+    const std::string &channelName(int channel) const { return mChannelInfo[channel].name; }
+    void setChannelName(int channel, const std::string &name) { mChannelInfo[channel].name = name; }
+
+    const Color &channelColor(int channel) const { return mChannelInfo[channel].color; }
+    void setChannelColor(int channel, const Color &color) { mChannelInfo[channel].color = color; }
+
+    bool channelVisible(int channel) const { return mChannelInfo[channel].visible; }
+    void setChannelVisible(int channel, bool visible) { mChannelInfo[channel].visible = visible; }
+
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    void setBackgroundColor(const Color &backgroundColor) { mBackgroundColor = backgroundColor; }
+
+    const Color &textColor() const { return mTextColor; }
+    void setTextColor(const Color &textColor) { mTextColor = textColor; }
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual bool mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers);
+    virtual bool mouseMotionEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers);
+    virtual bool mouseDragEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers);
+    virtual bool mouseEnterEvent(const Vector2i &p, bool enter);
+    virtual bool scrollEvent(const Vector2i &p, const Vector2f &rel);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    struct ChannelInfo {
+        std::string name;
+        Color color;
+        bool visible;
+    };
+
+    /// Return the origin and size of the data area (excluding axes) in parent coordinates
+    void plotArea(Vector2f &origin, Vector2f &size) const;
+
+    /// Convert a horizontal position in parent coordinates to a time in seconds
+    double timeAt(int x) const;
+
+    void drawAxes(NVGcontext *ctx, const Vector2f &origin, const Vector2f &size);
+    void drawReadout(NVGcontext *ctx, const Vector2f &origin, const Vector2f &size);
+
+protected:
+    std::string mCaption;
+    ref<PlotData> mData;
+    std::vector<ChannelInfo> mChannelInfo;
+    double mViewStart, mViewEnd;
+    Vector2f mValueRange;
+    bool mAutoScale;
+    Color mBackgroundColor, mTextColor;
+
+    /* Per-column min/max pairs of each channel for the current view */
+    std::vector<float> mEnvelope;
+    int mColumns;
+    bool mComplete;
+
+    /* Cursor position in parent coordinates, if the mouse is over the plot */
+    Vector2i mCursor;
+    bool mCursorVisible;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,73 @@
+/*
+    nanogui/samplering.h -- Fixed-capacity lock-free queue of sample frames
+    for feeding plots from producer threads
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Bounded multi-producer, single-consumer queue of sample frames
+ *
+ * A frame consists of \ref frameSize() floats (e.g. one value per plotted
+ * series at a given time step). Any number of threads may call \ref push()
+ * concurrently; exactly one thread (normally the one drawing the UI) calls
+ * \ref pop(). Neither side ever blocks or allocates: when the queue is full,
+ * \ref push() discards the frame and returns \c false.
+ *
+ * The implementation uses a per-slot sequence number, so producers only
+ * contend on a single atomic counter and a partially written frame is
+ * never visible to the consumer.
+ */
+class NANOGUI_EXPORT SampleRing {
+public:
+    /// Create a queue holding at least \c capacity frames of \c frameSize floats
+    SampleRing(size_t capacity, int frameSize = 1);
+
+    /// Append a frame of \ref frameSize() values (thread-safe). Returns \c false when full.
+    bool push(const float *frame);
+    /// Append a single value to a queue with a frame size of 1 (thread-safe)
+    bool push(float value) { return push(&value); }
+
+    /// Move up to \c maxFrames frames into \c out (consumer thread only); returns the number of frames
+    size_t pop(float *out, size_t maxFrames);
+
+    /// Return the number of frames the queue can hold
+    size_t capacity() const { return mMask + 1; }
+    /// Return the number of floats per frame
+    int frameSize() const { return mFrameSize; }
+    /// Return the number of frames that were discarded because the queue was full
+    size_t dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    SampleRing(const SampleRing &) = delete;
+    SampleRing &operator=(const SampleRing &) = delete;
+
+    std::unique_ptr<std::atomic<size_t>[]> mSequence;
+    std::vector<float> mData;
+    size_t mMask;
+    int mFrameSize;
+    std::atomic<size_t> mDropped;
+
+    /* Keep the producer and consumer positions on separate cache lines
+       (padding rather than alignas, which plain 'new' does not honor before C++17) */
+    char mPad0[64];
+    std::atomic<size_t> mEnqueuePos;
+    char mPad1[64];
+    size_t mDequeuePos;
+};
+
+NAMESPACE_END(nanogui)
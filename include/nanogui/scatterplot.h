@@ -0,0 +1,152 @@
+/*
+    nanogui/scatterplot.h -- GPU-accelerated scatter plot for very large
+    point clouds
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Scatter plot which renders millions of points on the GPU
+ *
+ * Positions, colors and sizes are uploaded once into vertex buffers of a
+ * \ref GLShader and drawn as round point sprites into an offscreen texture
+ * that NanoVG then composites. Zooming and panning only change a uniform
+ * (the mapping from data to clip space), and the points are redrawn only
+ * when the view or the data change.
+ *
+ * Hover picking uses a uniform grid over the positions, which is built on a
+ * background thread whenever new points are set. Scroll to zoom around the
+ * cursor and drag to pan.
+ */
+class NANOGUI_EXPORT ScatterPlot : public Widget {
+public:
+    ScatterPlot(ref<Widget> parent);
+
+    /// Release GPU resources and stop the indexing thread
+    virtual ~ScatterPlot();
+
+    /**
+     * \brief Set the points to be displayed
+     *
+     * \c colors and \c sizes (diameters in pixels) are optional; when given,
+     * they must have one entry per point. The data is uploaded on the next
+     * draw call, and the view is reset to the bounding box of the points.
+     */
+    void setPoints(const std::vector<Vector2f> &positions,
+                   const std::vector<Color> &colors = std::vector<Color>(),
+                   const std::vector<float> &sizes = std::vector<float>());
+
+    /// Return the number of points
+    size_t pointCount() const { return mPositions.size(); }
+    /// Return the position of a point
+    const Vector2f &point(size_t index) const { return mPositions[index]; }
+
+    /// Return the color of points without a per-point color
+    const Color &pointColor() const { return mPointColor; }
+    void setPointColor(const Color &color) { mPointColor = color; mDirty = true; }
+
+    /// Return the diameter in pixels of points without a per-point size
+    float pointSize() const { return mPointSize; }
+    void setPointSize(float size) { mPointSize = size; mDirty = true; }
+
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    void setBackgroundColor(const Color &backgroundColor) { mBackgroundColor = backgroundColor; }
+
+    /// Return the lower left corner of the visible region in data coordinates
+    const Vector2f &viewMin() const { return mViewMin; }
+    /// Return the upper right corner of the visible region in data coordinates
+    const Vector2f &viewMax() const { return mViewMax; }
+    /// Set the visible region in data coordinates
+    void setView(const Vector2f &min, const Vector2f &max);
+    /// Show all points
+    void fitView();
+
+    /// Return the index of the point under the mouse cursor (-1 if none)
+    int hoverIndex() const { return mHoverIndex; }
+
+    /// Set a callback which is invoked when the point under the mouse cursor changes
+    std::function<void(int)> hoverCallback() const { return mHoverCallback; }
+    void setHoverCallback(const std::function<void(int)> &callback) { mHoverCallback = callback; }
+
+    /// Return whether the picking grid for the current points has been built
+    bool pickingReady();
+
+    /// Return the point closest to a position (in parent coordinates) within a pixel radius, or -1
+    int pick(const Vector2i &p, float radius);
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual bool mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers);
+    virtual bool mouseMotionEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers);
+    virtual bool mouseDragEvent(const Vector2i &p, const Vector2i &rel, int button, int modifiers);
+    virtual bool mouseEnterEvent(const Vector2i &p, bool enter);
+    virtual bool scrollEvent(const Vector2i &p, const Vector2f &rel);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    /// Uniform grid over the positions; points are sorted by cell
+    struct PickGrid {
+        Vector2f origin, cellSize;
+        Vector2i resolution;
+        std::vector<uint32_t> cellStart, indices;
+    };
+
+    /// Build a picking grid for the current positions (runs on the indexing thread)
+    void buildGrid();
+
+    /// Wait for the indexing thread to finish
+    void stopIndexer();
+
+    /// Upload pending point data into the vertex buffers
+    void uploadPoints();
+
+    /// Render the points into the offscreen target (if needed)
+    void renderPoints(NVGcontext *ctx);
+
+    /// Convert a position in parent coordinates to data coordinates
+    Vector2f toData(const Vector2i &p) const;
+
+    /// Convert data coordinates to a position in parent coordinates
+    Vector2f toScreen(const Vector2f &v) const;
+
+protected:
+    std::vector<Vector2f> mPositions;
+    Vector2f mBoundsMin, mBoundsMax, mViewMin, mViewMax;
+    Color mPointColor, mBackgroundColor;
+    float mPointSize;
+
+    /* Colors and sizes waiting to be uploaded (released afterwards) */
+    std::vector<uint8_t> mPendingColors;
+    std::vector<float> mPendingSizes;
+    bool mUploadPending;
+
+    /* Offscreen rendering */
+    GLShader mShader;
+    GLOffscreenTarget mOffscreen;
+    bool mDirty;
+
+    /* Hover picking */
+    std::thread mIndexer;
+    std::atomic<bool> mCancelIndexer;
+    std::mutex mGridMutex;
+    std::unique_ptr<PickGrid> mGrid, mPendingGrid;
+    int mHoverIndex;
+    std::function<void(int)> mHoverCallback;
+};
+
+NAMESPACE_END(nanogui)
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/imagecache.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -74,9 +75,43 @@ public:
     /// Return a pointer to the underlying GLFW window data structure
     GLFWwindow *glfwWindow() { return mGLFWWindow; }
 
+    /// Return the ratio between framebuffer pixels and window coordinates
+    float pixelRatio() const { return mPixelRatio; }
+
     /// Return a pointer to the underlying nanoVG draw context
     NVGcontext *nvgContext() { return mNVGContext; }
 
+    /// Return the image cache of the nanoVG draw context
+    ImageCache *imageCache() { return ImageCache::get(mNVGContext); }
+
+    /// Return the pool of offscreen render targets of this screen
+    GLRenderTargetPool *renderTargetPool();
+
+    /**
+     * \brief Enable or disable measuring GPU times
+     *
+     * When enabled, the GPU time of \ref drawContents() ("drawContents"),
+     * of the NanoVG rendering of all widgets ("widgets") and of the buffer
+     * swap ("swap") is measured every frame; further phases can be added
+     * through \ref gpuTimer() and \ref GLShader::setTimer().
+     */
+    void setGpuTiming(bool enabled);
+
+    /// Return the GPU timer (nullptr unless GPU timing is enabled)
+    GLTimer *gpuTimer() { return mGpuTimer.get(); }
+
+    /**
+     * \brief Start or stop recording the frames shown by this screen
+     *
+     * Every frame is captured by \ref drawAll() just before the buffers
+     * are swapped. Passing \c nullptr (or a different recorder) finishes
+     * the previous recording, i.e. writes its remaining frames.
+     */
+    void setRecorder(ref<ScreenRecorder> recorder);
+
+    /// Return the active recorder (nullptr unless recording)
+    ScreenRecorder *recorder() { return mRecorder.get(); }
+
     void setShutdownGLFWOnDestruct(bool v) { mShutdownGLFWOnDestruct = v; }
     bool shutdownGLFWOnDestruct() { return mShutdownGLFWOnDestruct; }
 
@@ -141,6 +176,9 @@ protected:
     Vector3f mBackground;
     std::string mCaption;
     bool mShutdownGLFWOnDestruct;
+    ref<GLTimer> mGpuTimer;
+    int mGpuPhases[3] = { -1, -1, -1 };
+    ref<ScreenRecorder> mRecorder;
 };
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,159 @@
+/*
+    nanogui/screenrecorder.h -- Records the frames shown by a screen to
+    disk without stalling the render loop
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/opengl.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Writes the frames shown by a \ref Screen to image files
+ *
+ * \ref capture() reads the back buffer into one of a small ring of pixel
+ * pack buffers and returns immediately. Once the fence of a readback has
+ * signaled (usually one or two frames later) the buffer is mapped and
+ * handed to a background thread, which writes the file straight from the
+ * mapping; the buffer is unmapped and reused after that. The render thread
+ * therefore never copies, encodes or waits for pixel data.
+ *
+ * If the writer cannot keep up and no buffer is free, the frame is dropped
+ * (see \ref Statistics::dropped) instead of stalling the render loop.
+ * Files are named \c prefix followed by a six digit frame number, e.g.
+ * \c "frames/shot_000042.png"; the directory must exist.
+ *
+ * See \ref Screen::setRecorder().
+ */
+class NANOGUI_EXPORT ScreenRecorder {
+public:
+    enum class Format {
+        /// RGB PNG files (uncompressed, which keeps the writer fast)
+        PNG,
+        /// Tightly packed 8 bit RGBA pixels, top row first, without a header
+        Raw
+    };
+
+    /// Recording statistics
+    struct Statistics {
+        /// Frames whose readback was started
+        size_t captured = 0;
+        /// Frames that were written to disk
+        size_t written = 0;
+        /// Frames that were skipped because no buffer was free
+        size_t dropped = 0;
+        /// Time spent in the previous call to \ref capture() in milliseconds
+        double lastTime = 0;
+        /// Maximum time spent in a call to \ref capture() in milliseconds
+        double maxTime = 0;
+    };
+
+    /// Create a recorder with \c depth pixel pack buffers and start its writer thread
+    ScreenRecorder(const std::string &prefix, Format format = Format::PNG, int depth = 3);
+
+    /// Stop the writer thread (call \ref finish() first to keep pending frames)
+    ~ScreenRecorder();
+
+    /// Return the file name prefix
+    const std::string &prefix() const { return mPrefix; }
+
+    /// Return the file format
+    Format format() const { return mFormat; }
+
+    /**
+     * \brief Start reading the back buffer of the default framebuffer
+     *
+     * Must be called with the context current, after the frame has been
+     * drawn and before the buffers are swapped.
+     */
+    void capture(const Vector2i &size);
+
+    /**
+     * \brief Write all captured frames (blocking) and release the buffers
+     *
+     * Does not throw: frames whose readback fails are counted as dropped and
+     * reported through \ref error().
+     */
+    void finish();
+
+    /// Return recording statistics
+    Statistics statistics();
+
+    /// Return the error of the latest failed write or readback, if any
+    std::string error();
+
+    /// Create the file name of a frame
+    std::string fileName(uint64_t frame) const;
+
+    /// Write a bottom-up RGBA image as an uncompressed RGB PNG file
+    static void writePNG(const std::string &fileName, const uint8_t *data, const Vector2i &size);
+
+    /// Write a bottom-up RGBA image as raw RGBA pixels (top row first)
+    static void writeRaw(const std::string &fileName, const uint8_t *data, const Vector2i &size);
+
+protected:
+    enum class SlotState { Free, Reading, Writing };
+
+    struct Slot {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        bool flushed = false;
+        Vector2i size = Vector2i(0);
+        uint64_t frame = 0;
+        SlotState state = SlotState::Free;
+    };
+
+    struct Job {
+        int slot;
+        const uint8_t *data;
+        Vector2i size;
+        uint64_t frame;
+    };
+
+    /**
+     * \brief Map the buffer of a slot whose readback has completed and queue
+     * it for writing
+     *
+     * Returns \c false and frees the slot if the buffer could not be mapped.
+     */
+    bool submit(int slot);
+
+    /// Unmap the buffers of slots that the writer has finished with
+    void reclaim();
+
+    void worker();
+
+protected:
+    std::string mPrefix;
+    Format mFormat;
+    std::vector<Slot> mSlots;
+    std::deque<int> mReading; /* Slots with a pending readback, oldest first */
+    uint64_t mFrame;
+    Statistics mStatistics;
+
+    /* Shared with the writer thread */
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<Job> mJobs;
+    std::vector<int> mDone;
+    std::string mError;
+    size_t mWritten;
+    bool mStop;
+};
+
+NAMESPACE_END(nanogui)
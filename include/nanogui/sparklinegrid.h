@@ -0,0 +1,131 @@
+/*
+    nanogui/sparklinegrid.h -- Grid of small area charts (sparklines)
+    rendered with a single instanced draw call
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Dashboard-style grid of sparklines which share a time axis
+ *
+ * Meant to replace large numbers of individual \ref Graph widgets: the
+ * history of all series lives in a single buffer texture (one column of
+ * samples per time step), and all visible sparklines are rendered by one
+ * instanced draw call into an offscreen texture that NanoVG composites.
+ * \ref push() appends a column; only the columns added since the last draw
+ * are uploaded. The chart pass only runs when data or the visible region
+ * change.
+ *
+ * Each cell shows a name and the latest value. Cells which are scrolled
+ * out of view (e.g. inside a \ref VScrollPanel) are skipped, both in the
+ * instanced draw and in the label pass.
+ *
+ * Values are scaled to a per-series range, which either follows the data
+ * (the default) or is fixed using \ref setRange().
+ */
+class NANOGUI_EXPORT SparklineGrid : public Widget {
+public:
+    SparklineGrid(ref<Widget> parent, int series = 0, int length = 128);
+
+    /// Release GPU resources
+    virtual ~SparklineGrid();
+
+    /// Change the number of series and the number of samples per series (clears all data)
+    void resize(int series, int length);
+
+    /// Return the number of series
+    int seriesCount() const { return mSeriesCount; }
+    /// Return the number of samples shown per series
+    int length() const { return mLength; }
+
+    const std::string &name(int series) const { return mNames[series]; }
+    void setName(int series, const std::string &name) { mNames[series] = name; }
+
+    /// Append one value per series (a new column of the shared time axis)
+    void push(const float *values);
+
+    /// Return the most recent value of a series
+    float latest(int series) const;
+
+    /// Return the value range a series is scaled to
+    Vector2f range(int series) const { return mRanges[series]; }
+    /// Scale a series to a fixed range
+    void setRange(int series, const Vector2f &range);
+    /// Scale a series to the range of its data (the default)
+    void setAutoRange(int series);
+
+    /// Return the size of a cell in pixels
+    const Vector2i &cellSize() const { return mCellSize; }
+    void setCellSize(const Vector2i &cellSize) { mCellSize = cellSize; mDirty = true; }
+
+    /// Return the spacing between cells in pixels
+    int spacing() const { return mSpacing; }
+    void setSpacing(int spacing) { mSpacing = spacing; mDirty = true; }
+
+    const Color &fillColor() const { return mFillColor; }
+    void setFillColor(const Color &color) { mFillColor = color; mDirty = true; }
+
+    const Color &lineColor() const { return mLineColor; }
+    void setLineColor(const Color &color) { mLineColor = color; mDirty = true; }
+
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    void setBackgroundColor(const Color &color) { mBackgroundColor = color; }
+
+    const Color &textColor() const { return mTextColor; }
+    void setTextColor(const Color &color) { mTextColor = color; }
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    /// Return the number of cells per row for the current width
+    int gridColumns() const;
+
+    /// Compute the part of the widget which is not clipped by its ancestors (local coordinates)
+    void visibleRegion(Vector2i &min, Vector2i &max) const;
+
+    /// Upload pending columns and ranges
+    void uploadData();
+
+    /// Draw the visible sparklines into the offscreen target (if needed)
+    void renderCharts(NVGcontext *ctx, const Vector2i &min, const Vector2i &max);
+
+protected:
+    int mSeriesCount, mLength;
+    std::vector<std::string> mNames;
+
+    /* History in column-major order: mValues[slot * mSeriesCount + series] */
+    std::vector<float> mValues;
+    int mHead, mFilled, mPendingColumns;
+
+    /* Per-series value ranges; automatic ranges are rescanned when an extremum leaves the window */
+    std::vector<Vector2f> mRanges;
+    std::vector<uint8_t> mAutoRange, mRescan;
+    bool mRangesDirty, mReallocate;
+
+    Vector2i mCellSize;
+    int mSpacing;
+    Color mFillColor, mLineColor, mBackgroundColor, mTextColor;
+
+    /* GPU resources: sample and range buffer textures, offscreen target */
+    GLuint mSampleBuffer, mSampleTexture, mRangeBuffer, mRangeTexture;
+    GLShader mShader;
+    GLOffscreenTarget mOffscreen;
+    Vector2i mRenderedMin, mRenderedMax;
+    bool mDirty;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,142 @@
+/*
+    nanogui/videoview.h -- Widget which displays a live stream of frames
+    (video playback, camera feeds) submitted from arbitrary threads
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
+#include <mutex>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Displays a stream of frames uploaded through pixel buffer objects
+ *
+ * Frames are handed over with \ref pushFrame(), which may be called from any
+ * thread. The UI thread keeps a ring of pixel buffer objects mapped, and
+ * producers copy their frames straight into this mapped memory. During
+ * \ref draw(), the newest complete frame is unmapped and transferred into the
+ * plane textures asynchronously; frames which were superseded before they
+ * could be displayed are dropped. YUV frames are converted to RGB by a
+ * fragment shader, so the UI thread never touches pixel data.
+ *
+ * Producers must stop calling \ref pushFrame() before the widget is destroyed.
+ */
+class NANOGUI_EXPORT VideoView : public Widget {
+public:
+    /// Layout of the frames passed to \ref pushFrame() (planes tightly packed, one after another)
+    enum class PixelFormat {
+        RGBA8,   ///< Interleaved 8 bit RGBA
+        YUV420P, ///< 8 bit Y, U and V planes (I420), chroma subsampled 2x2
+        NV12     ///< 8 bit Y plane followed by an interleaved UV plane, chroma subsampled 2x2
+    };
+
+    /// Matrix used to convert YUV frames to RGB (limited range)
+    enum class ColorSpace {
+        BT601,
+        BT709
+    };
+
+    VideoView(ref<Widget> parent, int bufferCount = 3);
+
+    /// Release all buffers and textures
+    virtual ~VideoView();
+
+    /**
+     * \brief Submit a frame (thread-safe)
+     *
+     * The data is copied before the function returns. If the previous frame
+     * has not been displayed yet, it is discarded in favor of this one.
+     */
+    void pushFrame(const uint8_t *data, const Vector2i &size, PixelFormat format);
+
+    /// Return the size in bytes of a frame with the given dimensions and format
+    static size_t frameBytes(const Vector2i &size, PixelFormat format);
+
+    ColorSpace colorSpace() const { return mColorSpace; }
+    void setColorSpace(ColorSpace colorSpace) { mColorSpace = colorSpace; mDirty = true; }
+
+    /// Return the size of the frame currently on screen
+    const Vector2i &frameSize() const { return mFrameSize; }
+
+    /// Return the number of frames which were displayed
+    size_t displayedFrames() const { return mDisplayedFrames; }
+
+    /// Return the number of frames which were dropped because a newer one arrived first
+    size_t droppedFrames() const { return mDroppedFrames; }
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    enum class SlotState {
+        Free,    ///< Unmapped, owned by the UI thread
+        Mapped,  ///< Mapped and available to producers
+        Writing, ///< A producer is copying a frame into it
+        Ready    ///< Holds a complete frame waiting to be uploaded
+    };
+
+    struct Slot {
+        GLuint pbo = 0;
+        uint8_t *ptr = nullptr;
+        size_t capacity = 0;
+        Vector2i size;
+        PixelFormat format = PixelFormat::RGBA8;
+        SlotState state = SlotState::Free;
+        uint64_t sequence = 0;
+    };
+
+    /// Transfer the newest frame (if any) into the plane textures
+    bool uploadFrame();
+
+    /// Map the free buffers for the layout producers are currently submitting
+    void mapSlots();
+
+    /// (Re)allocate the plane textures for a given layout
+    void initPlanes(const Vector2i &size, PixelFormat format);
+
+    /// Upload all planes from a CPU pointer or an offset into the bound unpack buffer
+    void uploadPlanes(const uint8_t *data);
+
+    /// Convert the current YUV planes into the RGB target texture
+    void convert();
+
+protected:
+    std::vector<Slot> mSlots;
+    std::mutex mMutex;
+
+    /* Fallback for frames that arrive while no buffer of the right layout is mapped */
+    std::vector<uint8_t> mFallback;
+    Vector2i mFallbackSize;
+    PixelFormat mFallbackFormat;
+    uint64_t mFallbackSequence;
+    bool mHasFallback;
+
+    Vector2i mRequestedSize;
+    PixelFormat mRequestedFormat;
+    uint64_t mSequence;
+
+    /* UI thread state */
+    NVGcontext *mContext;
+    GLTexture mPlanes[3];
+    GLOffscreenTarget mOffscreen;
+    GLShader mConvertShader;
+    int mImage;
+    Vector2i mFrameSize;
+    PixelFormat mFrameFormat;
+    ColorSpace mColorSpace;
+    bool mDirty;
+
+    std::atomic<size_t> mDisplayedFrames, mDroppedFrames;
+};
+
+NAMESPACE_END(nanogui)
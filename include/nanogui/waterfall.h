@@ -0,0 +1,114 @@
+/*
+    nanogui/waterfall.h -- Scrolling heatmap for spectrograms and other
+    waterfall displays
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/widget.h>
+#include <nanogui/glrendertarget.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Scrolling heatmap of the most recent rows of a 2D signal
+ *
+ * Every row (e.g. the magnitudes of one FFT) is written into a circular
+ * floating point texture holding the whole history, and only rows that
+ * were added since the last frame are uploaded. Scrolling is implemented
+ * by shifting the texture coordinates in the shader, and values are mapped
+ * to colors through a lookup texture, so the per-frame upload bandwidth
+ * only depends on the number of new rows.
+ *
+ * \ref pushRow() may be called from any thread.
+ */
+class NANOGUI_EXPORT Waterfall : public Widget {
+public:
+    /// Direction in which the display scrolls
+    enum class Orientation {
+        Vertical,   ///< Newest row at the top, bins from left to right
+        Horizontal  ///< Newest row at the right, bins from bottom to top
+    };
+
+    /// Predefined color maps
+    enum class Colormap {
+        Grayscale,
+        Viridis,
+        Turbo
+    };
+
+    Waterfall(ref<Widget> parent, int bins = 512, int history = 1024);
+
+    /// Release GPU resources
+    virtual ~Waterfall();
+
+    /// Change the number of bins per row and the number of rows kept (clears all data)
+    void resize(int bins, int history);
+
+    /// Return the number of values per row
+    int bins() const { return mBins; }
+    /// Return the number of rows kept
+    int history() const { return mHistory; }
+
+    /// Append a row of \ref bins() values (thread-safe)
+    void pushRow(const float *values);
+
+    /// Return the value range mapped onto the color map
+    const Vector2f &range() const { return mRange; }
+    /// Set the value range mapped onto the color map (must be increasing)
+    void setRange(const Vector2f &range);
+
+    Orientation orientation() const { return mOrientation; }
+    void setOrientation(Orientation orientation) { mOrientation = orientation; mDirty = true; }
+
+    /// Use one of the predefined color maps
+    void setColormap(Colormap colormap);
+    /// Use a custom color map (at least two colors, evenly spaced from low to high values)
+    void setColormap(const std::vector<Color> &colors);
+
+    const Color &backgroundColor() const { return mBackgroundColor; }
+    void setBackgroundColor(const Color &color) { mBackgroundColor = color; }
+
+    virtual Vector2i preferredSize(NVGcontext *ctx);
+    virtual void draw(NVGcontext *ctx);
+
+protected:
+    /// Upload the rows pushed since the last call
+    void uploadRows();
+
+    /// Render the heatmap into the offscreen target (if needed)
+    void renderHeatmap(NVGcontext *ctx);
+
+protected:
+    int mBins, mHistory;
+
+    /* Rows pushed by producers but not yet uploaded (guarded by mMutex) */
+    std::mutex mMutex;
+    std::vector<float> mPending, mUploading;
+    std::atomic<bool> mWakeupPending;
+
+    /* Next texture row to be written, number of valid rows */
+    int mHead, mFilled;
+
+    Vector2f mRange;
+    Orientation mOrientation;
+    std::vector<uint8_t> mLut;
+    Color mBackgroundColor;
+
+    GLShader mShader;
+    GLTexture mData, mLutTexture;
+    GLOffscreenTarget mOffscreen;
+    bool mReallocate, mLutDirty, mDirty;
+};
+
+NAMESPACE_END(nanogui)
@@ -12,6 +12,7 @@
 #pragma once
 
 #include <nanogui/object.h>
+#include <nanogui/layout.h>
 #include <vector>
 #include <nanovg.h>
 #include <atomic>
@@ -28,6 +29,7 @@ enum class Cursor;
  * widgets using a layout generator (see \ref Layout).
  */
 class NANOGUI_EXPORT Widget : public std::enable_shared_from_this<Widget> {
+    friend class Layout;
 public:
     /// Construct a new widget with the given parent widget
     Widget(ref<Widget> parent);
@@ -145,6 +147,9 @@ public:
     // Walk up the hierarchy and return the parent window
     ref<Window> window();
 
+    // Walk up the hierarchy and return the screen
+    ref<Screen> screen();
+
     /// Associate this widget with an ID value (optional)
     void setId(const std::string &id) { mId = id; }
     /// Return the ID value associated with this widget, if any
@@ -218,6 +223,19 @@ public:
     /// Invoke the associated layout generator to properly place child widgets, if any
     virtual void performLayout(NVGcontext *ctx);
 
+    /**
+     * \brief Return the size of the widget under the given constraints
+     *
+     * This is the preferred size (see \ref preferredSize(), where the
+     * associated layout receives \c constraints) clamped to the constraints,
+     * with the fixed size taking precedence on each axis where it is set.
+     * The result is cached for the duration of the current \ref LayoutPass.
+     */
+    Vector2i measure(NVGcontext *ctx, const LayoutConstraints &constraints = LayoutConstraints());
+
+    /// Set the position and size of the widget and lay out its children
+    void arrange(NVGcontext *ctx, const Vector2i &pos, const Vector2i &size);
+
     /// Draw the widget (and all child widgets)
     virtual void draw(NVGcontext *ctx);
 	virtual void drawBounds(NVGcontext *ctx, NVGcolor const& c = nvgRGBA(255, 0, 0, 128));
@@ -230,6 +248,14 @@ public:
 	virtual ~Widget();
 
 protected:
+    /**
+     * \brief Return the constraints of the measurement in progress
+     *
+     * Valid while \ref measure() calls \ref preferredSize(), so that
+     * widgets such as \ref Label can adapt to the available space; the
+     * constraints are unbounded otherwise.
+     */
+    const LayoutConstraints &measureConstraints() const;
 
 protected:
     weakref<Widget> mParent;
@@ -244,6 +270,12 @@ protected:
     int mFontSize;
     Cursor mCursor;
 
+    /* Sizes measured during the current layout pass, and the constraints
+       of the measurement in progress (if any) */
+    std::vector<std::pair<LayoutConstraints, Vector2i>> mMeasureCache;
+    uint64_t mMeasurePass = 0;
+    const LayoutConstraints *mMeasuring = nullptr;
+
 	static std::atomic<int> idCounter;
 };
 
@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include <nanogui/screen.h>
+#include <nanogui/imagecache.h>
 #if defined(WIN32)
 #include <windows.h>
 #endif
@@ -129,20 +130,19 @@ std::array<char, 8> utf8(int c) {
 }
 
 int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data, uint32_t size) {
-    static std::map<std::string, int> iconCache;
-    auto it = iconCache.find(name);
-    if (it != iconCache.end())
-        return it->second;
-    int iconID = nvgCreateImageMem(ctx, 0, data, size);
+    /* Callers keep the returned ID around, so icons are pinned */
+    ImageCache *cache = ImageCache::get(ctx);
+    int iconID = cache->imageFromMemory(name, data, size);
     if (iconID == 0)
         throw std::runtime_error("Unable to load resource data.");
-    iconCache[name] = iconID;
+    cache->setPinned(name, true);
     return iconID;
 }
 
 std::vector<std::pair<int, std::string>>
 loadImageDirectory(NVGcontext *ctx, const std::string &path) {
     std::vector<std::pair<int, std::string> > result;
+    ImageCache *cache = ImageCache::get(ctx);
 #if !defined(WIN32)
     DIR *dp = opendir(path.c_str());
     if (!dp)
@@ -162,9 +162,10 @@ loadImageDirectory(NVGcontext *ctx, const std::string &path) {
         if (strstr(fname, "png") == nullptr)
             continue;
         std::string fullName = path + "/" + std::string(fname);
-        int img = nvgCreateImage(ctx, fullName.c_str(), 0);
+        int img = cache->imageFromFile(fullName);
         if (img == 0)
             throw std::runtime_error("Could not open image data!");
+        cache->setPinned(fullName, true);
         result.push_back(
             std::make_pair(img, fullName.substr(0, fullName.length() - 4)));
 #if !defined(WIN32)
@@ -0,0 +1,386 @@
+/*
+    src/glbufferarena.cpp -- Sub-allocation of many small meshes from
+    shared vertex and index buffers
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/glbufferarena.h>
+#include <algorithm>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Arenas holding vertex array objects, see GLBufferArena::releaseShader() */
+static std::set<GLBufferArena *> __nanogui_buffer_arenas;
+
+static size_t componentSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return 2;
+        case GL_DOUBLE: return 8;
+        default: return 4;
+    }
+}
+
+void GLBufferArena::RangeAllocator::reset(uint32_t capacity_, uint32_t used_) {
+    capacity = capacity_;
+    used = used_;
+    freeByOffset.clear();
+    freeBySize.clear();
+    if (used < capacity)
+        insertFree(used, capacity - used);
+}
+
+void GLBufferArena::RangeAllocator::insertFree(uint32_t offset, uint32_t size) {
+    freeByOffset[offset] = size;
+    freeBySize.insert(std::make_pair(size, offset));
+}
+
+void GLBufferArena::RangeAllocator::eraseFree(std::map<uint32_t, uint32_t>::iterator it) {
+    auto range = freeBySize.equal_range(it->second);
+    for (auto it2 = range.first; it2 != range.second; ++it2) {
+        if (it2->second == it->first) {
+            freeBySize.erase(it2);
+            break;
+        }
+    }
+    freeByOffset.erase(it);
+}
+
+bool GLBufferArena::RangeAllocator::allocate(uint32_t size, uint32_t &offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+    /* Smallest free range that fits */
+    auto it = freeBySize.lower_bound(size);
+    if (it == freeBySize.end())
+        return false;
+    uint32_t blockOffset = it->second, blockSize = it->first;
+    eraseFree(freeByOffset.find(blockOffset));
+    if (blockSize > size)
+        insertFree(blockOffset + size, blockSize - size);
+    offset = blockOffset;
+    used += size;
+    return true;
+}
+
+void GLBufferArena::RangeAllocator::release(uint32_t offset, uint32_t size) {
+    if (size == 0)
+        return;
+    used -= size;
+
+    /* Merge with the free neighbors on both sides */
+    auto next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.end() && next->first == offset + size) {
+        size += next->second;
+        eraseFree(next);
+    }
+    auto prev = freeByOffset.lower_bound(offset);
+    if (prev != freeByOffset.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            eraseFree(prev);
+        }
+    }
+    insertFree(offset, size);
+}
+
+void GLBufferArena::RangeAllocator::grow(uint32_t newCapacity) {
+    uint32_t oldCapacity = capacity;
+    capacity = newCapacity;
+    used += newCapacity - oldCapacity;
+    release(oldCapacity, newCapacity - oldCapacity);
+}
+
+uint32_t GLBufferArena::RangeAllocator::largestFree() const {
+    return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+void GLBufferArena::init(const std::vector<Attribute> &layout, uint32_t vertexCapacity,
+                         uint32_t indexCapacity) {
+    if (ready())
+        free();
+    if (layout.empty())
+        throw std::runtime_error("GLBufferArena::init(): the vertex layout is empty!");
+
+    mLayout = layout;
+    mOffsets.clear();
+    mStride = 0;
+    for (auto const &attr : mLayout) {
+        mOffsets.push_back(mStride);
+        mStride += (uint32_t) (attr.dim * componentSize(attr.type));
+    }
+    /* Keep every vertex 4-byte aligned */
+    mStride = (mStride + 3) & ~3u;
+
+    vertexCapacity = std::max(vertexCapacity, 1u);
+    indexCapacity = std::max(indexCapacity, 1u);
+
+    glGenBuffers(1, &mVertexBuffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mVertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t) vertexCapacity * mStride, nullptr, GL_STATIC_DRAW);
+    glGenBuffers(1, &mIndexBuffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t) indexCapacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+    mVertices.reset(vertexCapacity);
+    mIndices.reset(indexCapacity);
+}
+
+GLBufferArena::~GLBufferArena() {
+    __nanogui_buffer_arenas.erase(this);
+}
+
+void GLBufferArena::free() {
+    resetVertexArrays();
+    if (mVertexBuffer) {
+        GLState::forget(mVertexBuffer);
+        glDeleteBuffers(1, &mVertexBuffer);
+    }
+    if (mIndexBuffer) {
+        GLState::forget(mIndexBuffer);
+        glDeleteBuffers(1, &mIndexBuffer);
+    }
+    mVertexBuffer = mIndexBuffer = 0;
+    mMeshes.clear();
+    mFreeHandles.clear();
+    mVertices.reset(0);
+    mIndices.reset(0);
+}
+
+void GLBufferArena::resetVertexArrays() {
+    for (auto const &item : mVertexArrays) {
+        GLState::forget(item.second.first);
+        glDeleteVertexArrays(1, &item.second.first);
+    }
+    mVertexArrays.clear();
+    __nanogui_buffer_arenas.erase(this);
+}
+
+void GLBufferArena::releaseShader(const GLShader *shader) {
+    for (GLBufferArena *arena : __nanogui_buffer_arenas) {
+        auto it = arena->mVertexArrays.find(shader);
+        if (it == arena->mVertexArrays.end())
+            continue;
+        GLState::forget(it->second.first);
+        glDeleteVertexArrays(1, &it->second.first);
+        arena->mVertexArrays.erase(it);
+    }
+}
+
+void GLBufferArena::growBuffer(GLuint &buffer, size_t oldSize, size_t newSize) {
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+    GLState::forget(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+    resetVertexArrays();
+}
+
+GLBufferArena::Mesh &GLBufferArena::mesh(int handle) {
+    if (handle < 0 || handle >= (int) mMeshes.size() || !mMeshes[handle].live)
+        throw std::runtime_error("GLBufferArena: invalid mesh handle!");
+    return mMeshes[handle];
+}
+
+int GLBufferArena::allocate(uint32_t vertexCount, uint32_t indexCount) {
+    if (!ready())
+        throw std::runtime_error("GLBufferArena::allocate(): the arena is not initialized!");
+
+    Mesh m;
+    m.vertexCount = vertexCount;
+    m.indexCount = indexCount;
+    m.live = true;
+
+    /* Double the capacity until the request fits */
+    while (!mVertices.allocate(vertexCount, m.vertexOffset)) {
+        uint32_t capacity = std::max(mVertices.capacity * 2, mVertices.capacity + vertexCount);
+        growBuffer(mVertexBuffer, (size_t) mVertices.capacity * mStride, (size_t) capacity * mStride);
+        mVertices.grow(capacity);
+    }
+    while (!mIndices.allocate(indexCount, m.indexOffset)) {
+        uint32_t capacity = std::max(mIndices.capacity * 2, mIndices.capacity + indexCount);
+        growBuffer(mIndexBuffer, (size_t) mIndices.capacity * sizeof(uint32_t),
+                   (size_t) capacity * sizeof(uint32_t));
+        mIndices.grow(capacity);
+    }
+
+    int handle;
+    if (!mFreeHandles.empty()) {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+        mMeshes[handle] = m;
+    } else {
+        handle = (int) mMeshes.size();
+        mMeshes.push_back(m);
+    }
+    return handle;
+}
+
+void GLBufferArena::upload(int handle, const void *vertices, const uint32_t *indices) {
+    const Mesh &m = mesh(handle);
+
+    /* GL_COPY_WRITE_BUFFER leaves the element array binding of the bound VAO alone */
+    if (vertices && m.vertexCount > 0) {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mVertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) m.vertexOffset * mStride,
+                        (size_t) m.vertexCount * mStride, vertices);
+    }
+    if (indices && m.indexCount > 0) {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t) m.indexOffset * sizeof(uint32_t),
+                        (size_t) m.indexCount * sizeof(uint32_t), indices);
+    }
+}
+
+void GLBufferArena::release(int handle) {
+    Mesh &m = mesh(handle);
+    mVertices.release(m.vertexOffset, m.vertexCount);
+    mIndices.release(m.indexOffset, m.indexCount);
+    m.live = false;
+    mFreeHandles.push_back(handle);
+}
+
+void GLBufferArena::compact() {
+    if (!ready())
+        return;
+
+    /* Copy the live ranges into fresh buffers in their current order */
+    GLuint buffers[2];
+    glGenBuffers(2, buffers);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t) mVertices.capacity * mStride, nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, mVertexBuffer);
+
+    std::vector<int> order;
+    for (size_t i = 0; i < mMeshes.size(); ++i)
+        if (mMeshes[i].live)
+            order.push_back((int) i);
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return mMeshes[a].vertexOffset < mMeshes[b].vertexOffset;
+    });
+    uint32_t vertexEnd = 0;
+    for (int i : order) {
+        Mesh &m = mMeshes[i];
+        if (m.vertexCount > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                (size_t) m.vertexOffset * mStride, (size_t) vertexEnd * mStride,
+                                (size_t) m.vertexCount * mStride);
+        m.vertexOffset = vertexEnd;
+        vertexEnd += m.vertexCount;
+    }
+
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t) mIndices.capacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, mIndexBuffer);
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return mMeshes[a].indexOffset < mMeshes[b].indexOffset;
+    });
+    uint32_t indexEnd = 0;
+    for (int i : order) {
+        Mesh &m = mMeshes[i];
+        if (m.indexCount > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                (size_t) m.indexOffset * sizeof(uint32_t),
+                                (size_t) indexEnd * sizeof(uint32_t),
+                                (size_t) m.indexCount * sizeof(uint32_t));
+        m.indexOffset = indexEnd;
+        indexEnd += m.indexCount;
+    }
+
+    GLState::forget(mVertexBuffer);
+    GLState::forget(mIndexBuffer);
+    glDeleteBuffers(1, &mVertexBuffer);
+    glDeleteBuffers(1, &mIndexBuffer);
+    mVertexBuffer = buffers[0];
+    mIndexBuffer = buffers[1];
+    resetVertexArrays();
+
+    mVertices.reset(mVertices.capacity, vertexEnd);
+    mIndices.reset(mIndices.capacity, indexEnd);
+}
+
+void GLBufferArena::bind(GLShader &shader) {
+    shader.bind();
+
+    /* Program names are recycled, so the vertex array object belongs to the
+       shader object; it is set up again if the shader has been relinked */
+    auto it = mVertexArrays.find(&shader);
+    if (it != mVertexArrays.end()) {
+        if (it->second.second == shader.program()) {
+            GLState::bindVertexArray(it->second.first);
+            return;
+        }
+        GLState::forget(it->second.first);
+        glDeleteVertexArrays(1, &it->second.first);
+        mVertexArrays.erase(it);
+    }
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    __nanogui_buffer_arenas.insert(this);
+    GLState::bindVertexArray(vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    for (size_t i = 0; i < mLayout.size(); ++i) {
+        const Attribute &attr = mLayout[i];
+        GLint id = shader.attrib(attr.name, false);
+        if (id < 0)
+            continue;
+        glEnableVertexAttribArray(id);
+        glVertexAttribPointer(id, attr.dim, attr.type, attr.normalized, mStride,
+                              (const void *) mOffsets[i]);
+    }
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    mVertexArrays[&shader] = std::make_pair(vao, shader.program());
+}
+
+void GLBufferArena::draw(int handle, GLenum type) {
+    const Mesh &m = mesh(handle);
+    if (m.indexCount == 0)
+        return;
+    glDrawElementsBaseVertex(type, (GLsizei) m.indexCount, GL_UNSIGNED_INT,
+                             (const void *) ((size_t) m.indexOffset * sizeof(uint32_t)),
+                             (GLint) m.vertexOffset);
+}
+
+void GLBufferArena::drawBatch(const std::vector<int> &meshes, GLenum type) {
+    mBatchCounts.clear();
+    mBatchIndices.clear();
+    mBatchBaseVertices.clear();
+    for (int handle : meshes) {
+        const Mesh &m = mesh(handle);
+        if (m.indexCount == 0)
+            continue;
+        mBatchCounts.push_back((GLsizei) m.indexCount);
+        mBatchIndices.push_back((const void *) ((size_t) m.indexOffset * sizeof(uint32_t)));
+        mBatchBaseVertices.push_back((GLint) m.vertexOffset);
+    }
+    if (mBatchCounts.empty())
+        return;
+    glMultiDrawElementsBaseVertex(type, mBatchCounts.data(), GL_UNSIGNED_INT,
+                                  mBatchIndices.data(), (GLsizei) mBatchCounts.size(),
+                                  mBatchBaseVertices.data());
+}
+
+float GLBufferArena::fragmentation() const {
+    uint32_t available = mVertices.capacity - mVertices.used;
+    if (available == 0)
+        return 0.f;
+    return 1.f - mVertices.largestFree() / (float) available;
+}
+
+NAMESPACE_END(nanogui)
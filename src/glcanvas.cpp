@@ -0,0 +1,84 @@
+/*
+    src/glcanvas.cpp -- Widget that embeds custom OpenGL rendering
+    into the widget hierarchy
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/glcanvas.h>
+#include <nanogui/screen.h>
+#include <nanogui/theme.h>
+#include <nanogui/opengl.h>
+#include <cmath>
+
+NAMESPACE_BEGIN(nanogui)
+
+GLCanvas::GLCanvas(ref<Widget> parent)
+    : Widget(parent), mBackgroundColor(Color(0, 255)), mSamples(1),
+      mDepthBuffer(true), mDrawBorder(true), mDirty(true) { }
+
+void GLCanvas::drawGL() {
+    if (mDrawCallback)
+        mDrawCallback();
+}
+
+int GLCanvas::renderContents(NVGcontext *ctx) {
+    float ratio = screen()->pixelRatio();
+    Vector2i size((int) std::ceil(mSize.x * ratio), (int) std::ceil(mSize.y * ratio));
+
+    if (mOffscreen.prepare(ctx, size, NVG_IMAGE_PREMULTIPLIED | NVG_IMAGE_FLIPY,
+                           mSamples, mDepthBuffer))
+        mDirty = true;
+    if (!mDirty)
+        return mOffscreen.image();
+
+    mOffscreen.begin();
+
+    float alpha = mBackgroundColor[3];
+    glClearColor(mBackgroundColor[0] * alpha, mBackgroundColor[1] * alpha,
+                 mBackgroundColor[2] * alpha, alpha);
+    glClear(GL_COLOR_BUFFER_BIT |
+            (mDepthBuffer ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT : 0));
+
+    {
+        /* The user code may change any state directly */
+        GLState::Scope untracked(false);
+        drawGL();
+    }
+
+    mOffscreen.end();
+
+    mDirty = false;
+    return mOffscreen.image();
+}
+
+Vector2i GLCanvas::preferredSize(NVGcontext *) {
+    return Vector2i(250, 250);
+}
+
+void GLCanvas::draw(NVGcontext *ctx) {
+    if (mSize.x > 0 && mSize.y > 0) {
+        renderContents(ctx);
+        NVGpaint paint = mOffscreen.paint(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+        nvgBeginPath(ctx);
+        nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+        nvgFillPaint(ctx, paint);
+        nvgFill(ctx);
+    }
+
+    if (mDrawBorder) {
+        nvgBeginPath(ctx);
+        nvgRect(ctx, mPos.x + 0.5f, mPos.y + 0.5f, mSize.x - 1.f, mSize.y - 1.f);
+        nvgStrokeColor(ctx, mTheme->mBorderDark);
+        nvgStroke(ctx);
+    }
+
+    Widget::draw(ctx);
+}
+
+NAMESPACE_END(nanogui)
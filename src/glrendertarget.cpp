@@ -0,0 +1,378 @@
+/*
+    src/glrendertarget.cpp -- Offscreen render targets that are reused
+    across frames and resize without reallocating every time
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/glrendertarget.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#define NANOVG_GL3 1
+#include <nanovg_gl.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+static std::map<NVGcontext *, GLRenderTargetPool *> __nanogui_render_target_pools;
+
+void GLRenderTarget::init(const Vector2i &capacity, GLenum format, int samples, bool depth) {
+    free();
+    mCapacity = mSize = glm::max(capacity, Vector2i(1));
+    mFormat = format;
+    mSamples = std::max(samples, 1);
+    mHasDepth = depth;
+
+    GLuint previous = GLState::drawFramebuffer();
+
+    /* The texture format and type only matter for uploads, which never happen */
+    mTexture.init(mCapacity, format, GL_RGBA, GL_UNSIGNED_BYTE);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+
+    if (mSamples > 1) {
+        glGenRenderbuffers(1, &mColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, mColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, format,
+                                         mCapacity.x, mCapacity.y);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
+    } else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               mTexture.id(), 0);
+    }
+
+    if (depth) {
+        glGenRenderbuffers(1, &mDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
+        if (mSamples > 1)
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, mSamples, GL_DEPTH24_STENCIL8,
+                                             mCapacity.x, mCapacity.y);
+        else
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, mCapacity.x, mCapacity.y);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                                  GL_RENDERBUFFER, mDepth);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    if (status == GL_FRAMEBUFFER_COMPLETE && mSamples > 1) {
+        glGenFramebuffers(1, &mResolveFramebuffer);
+        GLState::bindFramebuffer(GL_FRAMEBUFFER, mResolveFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               mTexture.id(), 0);
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, previous);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        free();
+        throw std::runtime_error("GLRenderTarget::init(): could not create framebuffer object!");
+    }
+}
+
+void GLRenderTarget::free() {
+    GLuint framebuffers[2] = { mFramebuffer, mResolveFramebuffer };
+    GLuint renderbuffers[2] = { mColor, mDepth };
+    GLState::forget(mFramebuffer);
+    GLState::forget(mResolveFramebuffer);
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteRenderbuffers(2, renderbuffers);
+    mTexture.free();
+    mFramebuffer = mResolveFramebuffer = mColor = mDepth = 0;
+    mSize = mCapacity = Vector2i(0);
+}
+
+void GLRenderTarget::bind() {
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    GLState::viewport(0, 0, mSize.x, mSize.y);
+    if (mSamples > 1)
+        GLState::enable(GL_MULTISAMPLE);
+}
+
+void GLRenderTarget::release() {
+    if (mSamples > 1)
+        GLState::disable(GL_MULTISAMPLE);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GLRenderTarget::resolve() {
+    if (mSamples <= 1)
+        return;
+
+    GLuint previous = GLState::drawFramebuffer();
+    GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, mResolveFramebuffer);
+    glBlitFramebuffer(0, 0, mSize.x, mSize.y, 0, 0, mSize.x, mSize.y,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void GLRenderTarget::setSize(const Vector2i &size) {
+    if (size.x > mCapacity.x || size.y > mCapacity.y)
+        throw std::runtime_error("GLRenderTarget::setSize(): size exceeds the capacity!");
+    mSize = glm::max(size, Vector2i(1));
+}
+
+size_t GLRenderTarget::bytes() const {
+    size_t pixels = (size_t) mCapacity.x * (size_t) mCapacity.y;
+    size_t perPixel = formatSize(mFormat);
+    if (mSamples > 1)
+        perPixel += formatSize(mFormat) * mSamples;
+    if (mHasDepth)
+        perPixel += 4 * mSamples;
+    return pixels * perPixel;
+}
+
+size_t GLRenderTarget::formatSize(GLenum format) {
+    switch (format) {
+        case GL_R8: return 1;
+        case GL_RG8:
+        case GL_R16F: return 2;
+        case GL_RGBA16F: return 8;
+        case GL_RGBA32F: return 16;
+        case GL_RG16F:
+        case GL_R32F:
+        default: return 4;
+    }
+}
+
+GLRenderTargetPool *GLRenderTargetPool::get(NVGcontext *ctx, bool create) {
+    auto it = __nanogui_render_target_pools.find(ctx);
+    if (it != __nanogui_render_target_pools.end())
+        return it->second;
+    if (!create)
+        return nullptr;
+    GLRenderTargetPool *pool = new GLRenderTargetPool();
+    __nanogui_render_target_pools[ctx] = pool;
+    return pool;
+}
+
+void GLRenderTargetPool::release(NVGcontext *ctx) {
+    auto it = __nanogui_render_target_pools.find(ctx);
+    if (it == __nanogui_render_target_pools.end())
+        return;
+    delete it->second;
+    __nanogui_render_target_pools.erase(it);
+}
+
+int GLRenderTargetPool::sizeClass(int value) {
+    /* 64, 96, 144, 224, 336, ...: rounded to multiples of 16 */
+    int size = 64;
+    while (size < value)
+        size = (size * 3 / 2 + 15) & ~15;
+    return size;
+}
+
+GLRenderTarget *GLRenderTargetPool::acquire(const Vector2i &size, GLenum format,
+                                            int samples, bool depth) {
+    Vector2i capacity(sizeClass(size.x), sizeClass(size.y));
+    samples = std::max(samples, 1);
+
+    for (Entry &e : mEntries) {
+        GLRenderTarget *t = e.target.get();
+        if (e.inUse || t->capacity() != capacity || t->format() != format ||
+            t->samples() != samples || t->hasDepth() != depth)
+            continue;
+        e.inUse = true;
+        e.lastUsed = mFrame;
+        t->setSize(size);
+        mReuses++;
+        return t;
+    }
+
+    Entry e;
+    e.target.reset(new GLRenderTarget());
+    e.target->init(capacity, format, samples, depth);
+    e.target->setSize(size);
+    e.inUse = true;
+    e.lastUsed = mFrame;
+    mEntries.push_back(std::move(e));
+    mAllocations++;
+    return mEntries.back().target.get();
+}
+
+GLRenderTarget *GLRenderTargetPool::resize(GLRenderTarget *target, const Vector2i &size) {
+    const Vector2i &capacity = target->capacity();
+    bool keep = true;
+    for (int i = 0; i < 2; ++i) {
+        int c = sizeClass(size[i]);
+        /* Fits, and the storage is at most one class larger than needed */
+        keep &= c <= capacity[i] && capacity[i] <= sizeClass(c + 1);
+    }
+
+    if (keep) {
+        if (size != target->size())
+            mResizesInPlace++;
+        target->setSize(size);
+        return target;
+    }
+
+    GLenum format = target->format();
+    int samples = target->samples();
+    bool depth = target->hasDepth();
+    release(target);
+    return acquire(size, format, samples, depth);
+}
+
+GLRenderTargetPool::Entry &GLRenderTargetPool::entry(GLRenderTarget *target) {
+    for (Entry &e : mEntries)
+        if (e.target.get() == target && e.inUse)
+            return e;
+    throw std::runtime_error("GLRenderTargetPool: unknown render target!");
+}
+
+void GLRenderTargetPool::release(GLRenderTarget *target) {
+    Entry &e = entry(target);
+    e.inUse = false;
+    e.lastUsed = mFrame;
+}
+
+void GLRenderTargetPool::beginFrame() {
+    mFrame++;
+    for (size_t i = 0; i < mEntries.size(); ) {
+        Entry &e = mEntries[i];
+        if (!e.inUse && mFrame - e.lastUsed > (uint64_t) mMaxIdleFrames) {
+            e.target->free();
+            mEntries.erase(mEntries.begin() + i);
+            mEvictions++;
+        } else {
+            ++i;
+        }
+    }
+}
+
+GLRenderTargetPool::Statistics GLRenderTargetPool::statistics() const {
+    Statistics stats;
+    for (const Entry &e : mEntries) {
+        if (e.inUse)
+            stats.inUse++;
+        else
+            stats.idle++;
+        stats.bytes += e.target->bytes();
+    }
+    stats.allocations = mAllocations;
+    stats.reuses = mReuses;
+    stats.resizesInPlace = mResizesInPlace;
+    stats.evictions = mEvictions;
+    return stats;
+}
+
+void GLRenderTargetPool::free() {
+    for (Entry &e : mEntries)
+        e.target->free();
+    mEntries.clear();
+}
+
+bool GLOffscreenTarget::prepare(NVGcontext *ctx, const Vector2i &_size, int imageFlags,
+                                int samples, bool depth) {
+    Vector2i size = glm::max(_size, Vector2i(1));
+    samples = std::max(samples, 1);
+    if (mContext != ctx || mImageFlags != imageFlags)
+        release();
+    mContext = ctx;
+    mImageFlags = imageFlags;
+    GLRenderTargetPool *pool = GLRenderTargetPool::get(ctx);
+
+    if (mTarget && (mTarget->samples() != samples || mTarget->hasDepth() != depth)) {
+        pool->release(mTarget);
+        mTarget = nullptr;
+    }
+
+    bool changed = false;
+    if (!mTarget) {
+        mTarget = pool->acquire(size, GL_RGBA8, samples, depth);
+        changed = true;
+    } else if (mTarget->size() != size) {
+        mTarget = pool->resize(mTarget, size);
+        changed = true;
+    }
+
+    GLuint texture = mTarget->texture().id();
+    if (mTexture != texture) {
+        if (mImage)
+            nvgDeleteImage(ctx, mImage);
+        const Vector2i &capacity = mTarget->capacity();
+        mImage = nvglCreateImageFromHandleGL3(ctx, texture, capacity.x, capacity.y,
+                                              imageFlags | NVG_IMAGE_NODELETE);
+        mTexture = texture;
+        changed = true;
+    }
+    return changed;
+}
+
+bool GLOffscreenTarget::prepare(NVGcontext *ctx, const Vector2i &logicalSize, float pixelRatio,
+                                int imageFlags, int samples, bool depth) {
+    Vector2i size((int) std::ceil(logicalSize.x * pixelRatio),
+                  (int) std::ceil(logicalSize.y * pixelRatio));
+    return prepare(ctx, size, imageFlags, samples, depth);
+}
+
+void GLOffscreenTarget::begin() {
+    GLState::getViewport(mViewport);
+    mFramebuffer = GLState::drawFramebuffer();
+
+    mTarget->bind();
+    GLState::disable(GL_BLEND);
+    GLState::disable(GL_DEPTH_TEST);
+    GLState::disable(GL_SCISSOR_TEST);
+    GLState::disable(GL_CULL_FACE);
+}
+
+void GLOffscreenTarget::end() {
+    mTarget->resolve();
+    if (mTarget->samples() > 1)
+        GLState::disable(GL_MULTISAMPLE);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    GLState::viewport(mViewport[0], mViewport[1], mViewport[2], mViewport[3]);
+}
+
+NVGpaint GLOffscreenTarget::paint(NVGcontext *ctx, float x, float y, float w, float h,
+                                  float alpha) const {
+    /* Only part of the texture is rendered to. It is at the top left of the
+       pattern, or at the bottom left if the image is flipped vertically. */
+    Vector2f uv = mTarget->uvScale();
+    float width = w / uv.x, height = h / uv.y;
+    if (mImageFlags & NVG_IMAGE_FLIPY)
+        y += h - height;
+    return nvgImagePattern(ctx, x, y, width, height, 0, mImage, alpha);
+}
+
+void GLOffscreenTarget::release() {
+    GLRenderTargetPool *pool = mContext ? GLRenderTargetPool::get(mContext, false) : nullptr;
+    if (pool) {
+        if (mImage)
+            nvgDeleteImage(mContext, mImage);
+        if (mTarget)
+            pool->release(mTarget);
+    }
+    mTarget = nullptr;
+    mImage = 0;
+    mTexture = 0;
+}
+
+bool GLOffscreenTarget::releaseIfAlive(NVGcontext *ctx) {
+    if (!contextAlive(ctx ? ctx : mContext))
+        return false;
+    release();
+    return true;
+}
+
+const char *GLOffscreenTarget::fullscreenVertexShader() {
+    return "#version 330\n"
+           "out vec2 uv;\n"
+           "void main() {\n"
+           "    uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+           "    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+           "}";
+}
+
+NAMESPACE_END(nanogui)
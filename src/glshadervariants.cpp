@@ -0,0 +1,139 @@
+/*
+    src/glshadervariants.cpp -- Cache of shader permutations that are
+    selected by a bit mask of features
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/glshadervariants.h>
+#include <cstdio>
+
+NAMESPACE_BEGIN(nanogui)
+
+void GLShaderVariants::init(const std::string &name, const std::string &vertex_str,
+                            const std::string &fragment_str,
+                            const std::string &geometry_str) {
+    if (!mVariants.empty())
+        throw std::runtime_error("GLShaderVariants::init(" + name + "): already initialized!");
+    mName = name;
+    mVertexShader = vertex_str;
+    mFragmentShader = fragment_str;
+    mGeometryShader = geometry_str;
+}
+
+void GLShaderVariants::addFeature(uint32_t mask, const std::string &key, const std::string &value) {
+    if (!mVariants.empty())
+        throw std::runtime_error("GLShaderVariants::addFeature(" + mName + ", " + key +
+                                 "): features must be declared before the first variant is created!");
+    mFeatures.push_back(std::make_pair(mask, std::make_pair(key, value)));
+}
+
+GLShaderVariants::Variant &GLShaderVariants::create(uint32_t features) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "[%x]", features);
+
+    Variant &variant = mVariants[features];
+    variant.shader.reset(new GLShader());
+    GLShader &shader = *variant.shader;
+
+    for (auto const &def : mDefinitions)
+        shader.define(def.first, def.second);
+    for (auto const &feature : mFeatures)
+        if ((features & feature.first) == feature.first)
+            shader.define(feature.second.first, feature.second.second);
+
+    /* The first variant keeps the vertex data of all variants */
+    if (!mOwner) {
+        shader.mKeepInactiveAttribs = true;
+        mOwner = &shader;
+        mOwnerFeatures = features;
+    }
+
+    if (!shader.beginInit(mName + suffix, mVertexShader, mFragmentShader, mGeometryShader))
+        throw std::runtime_error("GLShaderVariants(" + mName + "): shader sources are missing!");
+    variant.pending = true;
+    return variant;
+}
+
+GLShader &GLShaderVariants::variant(uint32_t features) {
+    auto it = mVariants.find(features);
+    Variant &variant = it != mVariants.end() ? it->second : create(features);
+    if (variant.pending) {
+        variant.pending = false;
+        variant.shader->finishInit();
+    }
+    return *variant.shader;
+}
+
+GLShader &GLShaderVariants::owner() {
+    return variant(mOwner ? mOwnerFeatures : 0);
+}
+
+void GLShaderVariants::share(Variant &variant) {
+    GLShader &shader = *variant.shader;
+    if (&shader == mOwner)
+        return;
+
+    for (auto const &buf : mOwner->mBufferObjects) {
+        const std::string &name = buf.first;
+        const GLShader::Buffer &buffer = buf.second;
+        Signature sig { buffer.id, buffer.glType, buffer.dim, buffer.divisor, buffer.integral };
+
+        auto it = variant.shared.find(name);
+        if (it != variant.shared.end() && it->second == sig)
+            continue;
+        variant.shared[name] = sig;
+
+        /* Attributes that this variant does not use need no setup */
+        if (name != "indices" && shader.attrib(name, false) < 0)
+            continue;
+        shader.shareAttrib(*mOwner, name);
+    }
+}
+
+GLShader &GLShaderVariants::bind(uint32_t features) {
+    GLShader &shader = variant(features);
+    GLShader &buffers = owner();
+
+    /* The variant's draw calls do not see the owner's pending updates */
+    if (&shader != &buffers)
+        buffers.flushAttribs();
+
+    shader.bind();
+    share(mVariants[features]);
+    return shader;
+}
+
+void GLShaderVariants::prewarm(const std::vector<uint32_t> &features) {
+    /* Also sets up the driver's compiler threads when available */
+    GLShader::parallelCompileSupported();
+
+    for (uint32_t f : features)
+        if (mVariants.find(f) == mVariants.end())
+            create(f);
+}
+
+bool GLShaderVariants::ready(uint32_t features) const {
+    auto it = mVariants.find(features);
+    if (it == mVariants.end())
+        return false;
+    return !it->second.pending || it->second.shader->initComplete();
+}
+
+void GLShaderVariants::free() {
+    /* The owner's buffers are released last, after everything referencing them */
+    for (auto &v : mVariants)
+        if (v.second.shader.get() != mOwner)
+            v.second.shader->free();
+    if (mOwner)
+        mOwner->free();
+    mVariants.clear();
+    mOwner = nullptr;
+}
+
+NAMESPACE_END(nanogui)
@@ -10,15 +10,23 @@
 */
 
 #include <nanogui/glutil.h>
+#include <nanogui/glrendertarget.h>
+#include <nanogui/glbufferarena.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
 
 namespace nanogui {
 
-static GLuint createShader_helper(GLint type, const std::string &name,
-                                  const std::string &defines,
-                                  std::string shader_string) {
+/* Insert the definitions into 'shader_string' and start compiling it */
+static GLuint createShader_helper(GLint type, const std::string &defines,
+                                  std::string &shader_string) {
     if (shader_string.empty())
         return (GLuint) 0;
 
@@ -43,6 +51,12 @@ static GLuint createShader_helper(GLint type, const std::string &name,
     glShaderSource(id, 1, &shader_string_const, nullptr);
     glCompileShader(id);
 
+    return id;
+}
+
+/* Wait for the compilation of a shader and report errors */
+static void checkShader_helper(GLuint id, GLint type, const std::string &name,
+                               const std::string &shader_string) {
     GLint status;
     glGetShaderiv(id, GL_COMPILE_STATUS, &status);
 
@@ -61,8 +75,279 @@ static GLuint createShader_helper(GLint type, const std::string &name,
         std::cerr << "Error: " << std::endl << buffer << std::endl;
         throw std::runtime_error("Shader compilation failed!");
     }
+}
 
-    return id;
+/* Shadowed OpenGL state of one context; 'unknown' marks values that must
+   be set unconditionally */
+static const GLuint unknown = 0xFFFFFFFFu;
+
+struct GLStateShadow {
+    GLuint program = unknown, vertexArray = unknown;
+    GLuint buffers[7] = { unknown, unknown, unknown, unknown, unknown, unknown, unknown };
+    GLuint readFramebuffer = unknown, drawFramebuffer = unknown;
+    GLint viewport[4] = { -1, -1, -1, -1 }, scissor[4] = { -1, -1, -1, -1 };
+    GLenum blendSrc = unknown, blendDst = unknown;
+    int8_t caps[6] = { -1, -1, -1, -1, -1, -1 };
+    bool tracking = false;
+    GLState::Statistics frame, lastFrame;
+};
+
+/* One shadow per OpenGL context, identified by the window that owns it */
+static std::map<GLFWwindow *, GLStateShadow> __nanogui_gl_states;
+static GLFWwindow *__nanogui_gl_state_window = nullptr;
+static GLStateShadow *__nanogui_gl_state = nullptr;
+static bool __nanogui_gl_state_counting = false;
+
+/* Return the shadow of the current context (the previous lookup is cached) */
+static GLStateShadow &currentState() {
+    GLFWwindow *window = glfwGetCurrentContext();
+    if (!__nanogui_gl_state || window != __nanogui_gl_state_window) {
+        __nanogui_gl_state = &__nanogui_gl_states[window];
+        __nanogui_gl_state_window = window;
+    }
+    return *__nanogui_gl_state;
+}
+
+static int bufferSlot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_COPY_READ_BUFFER: return 3;
+        case GL_COPY_WRITE_BUFFER: return 4;
+        case GL_PIXEL_PACK_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        default: return -1;
+    }
+}
+
+static int capSlot(GLenum cap) {
+    switch (cap) {
+        case GL_BLEND: return 0;
+        case GL_SCISSOR_TEST: return 1;
+        case GL_DEPTH_TEST: return 2;
+        case GL_CULL_FACE: return 3;
+        case GL_MULTISAMPLE: return 4;
+        case GL_PROGRAM_POINT_SIZE: return 5;
+        default: return -1;
+    }
+}
+
+/* Return true (and count the call) if a state change must be issued. Calls
+   are only skipped within a tracked scope. */
+static inline bool stateChanged(GLStateShadow &glState, bool changed) {
+    changed = changed || !glState.tracking;
+    if (__nanogui_gl_state_counting) {
+        if (changed)
+            glState.frame.calls++;
+        else
+            glState.frame.skipped++;
+    }
+    return changed;
+}
+
+void GLState::useProgram(GLuint program) {
+    GLStateShadow &glState = currentState();
+    if (!stateChanged(glState, glState.program != program))
+        return;
+    glUseProgram(program);
+    glState.program = program;
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    GLStateShadow &glState = currentState();
+    if (!stateChanged(glState, glState.vertexArray != vao))
+        return;
+    glBindVertexArray(vao);
+    glState.vertexArray = vao;
+    /* The index buffer binding is part of the vertex array object */
+    glState.buffers[1] = unknown;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    GLStateShadow &glState = currentState();
+    int slot = bufferSlot(target);
+    if (!stateChanged(glState, slot < 0 || glState.buffers[slot] != buffer))
+        return;
+    glBindBuffer(target, buffer);
+    if (slot >= 0)
+        glState.buffers[slot] = buffer;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    GLStateShadow &glState = currentState();
+    stateChanged(glState, true);
+    glBindBufferBase(target, index, buffer);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        glState.buffers[slot] = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                              GLintptr offset, GLsizeiptr size) {
+    GLStateShadow &glState = currentState();
+    stateChanged(glState, true);
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        glState.buffers[slot] = buffer;
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    GLStateShadow &glState = currentState();
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if (!stateChanged(glState, (read && glState.readFramebuffer != framebuffer) ||
+                               (draw && glState.drawFramebuffer != framebuffer)))
+        return;
+    glBindFramebuffer(target, framebuffer);
+    if (read)
+        glState.readFramebuffer = framebuffer;
+    if (draw)
+        glState.drawFramebuffer = framebuffer;
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    GLStateShadow &glState = currentState();
+    GLint *v = glState.viewport;
+    if (!stateChanged(glState, v[0] != x || v[1] != y || v[2] != width || v[3] != height))
+        return;
+    glViewport(x, y, width, height);
+    v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+}
+
+void GLState::scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    GLStateShadow &glState = currentState();
+    GLint *s = glState.scissor;
+    if (!stateChanged(glState, s[0] != x || s[1] != y || s[2] != width || s[3] != height))
+        return;
+    glScissor(x, y, width, height);
+    s[0] = x; s[1] = y; s[2] = width; s[3] = height;
+}
+
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+    GLStateShadow &glState = currentState();
+    if (!stateChanged(glState, glState.blendSrc != sfactor || glState.blendDst != dfactor))
+        return;
+    glBlendFunc(sfactor, dfactor);
+    glState.blendSrc = sfactor;
+    glState.blendDst = dfactor;
+}
+
+void GLState::setEnabled(GLenum cap, bool value) {
+    GLStateShadow &glState = currentState();
+    int slot = capSlot(cap);
+    if (!stateChanged(glState, slot < 0 || glState.caps[slot] != (int8_t) value))
+        return;
+    if (value)
+        glEnable(cap);
+    else
+        glDisable(cap);
+    if (slot >= 0)
+        glState.caps[slot] = (int8_t) value;
+}
+
+GLuint GLState::drawFramebuffer() {
+    GLStateShadow &glState = currentState();
+    if (!glState.tracking || glState.drawFramebuffer == unknown) {
+        GLint framebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        glState.drawFramebuffer = (GLuint) framebuffer;
+    }
+    return glState.drawFramebuffer;
+}
+
+void GLState::getViewport(GLint viewport[4]) {
+    GLStateShadow &glState = currentState();
+    if (!glState.tracking || glState.viewport[2] < 0)
+        glGetIntegerv(GL_VIEWPORT, glState.viewport);
+    memcpy(viewport, glState.viewport, sizeof(GLint) * 4);
+}
+
+void GLState::invalidate() {
+    GLStateShadow &glState = currentState();
+    glState.program = glState.vertexArray = unknown;
+    for (GLuint &buffer : glState.buffers)
+        buffer = unknown;
+    glState.readFramebuffer = glState.drawFramebuffer = unknown;
+    for (int i = 0; i < 4; ++i)
+        glState.viewport[i] = glState.scissor[i] = -1;
+    glState.blendSrc = glState.blendDst = unknown;
+    for (int8_t &cap : glState.caps)
+        cap = -1;
+}
+
+void GLState::forget(GLuint object) {
+    GLStateShadow &glState = currentState();
+    if (glState.program == object)
+        glState.program = unknown;
+    if (glState.vertexArray == object) {
+        glState.vertexArray = unknown;
+        glState.buffers[1] = unknown;
+    }
+    for (GLuint &buffer : glState.buffers)
+        if (buffer == object)
+            buffer = unknown;
+    if (glState.readFramebuffer == object)
+        glState.readFramebuffer = unknown;
+    if (glState.drawFramebuffer == object)
+        glState.drawFramebuffer = unknown;
+}
+
+void GLState::release(GLFWwindow *window) {
+    __nanogui_gl_states.erase(window);
+    if (window == __nanogui_gl_state_window)
+        __nanogui_gl_state = nullptr;
+}
+
+bool GLState::tracking() {
+    return currentState().tracking;
+}
+
+GLState::Scope::Scope(bool tracking) {
+    GLStateShadow &glState = currentState();
+    mPrevious = glState.tracking;
+    if (tracking && !mPrevious)
+        invalidate();
+    glState.tracking = tracking;
+}
+
+GLState::Scope::~Scope() {
+    GLStateShadow &glState = currentState();
+    /* The state may have been changed directly in the meantime */
+    if (mPrevious && !glState.tracking)
+        invalidate();
+    glState.tracking = mPrevious;
+}
+
+void GLState::setCounting(bool counting) {
+    __nanogui_gl_state_counting = counting;
+    for (auto &kv : __nanogui_gl_states)
+        kv.second.frame = kv.second.lastFrame = Statistics();
+}
+
+bool GLState::counting() {
+    return __nanogui_gl_state_counting;
+}
+
+void GLState::beginFrame() {
+    GLStateShadow &glState = currentState();
+    glState.lastFrame = glState.frame;
+    glState.frame = Statistics();
+    invalidate();
+}
+
+GLState::Statistics GLState::currentFrame() {
+    return currentState().frame;
+}
+
+GLState::Statistics GLState::lastFrame() {
+    return currentState().lastFrame;
+}
+
+static double currentTime() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 bool GLShader::initFromFiles(
@@ -84,27 +369,235 @@ bool GLShader::initFromFiles(
                 file_to_string(geometry_fname));
 }
 
+/* Entry points and constants of GL_ARB_get_program_binary (core in OpenGL 4.1),
+   which are not part of the OpenGL 3.3 loader */
+#define NANOGUI_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define NANOGUI_PROGRAM_BINARY_LENGTH 0x8741
+#define NANOGUI_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGETPROGRAMBINARY)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+typedef void (APIENTRYP PFNPROGRAMBINARY)(GLuint, GLenum, const void *, GLsizei);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERI)(GLuint, GLenum, GLint);
+static PFNGETPROGRAMBINARY getProgramBinary = nullptr;
+static PFNPROGRAMBINARY programBinary = nullptr;
+static PFNPROGRAMPARAMETERI programParameteri = nullptr;
+
+static std::string binaryCacheDir;
+static GLShader::BinaryCacheStats binaryCacheStatistics;
+
+static bool hasProgramBinary() {
+    static int supported = -1;
+    if (supported < 0) {
+        GLint major = 0, minor = 0, formats = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        supported = 0;
+        if (major > 4 || (major == 4 && minor >= 1) ||
+            glfwExtensionSupported("GL_ARB_get_program_binary")) {
+            getProgramBinary = (PFNGETPROGRAMBINARY) glfwGetProcAddress("glGetProgramBinary");
+            programBinary = (PFNPROGRAMBINARY) glfwGetProcAddress("glProgramBinary");
+            programParameteri = (PFNPROGRAMPARAMETERI) glfwGetProcAddress("glProgramParameteri");
+            glGetIntegerv(NANOGUI_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = getProgramBinary && programBinary && programParameteri && formats > 0;
+        }
+    }
+    return supported == 1;
+}
+
+/* 64-bit FNV-1a hash; strings are length-prefixed so that their boundaries matter */
+static void hashString(uint64_t &hash, const std::string &str) {
+    uint64_t length = str.length();
+    for (int i = 0; i < 8; ++i)
+        hash = (hash ^ ((length >> (8 * i)) & 0xFF)) * 0x100000001b3ull;
+    for (unsigned char c : str)
+        hash = (hash ^ c) * 0x100000001b3ull;
+}
+
+void GLShader::setBinaryCacheDirectory(const std::string &directory) {
+    binaryCacheDir = directory;
+}
+
+const std::string &GLShader::binaryCacheDirectory() {
+    return binaryCacheDir;
+}
+
+const GLShader::BinaryCacheStats &GLShader::binaryCacheStats() {
+    return binaryCacheStatistics;
+}
+
+std::string GLShader::binaryCachePath(const std::string &vertex_str,
+                                      const std::string &fragment_str,
+                                      const std::string &geometry_str,
+                                      const std::string &defines) const {
+    if (binaryCacheDir.empty() || !hasProgramBinary())
+        return "";
+
+    auto glString = [](GLenum name) -> std::string {
+        const GLubyte *str = glGetString(name);
+        return str ? std::string((const char *) str) : std::string();
+    };
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hashString(hash, vertex_str);
+    hashString(hash, fragment_str);
+    hashString(hash, geometry_str);
+    hashString(hash, defines);
+    hashString(hash, glString(GL_VENDOR));
+    hashString(hash, glString(GL_RENDERER));
+    hashString(hash, glString(GL_VERSION));
+
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%016llx.glbin", (unsigned long long) hash);
+    std::string dir = binaryCacheDir;
+    if (dir.back() != '/' && dir.back() != '\\')
+        dir += '/';
+    return dir + buf;
+}
+
+/* Header of a cached program binary */
+struct ProgramBinaryHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t size;
+};
+
+/* Larger cached binaries are considered corrupt */
+static const uint32_t __nanogui_max_program_binary = 64u << 20;
+
+bool GLShader::loadBinary(const std::string &filename) {
+    std::ifstream is(filename, std::ios::binary);
+    if (!is)
+        return false;
+
+    ProgramBinaryHeader header;
+    if (!is.read((char *) &header, sizeof(header)) ||
+        memcmp(header.magic, "NGPBIN1", 8) != 0)
+        return false;
+
+    /* Check the size against the file before allocating */
+    std::streamoff start = is.tellg();
+    is.seekg(0, std::ios::end);
+    std::streamoff remaining = is.tellg() - start;
+    is.seekg(start);
+    if (!is || header.size == 0 || header.size > __nanogui_max_program_binary ||
+        (std::streamoff) header.size > remaining)
+        return false;
+
+    std::vector<char> binary(header.size);
+    if (!is.read(binary.data(), header.size))
+        return false;
+
+    mProgramShader = glCreateProgram();
+    programBinary(mProgramShader, (GLenum) header.format, binary.data(), (GLsizei) header.size);
+
+    /* Drivers reject binaries after updates; fall back to the sources then */
+    GLint status;
+    glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(mProgramShader);
+        mProgramShader = 0;
+        return false;
+    }
+    return true;
+}
+
+void GLShader::saveBinary(const std::string &filename) const {
+    GLint length = 0;
+    glGetProgramiv(mProgramShader, NANOGUI_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary((size_t) length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    getProgramBinary(mProgramShader, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    ProgramBinaryHeader header;
+    memcpy(header.magic, "NGPBIN1", 8);
+    header.format = (uint32_t) format;
+    header.size = (uint32_t) written;
+
+    /* Write to a temporary file first, so that a crash never leaves a truncated binary */
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary);
+        if (!os)
+            return;
+        os.write((const char *) &header, sizeof(header));
+        os.write(binary.data(), written);
+        if (!os)
+            return;
+    }
+    std::remove(filename.c_str());
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        std::remove(tmp.c_str());
+}
+
+/* Entry points and constants of GL_KHR_parallel_shader_compile (and of
+   the equivalent ARB extension) */
+#define NANOGUI_COMPLETION_STATUS 0x91B1
+typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADS)(GLuint);
+
+bool GLShader::parallelCompileSupported() {
+    static int supported = -1;
+    if (supported < 0) {
+        PFNMAXSHADERCOMPILERTHREADS maxShaderCompilerThreads = nullptr;
+        if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+            maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS)
+                glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+            maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS)
+                glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+        /* Let the driver choose the number of threads */
+        if (maxShaderCompilerThreads)
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+        supported = maxShaderCompilerThreads ? 1 : 0;
+    }
+    return supported == 1;
+}
+
 bool GLShader::init(const std::string &name,
                     const std::string &vertex_str,
                     const std::string &fragment_str,
                     const std::string &geometry_str) {
+    if (!beginInit(name, vertex_str, fragment_str, geometry_str))
+        return false;
+    return finishInit();
+}
+
+bool GLShader::beginInit(const std::string &name,
+                         const std::string &vertex_str,
+                         const std::string &fragment_str,
+                         const std::string &geometry_str) {
+    mInitStart = currentTime();
+
     std::string defines;
     for (auto def : mDefinitions)
         defines += std::string("#define ") + def.first + std::string(" ") + def.second + "\n";
 
     glGenVertexArrays(1, &mVertexArrayObject);
     mName = name;
+    mLoadedFromCache = false;
+    mPendingCacheFile.clear();
+
+    std::string cacheFile = binaryCachePath(vertex_str, fragment_str, geometry_str, defines);
+    if (!cacheFile.empty() && loadBinary(cacheFile)) {
+        mLoadedFromCache = true;
+        mInitPending = true;
+        return true;
+    }
+
+    if (vertex_str.empty() || fragment_str.empty())
+        return false;
+
+    mPendingSources = { vertex_str, geometry_str, fragment_str };
     mVertexShader =
-        createShader_helper(GL_VERTEX_SHADER, name, defines, vertex_str);
+        createShader_helper(GL_VERTEX_SHADER, defines, mPendingSources[0]);
     mGeometryShader =
-        createShader_helper(GL_GEOMETRY_SHADER, name, defines, geometry_str);
+        createShader_helper(GL_GEOMETRY_SHADER, defines, mPendingSources[1]);
     mFragmentShader =
-        createShader_helper(GL_FRAGMENT_SHADER, name, defines, fragment_str);
-
-    if (!mVertexShader || !mFragmentShader)
-        return false;
-    if (!geometry_str.empty() && !mGeometryShader)
-        return false;
+        createShader_helper(GL_FRAGMENT_SHADER, defines, mPendingSources[2]);
 
     mProgramShader = glCreateProgram();
 
@@ -114,58 +607,188 @@ bool GLShader::init(const std::string &name,
     if (mGeometryShader)
         glAttachShader(mProgramShader, mGeometryShader);
 
+    if (!cacheFile.empty())
+        programParameteri(mProgramShader, NANOGUI_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    /* Without error checks in between, drivers may compile and link in the background */
     glLinkProgram(mProgramShader);
 
-    GLint status;
-    glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
+    mPendingCacheFile = cacheFile;
+    mInitPending = true;
+    return true;
+}
 
-    if (status != GL_TRUE) {
-        char buffer[512];
-        glGetProgramInfoLog(mProgramShader, 512, nullptr, buffer);
-        std::cerr << "Linker error (" << mName << "): " << std::endl << buffer << std::endl;
-        mProgramShader = 0;
-        throw std::runtime_error("Shader linking failed!");
+bool GLShader::initComplete() const {
+    if (!mInitPending || mLoadedFromCache || !parallelCompileSupported())
+        return true;
+    GLint done = GL_TRUE;
+    glGetProgramiv(mProgramShader, NANOGUI_COMPLETION_STATUS, &done);
+    return done == GL_TRUE;
+}
+
+bool GLShader::finishInit() {
+    if (!mInitPending)
+        return mProgramShader != 0;
+    mInitPending = false;
+
+    if (!mLoadedFromCache) {
+        checkShader_helper(mVertexShader, GL_VERTEX_SHADER, mName, mPendingSources[0]);
+        if (mGeometryShader)
+            checkShader_helper(mGeometryShader, GL_GEOMETRY_SHADER, mName, mPendingSources[1]);
+        checkShader_helper(mFragmentShader, GL_FRAGMENT_SHADER, mName, mPendingSources[2]);
+        mPendingSources.clear();
+
+        GLint status;
+        glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
+
+        if (status != GL_TRUE) {
+            char buffer[512];
+            glGetProgramInfoLog(mProgramShader, 512, nullptr, buffer);
+            std::cerr << "Linker error (" << mName << "): " << std::endl << buffer << std::endl;
+            mProgramShader = 0;
+            throw std::runtime_error("Shader linking failed!");
+        }
+    }
+
+    queryLocations();
+
+    if (!mPendingCacheFile.empty())
+        saveBinary(mPendingCacheFile);
+
+    mInitTime = currentTime() - mInitStart;
+    if (mLoadedFromCache) {
+        binaryCacheStatistics.hits++;
+        binaryCacheStatistics.warmSeconds += mInitTime;
+    } else if (!mPendingCacheFile.empty()) {
+        binaryCacheStatistics.misses++;
+        binaryCacheStatistics.coldSeconds += mInitTime;
     }
+    mPendingCacheFile.clear();
 
     return true;
 }
 
+void GLShader::queryLocations() {
+    mUniforms.clear();
+    mAttribs.clear();
+    mUniformBlocks.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(mProgramShader, (GLuint) i, (GLsizei) buffer.size(),
+                           nullptr, &size, &type, buffer.data());
+        std::string name(buffer.data());
+        /* Members of uniform blocks have no location */
+        GLint id = glGetUniformLocation(mProgramShader, name.c_str());
+        if (id < 0)
+            continue;
+        mUniforms[name] = id;
+        /* Arrays are reported as "name[0]"; also register the plain name */
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            mUniforms[name.substr(0, name.size() - 3)] = id;
+    }
+
+    glGetProgramiv(mProgramShader, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(mProgramShader, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    buffer.resize(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(mProgramShader, (GLuint) i, (GLsizei) buffer.size(),
+                          nullptr, &size, &type, buffer.data());
+        GLint id = glGetAttribLocation(mProgramShader, buffer.data());
+        if (id >= 0)
+            mAttribs[buffer.data()] = id;
+    }
+
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    buffer.resize(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; ++i) {
+        glGetActiveUniformBlockName(mProgramShader, (GLuint) i, (GLsizei) buffer.size(),
+                                    nullptr, buffer.data());
+        mUniformBlocks[buffer.data()] = (GLuint) i;
+    }
+}
+
 void GLShader::bind() {
-    glUseProgram(mProgramShader);
-    glBindVertexArray(mVertexArrayObject);
+    GLState::useProgram(mProgramShader);
+    GLState::bindVertexArray(mVertexArrayObject);
 }
 
 GLint GLShader::attrib(const std::string &name, bool warn) const {
-    GLint id = glGetAttribLocation(mProgramShader, name.c_str());
+    auto it = mAttribs.find(name);
+    if (it == mAttribs.end())
+        it = mAttribs.emplace(name, glGetAttribLocation(mProgramShader, name.c_str())).first;
+    GLint id = it->second;
     if (id == -1 && warn)
         std::cerr << mName << ": warning: did not find attrib " << name << std::endl;
     return id;
 }
 
 GLint GLShader::uniform(const std::string &name, bool warn) const {
-    GLint id = glGetUniformLocation(mProgramShader, name.c_str());
+    auto it = mUniforms.find(name);
+    if (it == mUniforms.end())
+        it = mUniforms.emplace(name, glGetUniformLocation(mProgramShader, name.c_str())).first;
+    GLint id = it->second;
     if (id == -1 && warn)
         std::cerr << mName << ": warning: did not find uniform " << name << std::endl;
     return id;
 }
 
+GLuint GLShader::uniformBlock(const std::string &name, bool warn) const {
+    auto it = mUniformBlocks.find(name);
+    if (it == mUniformBlocks.end()) {
+        if (warn)
+            std::cerr << mName << ": warning: did not find uniform block " << name << std::endl;
+        return GL_INVALID_INDEX;
+    }
+    return it->second;
+}
+
+void GLShader::bindUniformBlock(const std::string &name, GLuint binding, bool warn) {
+    GLuint index = uniformBlock(name, warn);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(mProgramShader, index, binding);
+}
+
 void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
-                             uint32_t compSize, GLuint glType, bool integral, const uint8_t *data, int version) {
+                             uint32_t compSize, GLuint glType, bool integral, const uint8_t *data,
+                             int version, GLuint divisor) {
     int attribID = 0;
     if (name != "indices") {
-        attribID = attrib(name);
-        if (attribID < 0)
+        attribID = attrib(name, !mKeepInactiveAttribs);
+        if (attribID < 0 && !mKeepInactiveAttribs)
             return;
     }
 
     GLuint bufferID;
+    bool reallocate = true, streaming;
     auto it = mBufferObjects.find(name);
     if (it != mBufferObjects.end()) {
         Buffer &buffer = it->second;
+        if (version != -1 && buffer.version == version && buffer.size == size &&
+            buffer.compSize == compSize && buffer.glType == glType &&
+            buffer.dim == (GLuint) dim && buffer.integral == integral &&
+            buffer.divisor == divisor)
+            return;
         bufferID = it->second.id;
+        reallocate = (size_t) buffer.size * buffer.compSize != (size_t) size * compSize;
         buffer.version = version;
         buffer.size = size;
         buffer.compSize = compSize;
+        buffer.glType = glType;
+        buffer.dim = dim;
+        buffer.integral = integral;
+        buffer.divisor = divisor;
+        buffer.pendingWrites.clear();
+        buffer.pendingData.clear();
+        streaming = buffer.streaming;
     } else {
         glGenBuffers(1, &bufferID);
         Buffer buffer;
@@ -175,25 +798,262 @@ void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
         buffer.compSize = compSize;
         buffer.size = size;
         buffer.version = version;
+        buffer.integral = integral;
+        buffer.divisor = divisor;
+        buffer.streaming = streaming = mStreamingAttribs.count(name) != 0;
         mBufferObjects[name] = buffer;
     }
     size_t totalSize = (size_t) size * (size_t) compSize;
+    GLenum target = name == "indices" ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    if (name == "indices")
+        mIndexType = glType;
 
-    if (name == "indices") {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
+    GLState::bindBuffer(target, bufferID);
+    if (reallocate) {
+        glBufferData(target, totalSize, data, streaming ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
     } else {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
+        /* Orphan the old storage of streaming buffers so that pending draws
+           can keep using it; others are updated in place */
+        if (streaming)
+            glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, totalSize, data);
+    }
+
+    if (name != "indices" && attribID >= 0) {
         if (size == 0) {
             glDisableVertexAttribArray(attribID);
         } else {
             glEnableVertexAttribArray(attribID);
             glVertexAttribPointer(attribID, dim, glType, integral, 0, 0);
+            glVertexAttribDivisor(attribID, divisor);
         }
     }
 }
 
+/* Convert a float to half precision, rounding to the nearest even value */
+static uint16_t floatToHalf(float value) {
+    uint32_t f;
+    memcpy(&f, &value, sizeof(float));
+    uint16_t sign = (uint16_t) ((f >> 16) & 0x8000);
+    f &= 0x7fffffff;
+
+    if (f >= 0x47800000) /* Overflow, infinity or NaN */
+        return sign | (f > 0x7f800000 ? 0x7e00 : 0x7c00);
+
+    if (f < 0x38800000) { /* Subnormal result (or zero) */
+        float a;
+        memcpy(&a, &f, sizeof(float));
+        return sign | (uint16_t) std::lrint(a * 16777216.f);
+    }
+
+    /* Rebias the exponent and round the mantissa */
+    f += 0xc8000fffu + ((f >> 13) & 1);
+    return sign | (uint16_t) (f >> 13);
+}
+
+template <typename T> static void quantize(const float *data, size_t count, float lo, float scale,
+                                           std::vector<uint8_t> &out) {
+    out.resize(count * sizeof(T));
+    T *dst = (T *) out.data();
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = (T) std::lrint(std::min(std::max(data[i], lo), 1.f) * scale);
+}
+
+/* GL type, component size and normalization of an attribute format */
+static void attribFormatType(GLShader::AttribFormat format, GLuint &glType,
+                             uint32_t &compSize, bool &normalized) {
+    normalized = true;
+    switch (format) {
+        case GLShader::AttribFormat::Float32: glType = GL_FLOAT; compSize = sizeof(float); normalized = false; break;
+        case GLShader::AttribFormat::Float16: glType = GL_HALF_FLOAT; compSize = sizeof(uint16_t); normalized = false; break;
+        case GLShader::AttribFormat::SNorm16: glType = GL_SHORT; compSize = sizeof(int16_t); break;
+        case GLShader::AttribFormat::UNorm16: glType = GL_UNSIGNED_SHORT; compSize = sizeof(uint16_t); break;
+        case GLShader::AttribFormat::SNorm8: glType = GL_BYTE; compSize = sizeof(int8_t); break;
+        case GLShader::AttribFormat::UNorm8: glType = GL_UNSIGNED_BYTE; compSize = sizeof(uint8_t); break;
+    }
+}
+
+void GLShader::uploadAttrib(const std::string &name, const float *data, uint32_t size, int dim,
+                            AttribFormat format, int version, GLuint divisor) {
+    GLuint glType = GL_FLOAT;
+    uint32_t compSize = sizeof(float);
+    bool normalized = false;
+    attribFormatType(format, glType, compSize, normalized);
+
+    /* Check the version (and layout) before doing any conversion work */
+    auto it = mBufferObjects.find(name);
+    if (version != -1 && it != mBufferObjects.end() && it->second.version == version &&
+        it->second.size == size && it->second.dim == (GLuint) dim &&
+        it->second.glType == glType && it->second.compSize == compSize &&
+        it->second.integral == normalized && it->second.divisor == divisor)
+        return;
+
+    std::vector<uint8_t> packed;
+    switch (format) {
+        case AttribFormat::Float32:
+            uploadAttrib(name, size, dim, compSize, glType, normalized,
+                         (const uint8_t *) data, version, divisor);
+            return;
+
+        case AttribFormat::Float16: {
+                packed.resize(size * sizeof(uint16_t));
+                uint16_t *dst = (uint16_t *) packed.data();
+                for (uint32_t i = 0; i < size; ++i)
+                    dst[i] = floatToHalf(data[i]);
+            }
+            break;
+
+        case AttribFormat::SNorm16: quantize<int16_t>(data, size, -1.f, 32767.f, packed); break;
+        case AttribFormat::UNorm16: quantize<uint16_t>(data, size, 0.f, 65535.f, packed); break;
+        case AttribFormat::SNorm8: quantize<int8_t>(data, size, -1.f, 127.f, packed); break;
+        case AttribFormat::UNorm8: quantize<uint8_t>(data, size, 0.f, 255.f, packed); break;
+    }
+
+    uploadAttrib(name, size, dim, compSize, glType, normalized, packed.data(), version, divisor);
+}
+
+void GLShader::uploadIndices(const uint32_t *data, uint32_t size, int dim, int version) {
+    auto it = mBufferObjects.find("indices");
+    if (version != -1 && it != mBufferObjects.end() && it->second.version == version &&
+        it->second.size == size && it->second.dim == (GLuint) dim &&
+        (it->second.glType == GL_UNSIGNED_SHORT || it->second.glType == GL_UNSIGNED_INT))
+        return;
+
+    uint32_t maxIndex = 0;
+    for (uint32_t i = 0; i < size; ++i)
+        maxIndex = std::max(maxIndex, data[i]);
+
+    if (maxIndex > 0xFFFF) {
+        uploadAttrib("indices", size, dim, sizeof(uint32_t), GL_UNSIGNED_INT, true,
+                     (const uint8_t *) data, version);
+        return;
+    }
+
+    std::vector<uint16_t> packed(data, data + size);
+    uploadAttrib("indices", size, dim, sizeof(uint16_t), GL_UNSIGNED_SHORT, true,
+                 (const uint8_t *) packed.data(), version);
+}
+
+void GLShader::updateAttribRange(const std::string &name, uint32_t offset, uint32_t count,
+                                 uint32_t compSize, const uint8_t *data, int version) {
+    auto it = mBufferObjects.find(name);
+    if (it == mBufferObjects.end())
+        throw std::runtime_error("updateAttribRange(" + mName + ", " + name + "): buffer not found!");
+
+    Buffer &buf = it->second;
+    if (((size_t) offset + count) * buf.dim > buf.size)
+        throw std::runtime_error("updateAttribRange(" + mName + ", " + name + "): out of bounds!");
+
+    /* 32-bit indices written to a buffer that uploadIndices() narrowed */
+    std::vector<uint16_t> narrowed;
+    if (name == "indices" && buf.compSize == sizeof(uint16_t) && compSize == sizeof(uint32_t)) {
+        const uint32_t *indices = (const uint32_t *) data;
+        size_t n = (size_t) count * buf.dim;
+        if (std::all_of(indices, indices + n, [](uint32_t i) { return i <= 0xFFFF; })) {
+            narrowed.assign(indices, indices + n);
+            data = (const uint8_t *) narrowed.data();
+            compSize = sizeof(uint16_t);
+        } else {
+            widenIndices();
+        }
+    }
+
+    if (buf.compSize != compSize)
+        throw std::runtime_error("updateAttribRange(" + mName + ", " + name + "): type mismatch!");
+
+    buf.version = version;
+    if (count == 0)
+        return;
+
+    size_t bytes = (size_t) count * buf.dim * compSize;
+    Buffer::Write write;
+    write.offset = (size_t) offset * buf.dim * compSize;
+    write.size = bytes;
+    write.source = buf.pendingData.size();
+    buf.pendingData.insert(buf.pendingData.end(), data, data + bytes);
+    buf.pendingWrites.push_back(write);
+    mPendingWrites = true;
+}
+
+void GLShader::widenIndices() {
+    auto it = mBufferObjects.find("indices");
+    if (it == mBufferObjects.end() || it->second.compSize != sizeof(uint16_t))
+        return;
+    flushAttribs();
+
+    Buffer &buf = it->second;
+    std::vector<uint16_t> narrow(buf.size);
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, buf.id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, narrow.size() * sizeof(uint16_t), narrow.data());
+    std::vector<uint32_t> wide(narrow.begin(), narrow.end());
+
+    /* GL_COPY_WRITE_BUFFER leaves the element array binding of the VAO alone */
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buf.id);
+    glBufferData(GL_COPY_WRITE_BUFFER, wide.size() * sizeof(uint32_t), wide.data(),
+                 buf.streaming ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
+    buf.compSize = sizeof(uint32_t);
+    buf.glType = GL_UNSIGNED_INT;
+    mIndexType = GL_UNSIGNED_INT;
+}
+
+void GLShader::flushAttribs() {
+    if (!mPendingWrites)
+        return;
+    mPendingWrites = false;
+
+    std::vector<uint8_t> staging;
+    for (auto &item : mBufferObjects) {
+        Buffer &buf = item.second;
+        if (buf.pendingWrites.empty())
+            continue;
+
+        /* Merge overlapping and adjacent writes into disjoint intervals */
+        std::vector<Buffer::Write> sorted(buf.pendingWrites);
+        std::sort(sorted.begin(), sorted.end(),
+            [](const Buffer::Write &a, const Buffer::Write &b) { return a.offset < b.offset; });
+        std::vector<std::pair<size_t, size_t>> intervals;
+        for (auto const &w : sorted) {
+            if (!intervals.empty() && w.offset <= intervals.back().second)
+                intervals.back().second = std::max(intervals.back().second, w.offset + w.size);
+            else
+                intervals.push_back(std::make_pair(w.offset, w.offset + w.size));
+        }
+
+        /* GL_COPY_WRITE_BUFFER leaves the element array binding of the VAO alone */
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buf.id);
+        for (auto const &interval : intervals) {
+            size_t begin = interval.first, end = interval.second;
+            const uint8_t *src;
+            if (buf.pendingWrites.size() == 1) {
+                src = buf.pendingData.data();
+            } else {
+                /* Replay the writes in submission order so that later ones win */
+                staging.resize(end - begin);
+                for (auto const &w : buf.pendingWrites) {
+                    if (w.offset >= begin && w.offset + w.size <= end)
+                        memcpy(staging.data() + (w.offset - begin),
+                               buf.pendingData.data() + w.source, w.size);
+                }
+                src = staging.data();
+            }
+            glBufferSubData(GL_COPY_WRITE_BUFFER, begin, end - begin, src);
+        }
+
+        buf.pendingWrites.clear();
+        buf.pendingData.clear();
+    }
+}
+
+void GLShader::setAttribStreaming(const std::string &name, bool streaming) {
+    if (streaming)
+        mStreamingAttribs.insert(name);
+    else
+        mStreamingAttribs.erase(name);
+    auto it = mBufferObjects.find(name);
+    if (it != mBufferObjects.end())
+        it->second.streaming = streaming;
+}
+
 void GLShader::downloadAttrib(const std::string &name, uint32_t size, int /* dim */,
                              uint32_t compSize, GLuint /* glType */, uint8_t *data) {
     auto it = mBufferObjects.find(name);
@@ -201,20 +1061,43 @@ void GLShader::downloadAttrib(const std::string &name, uint32_t size, int /* dim
         throw std::runtime_error("downloadAttrib(" + mName + ", " + name + ") : buffer not found!");
 
     const Buffer &buf = it->second;
-    if (buf.size != size || buf.compSize != compSize)
+    bool widen = name == "indices" && buf.compSize == sizeof(uint16_t) &&
+                 compSize == sizeof(uint32_t);
+    if (buf.size != size || (buf.compSize != compSize && !widen))
         throw std::runtime_error(mName + ": downloadAttrib: size mismatch!");
 
+    flushAttribs();
+
+    if (widen) {
+        /* Indices that uploadIndices() stored as 16-bit values */
+        std::vector<uint16_t> narrow(size);
+        GLState::bindBuffer(GL_COPY_READ_BUFFER, buf.id);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, narrow.size() * sizeof(uint16_t), narrow.data());
+        std::copy(narrow.begin(), narrow.end(), (uint32_t *) data);
+        return;
+    }
+
     size_t totalSize = (size_t) size * (size_t) compSize;
 
     if (name == "indices") {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buf.id);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buf.id);
         glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, totalSize, data);
     } else {
-        glBindBuffer(GL_ARRAY_BUFFER, buf.id);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, buf.id);
         glGetBufferSubData(GL_ARRAY_BUFFER, 0, totalSize, data);
     }
 }
 
+void GLShader::downloadAttribAsync(const std::string &name, GLReadback &readback) {
+    auto it = mBufferObjects.find(name);
+    if (it == mBufferObjects.end())
+        throw std::runtime_error("downloadAttribAsync(" + mName + ", " + name + ") : buffer not found!");
+
+    flushAttribs();
+    const Buffer &buf = it->second;
+    readback.copy(buf.id, 0, (size_t) buf.size * (size_t) buf.compSize);
+}
+
 void GLShader::shareAttrib(const GLShader &otherShader, const std::string &name, const std::string &_as) {
     std::string as = _as.length() == 0 ? name : _as;
     auto it = otherShader.mBufferObjects.find(name);
@@ -227,10 +1110,12 @@ void GLShader::shareAttrib(const GLShader &otherShader, const std::string &name,
         if (attribID < 0)
             return;
         glEnableVertexAttribArray(attribID);
-        glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
-        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, buffer.compSize == 1 ? GL_TRUE : GL_FALSE, 0, 0);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, buffer.id);
+        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, buffer.integral, 0, 0);
+        glVertexAttribDivisor(attribID, buffer.divisor);
     } else {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id);
+        mIndexType = buffer.glType;
     }
 }
 
@@ -240,50 +1125,429 @@ void GLShader::invalidateAttribs() {
 }
 
 void GLShader::freeAttrib(const std::string &name) {
+    mStreamingAttribs.erase(name);
     auto it = mBufferObjects.find(name);
     if (it != mBufferObjects.end()) {
+        GLState::forget(it->second.id);
         glDeleteBuffers(1, &it->second.id);
         mBufferObjects.erase(it);
     }
 }
 
-void GLShader::drawIndexed(int type, uint32_t offset_, uint32_t count_) {
-    if (count_ == 0)
-        return;
-    size_t offset = offset_;
-    size_t count = count_;
+void GLShader::setTimer(GLTimer *timer, const std::string &phase) {
+    mTimer = timer;
+    mTimerPhase = timer ? timer->phase(phase) : -1;
+}
 
+void GLShader::indexRange(int type, size_t &offset, size_t &count) {
     switch (type) {
         case GL_TRIANGLES: offset *= 3; count *= 3; break;
         case GL_LINES: offset *= 2; count *= 2; break;
     }
+}
 
-    glDrawElements(type, (GLsizei) count, GL_UNSIGNED_INT,
-                   (const void *)(offset * sizeof(uint32_t)));
+void GLShader::drawIndexed(int type, uint32_t offset_, uint32_t count_, int32_t baseVertex) {
+    if (count_ == 0)
+        return;
+    flushAttribs();
+    GLTimer::Scope scope(mTimer, mTimerPhase);
+    size_t offset = offset_;
+    size_t count = count_;
+    indexRange(type, offset, count);
+
+    const void *indices = (const void *)(offset * indexSize());
+    if (baseVertex == 0)
+        glDrawElements(type, (GLsizei) count, mIndexType, indices);
+    else
+        glDrawElementsBaseVertex(type, (GLsizei) count, mIndexType, indices, baseVertex);
 }
 
 void GLShader::drawArray(int type, uint32_t offset, uint32_t count) {
     if (count == 0)
         return;
+    flushAttribs();
+    GLTimer::Scope scope(mTimer, mTimerPhase);
 
     glDrawArrays(type, offset, count);
 }
 
+/* Entry points of GL_ARB_base_instance (core in OpenGL 4.2), which are
+   not part of the OpenGL 3.3 loader */
+typedef void (APIENTRYP PFNDRAWARRAYSINSTANCEDBASEINSTANCE)(GLenum, GLint, GLsizei, GLsizei, GLuint);
+typedef void (APIENTRYP PFNDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCE)(GLenum, GLsizei, GLenum, const void *, GLsizei, GLint, GLuint);
+static PFNDRAWARRAYSINSTANCEDBASEINSTANCE drawArraysInstancedBaseInstance = nullptr;
+static PFNDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCE drawElementsInstancedBaseVertexBaseInstance = nullptr;
+
+bool GLShader::hasBaseInstance() {
+    static int supported = -1;
+    if (supported < 0) {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        supported = 0;
+        if (major > 4 || (major == 4 && minor >= 2) ||
+            glfwExtensionSupported("GL_ARB_base_instance")) {
+            drawArraysInstancedBaseInstance = (PFNDRAWARRAYSINSTANCEDBASEINSTANCE)
+                glfwGetProcAddress("glDrawArraysInstancedBaseInstance");
+            drawElementsInstancedBaseVertexBaseInstance = (PFNDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCE)
+                glfwGetProcAddress("glDrawElementsInstancedBaseVertexBaseInstance");
+            supported = drawArraysInstancedBaseInstance &&
+                        drawElementsInstancedBaseVertexBaseInstance ? 1 : 0;
+        }
+    }
+    return supported == 1;
+}
+
+void GLShader::offsetInstanceAttribs(uint32_t baseInstance) {
+    for (auto const &item : mBufferObjects) {
+        const Buffer &buf = item.second;
+        if (buf.divisor == 0 || item.first == "indices")
+            continue;
+        if (baseInstance % buf.divisor != 0)
+            throw std::runtime_error(mName + ": the base instance must be a multiple of the "
+                                     "divisor of attribute " + item.first + "!");
+        GLint id = attrib(item.first, false);
+        if (id < 0)
+            continue;
+        size_t offset = (size_t) (baseInstance / buf.divisor) * buf.dim * buf.compSize;
+        GLState::bindBuffer(GL_ARRAY_BUFFER, buf.id);
+        glVertexAttribPointer(id, buf.dim, buf.glType, buf.integral, 0, (const void *) offset);
+    }
+}
+
+void GLShader::drawArrayInstanced(int type, uint32_t offset, uint32_t count,
+                                  uint32_t instanceCount, uint32_t baseInstance) {
+    if (count == 0 || instanceCount == 0)
+        return;
+    flushAttribs();
+    GLTimer::Scope scope(mTimer, mTimerPhase);
+
+    if (baseInstance == 0) {
+        glDrawArraysInstanced(type, offset, count, instanceCount);
+    } else if (hasBaseInstance()) {
+        drawArraysInstancedBaseInstance(type, offset, count, instanceCount, baseInstance);
+    } else {
+        offsetInstanceAttribs(baseInstance);
+        glDrawArraysInstanced(type, offset, count, instanceCount);
+        offsetInstanceAttribs(0);
+    }
+}
+
+void GLShader::drawIndexedInstanced(int type, uint32_t offset_, uint32_t count_,
+                                    uint32_t instanceCount, int32_t baseVertex,
+                                    uint32_t baseInstance) {
+    if (count_ == 0 || instanceCount == 0)
+        return;
+    flushAttribs();
+    GLTimer::Scope scope(mTimer, mTimerPhase);
+    size_t offset = offset_;
+    size_t count = count_;
+    indexRange(type, offset, count);
+    const void *indices = (const void *)(offset * indexSize());
+
+    if (baseInstance != 0 && hasBaseInstance()) {
+        drawElementsInstancedBaseVertexBaseInstance(type, (GLsizei) count, mIndexType, indices,
+                                                    instanceCount, baseVertex, baseInstance);
+        return;
+    }
+
+    if (baseInstance != 0)
+        offsetInstanceAttribs(baseInstance);
+    if (baseVertex == 0)
+        glDrawElementsInstanced(type, (GLsizei) count, mIndexType, indices, instanceCount);
+    else
+        glDrawElementsInstancedBaseVertex(type, (GLsizei) count, mIndexType, indices,
+                                          instanceCount, baseVertex);
+    if (baseInstance != 0)
+        offsetInstanceAttribs(0);
+}
+
 void GLShader::free() {
-    for (auto &buf: mBufferObjects)
+    GLBufferArena::releaseShader(this);
+
+    for (auto &buf: mBufferObjects) {
+        GLState::forget(buf.second.id);
         glDeleteBuffers(1, &buf.second.id);
+    }
 
-    if (mVertexArrayObject)
+    if (mVertexArrayObject) {
+        GLState::forget(mVertexArrayObject);
         glDeleteVertexArrays(1, &mVertexArrayObject);
+    }
 
+    mUniforms.clear();
+    mAttribs.clear();
+    mUniformBlocks.clear();
+
+    GLState::forget(mProgramShader);
     glDeleteProgram(mProgramShader); mProgramShader = 0;
     glDeleteShader(mVertexShader);   mVertexShader = 0;
     glDeleteShader(mFragmentShader); mFragmentShader = 0;
     glDeleteShader(mGeometryShader); mGeometryShader = 0;
 }
 
-void GLFramebuffer::init(const Vector2i &size, int nSamples) {
+void GLUniformBuffer::init(size_t size, const void *data) {
+    if (mBuffer == 0)
+        glGenBuffers(1, &mBuffer);
     mSize = size;
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+}
+
+void GLUniformBuffer::update(const void *data, size_t size, size_t offset) {
+    if (offset + size > mSize)
+        throw std::runtime_error("GLUniformBuffer::update(): out of bounds!");
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void GLUniformBuffer::bind(GLuint binding) const {
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding, mBuffer);
+}
+
+void GLUniformBuffer::bind(GLuint binding, size_t offset, size_t size) const {
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, binding, mBuffer, offset, size);
+}
+
+void GLUniformBuffer::free() {
+    if (mBuffer) {
+        GLState::forget(mBuffer);
+        glDeleteBuffers(1, &mBuffer);
+    }
+    mBuffer = 0;
+    mSize = 0;
+}
+
+void GLReadback::copy(GLuint buffer, size_t offset, size_t size) {
+    if (mFence)
+        glDeleteSync(mFence);
+    if (mBuffer == 0)
+        glGenBuffers(1, &mBuffer);
+
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+    if (size > mCapacity) {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_READ);
+        mCapacity = size;
+    }
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+
+    mSize = size;
+    mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mFlushed = false;
+}
+
+bool GLReadback::ready() {
+    if (!mFence)
+        return false;
+    /* The first poll flushes, so that the fence is guaranteed to signal eventually */
+    GLenum result = glClientWaitSync(mFence, mFlushed ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    mFlushed = true;
+    if (result == GL_WAIT_FAILED)
+        throw std::runtime_error("GLReadback::ready(): glClientWaitSync() failed!");
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+void GLReadback::wait() {
+    if (!mFence)
+        return;
+    while (true) {
+        GLenum result = glClientWaitSync(mFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            break;
+        if (result == GL_WAIT_FAILED)
+            throw std::runtime_error("GLReadback::wait(): glClientWaitSync() failed!");
+    }
+    mFlushed = true;
+}
+
+void GLReadback::read(void *data) {
+    if (!mFence)
+        throw std::runtime_error("GLReadback::read(): no download is pending!");
+    wait();
+
+    GLState::bindBuffer(GL_COPY_READ_BUFFER, mBuffer);
+    if (mSize > 0) {
+        const void *ptr = glMapBufferRange(GL_COPY_READ_BUFFER, 0, mSize, GL_MAP_READ_BIT);
+        if (!ptr)
+            throw std::runtime_error("GLReadback::read(): could not map the staging buffer!");
+        memcpy(data, ptr, mSize);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+
+    glDeleteSync(mFence);
+    mFence = nullptr;
+}
+
+void GLReadback::free() {
+    if (mFence)
+        glDeleteSync(mFence);
+    if (mBuffer) {
+        GLState::forget(mBuffer);
+        glDeleteBuffers(1, &mBuffer);
+    }
+    mFence = nullptr;
+    mBuffer = 0;
+    mCapacity = mSize = 0;
+}
+
+GLReadback &GLReadbackRing::acquire() {
+    int depth = (int) mSlots.size();
+    if (mCount == depth) {
+        /* All slots are in flight: give up on the oldest download */
+        if (mSlots[mHead].pending())
+            mDropped++;
+        mHead = (mHead + 1) % depth;
+        mCount--;
+    }
+    GLReadback &slot = mSlots[(mHead + mCount) % depth];
+    mCount++;
+    return slot;
+}
+
+GLReadback *GLReadbackRing::oldest() {
+    /* Skip slots that were read already (or never used) */
+    while (mCount > 0 && !mSlots[mHead].pending()) {
+        mHead = (mHead + 1) % (int) mSlots.size();
+        mCount--;
+    }
+    return mCount > 0 ? &mSlots[mHead] : nullptr;
+}
+
+GLReadback *GLReadbackRing::poll() {
+    GLReadback *slot = oldest();
+    return slot && slot->ready() ? slot : nullptr;
+}
+
+void GLReadbackRing::free() {
+    for (auto &slot : mSlots)
+        slot.free();
+    mHead = mCount = 0;
+}
+
+int GLTimer::phase(const std::string &name) {
+    for (size_t i = 0; i < mPhases.size(); ++i)
+        if (mPhases[i].name == name)
+            return (int) i;
+    Phase phase;
+    phase.name = name;
+    phase.history.resize(mWindow, 0.0);
+    mPhases.push_back(phase);
+    return (int) mPhases.size() - 1;
+}
+
+GLuint GLTimer::query() {
+    if (mFreeQueries.empty()) {
+        GLuint queries[16];
+        glGenQueries(16, queries);
+        mFreeQueries.insert(mFreeQueries.end(), queries, queries + 16);
+        mAllQueries.insert(mAllQueries.end(), queries, queries + 16);
+    }
+    GLuint id = mFreeQueries.back();
+    mFreeQueries.pop_back();
+    return id;
+}
+
+void GLTimer::begin(int index) {
+    if (mFrames.empty())
+        mFrames.emplace_back();
+    Phase &phase = mPhases.at(index);
+    if (phase.isOpen)
+        throw std::runtime_error("GLTimer::begin(" + phase.name + "): phase is already open!");
+    phase.open = query();
+    phase.isOpen = true;
+    glQueryCounter(phase.open, GL_TIMESTAMP);
+}
+
+void GLTimer::end(int index) {
+    Phase &phase = mPhases.at(index);
+    if (!phase.isOpen)
+        throw std::runtime_error("GLTimer::end(" + phase.name + "): phase was not started!");
+    GLuint id = query();
+    glQueryCounter(id, GL_TIMESTAMP);
+    mFrames.back().push_back(Interval { index, phase.open, id });
+    phase.isOpen = false;
+}
+
+void GLTimer::beginFrame() {
+    /* Frames complete in order, so only the oldest ones need to be checked */
+    size_t done = 0;
+    while (done < mFrames.size()) {
+        const std::vector<Interval> &frame = mFrames[done];
+        if (!frame.empty()) {
+            GLint available = 0;
+            glGetQueryObjectiv(frame.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+        }
+        collect(frame);
+        done++;
+    }
+    mFrames.erase(mFrames.begin(), mFrames.begin() + done);
+    mFrames.emplace_back();
+}
+
+void GLTimer::collect(const std::vector<Interval> &frame) {
+    mTotals.assign(mPhases.size(), 0.0);
+    std::vector<bool> seen(mPhases.size(), false);
+    for (const Interval &interval : frame) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(interval.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(interval.end, GL_QUERY_RESULT, &end);
+        mTotals[interval.phase] += (end - begin) * 1e-6;
+        seen[interval.phase] = true;
+        mFreeQueries.push_back(interval.begin);
+        mFreeQueries.push_back(interval.end);
+    }
+
+    for (size_t i = 0; i < mPhases.size(); ++i) {
+        if (!seen[i])
+            continue;
+        Phase &phase = mPhases[i];
+        phase.history[phase.head] = mTotals[i];
+        phase.head = (phase.head + 1) % phase.history.size();
+        phase.count = std::min(phase.count + 1, phase.history.size());
+    }
+}
+
+GLTimer::Times GLTimer::times(const std::string &name) const {
+    for (const Times &t : times())
+        if (t.name == name)
+            return t;
+    return Times { name, 0.0, 0.0, 0.0 };
+}
+
+std::vector<GLTimer::Times> GLTimer::times() const {
+    std::vector<Times> result;
+    for (const Phase &phase : mPhases) {
+        Times t { phase.name, 0.0, 0.0, 0.0 };
+        if (phase.count > 0) {
+            size_t n = phase.history.size();
+            t.last = phase.history[(phase.head + n - 1) % n];
+            for (size_t i = 0; i < phase.count; ++i) {
+                double value = phase.history[(phase.head + n - 1 - i) % n];
+                t.average += value;
+                t.maximum = std::max(t.maximum, value);
+            }
+            t.average /= phase.count;
+        }
+        result.push_back(t);
+    }
+    return result;
+}
+
+void GLTimer::free() {
+    if (!mAllQueries.empty())
+        glDeleteQueries((GLsizei) mAllQueries.size(), mAllQueries.data());
+    mAllQueries.clear();
+    mFreeQueries.clear();
+    mFrames.clear();
+    for (Phase &phase : mPhases)
+        phase.isOpen = false;
+}
+
+void GLFramebuffer::init(const Vector2i &size, int nSamples) {
+    mSize = mCapacity = size;
     mSamples = nSamples;
 
     glGenRenderbuffers(1, &mColor);
@@ -303,7 +1567,7 @@ void GLFramebuffer::init(const Vector2i &size, int nSamples) {
         glRenderbufferStorageMultisample(GL_RENDERBUFFER, nSamples, GL_DEPTH24_STENCIL8, size.x, size.y);
 
     glGenFramebuffers(1, &mFramebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
 
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
@@ -320,31 +1584,147 @@ void GLFramebuffer::init(const Vector2i &size, int nSamples) {
 }
     
 void GLFramebuffer::free() {
+    GLState::forget(mFramebuffer);
+    glDeleteFramebuffers(1, &mFramebuffer);
     glDeleteRenderbuffers(1, &mColor);
     glDeleteRenderbuffers(1, &mDepth);
+    mFramebuffer = mColor = mDepth = 0;
+}
+
+void GLFramebuffer::resize(const Vector2i &size) {
+    Vector2i capacity(GLRenderTargetPool::sizeClass(size.x),
+                      GLRenderTargetPool::sizeClass(size.y));
+    bool keep = mFramebuffer != 0;
+    for (int i = 0; i < 2; ++i)
+        keep &= size[i] <= mCapacity[i] &&
+                mCapacity[i] <= GLRenderTargetPool::sizeClass(capacity[i] + 1);
+
+    if (!keep) {
+        int samples = std::max(mSamples, 1);
+        free();
+        init(capacity, samples);
+    }
+    mSize = size;
 }
 
 void GLFramebuffer::bind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
     if (mSamples > 1)
-        glEnable(GL_MULTISAMPLE);
+        GLState::enable(GL_MULTISAMPLE);
 }
 
 void GLFramebuffer::release() {
     if (mSamples > 1)
-        glDisable(GL_MULTISAMPLE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::disable(GL_MULTISAMPLE);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void GLFramebuffer::blit() {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     glDrawBuffer(GL_BACK);
 
     glBlitFramebuffer(0, 0, mSize.x, mSize.y, 0, 0, mSize.x, mSize.y,
                       GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GLTexture::init(const Vector2i &size, GLuint internalFormat, GLuint format,
+                     GLuint type, const void *data) {
+    bool resize = mTexture == 0 || size != mSize || internalFormat != mInternalFormat;
+    mFormat = format;
+    mType = type;
+
+    if (!resize) {
+        if (data)
+            update(data);
+        return;
+    }
+
+    if (mTexture == 0)
+        glGenTextures(1, &mTexture);
+    mSize = size;
+    mInternalFormat = internalFormat;
+
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x, size.y, 0,
+                 format, type, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLTexture::update(const Vector2i &offset, const Vector2i &size, const void *data) {
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, offset.x, offset.y, size.x, size.y,
+                    mFormat, mType, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLTexture::setFilter(GLuint minFilter, GLuint magFilter) {
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLTexture::setWrap(GLuint wrap) {
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLTexture::setSwizzle(GLint r, GLint g, GLint b, GLint a) {
+    GLint swizzle[4] = { r, g, b, a };
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLTexture::bind(int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+}
+
+void GLTexture::release(int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (unit != 0)
+        glActiveTexture(GL_TEXTURE0);
+}
+
+void GLTexture::free() {
+    if (mTexture)
+        glDeleteTextures(1, &mTexture);
+    mTexture = 0;
+    mSize = Vector2i(0);
+    mInternalFormat = 0;
+}
+
+size_t GLTexture::pixelSize(GLuint format, GLuint type) {
+    size_t channels;
+    switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: channels = 1; break;
+        case GL_RG: case GL_RG_INTEGER: channels = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: channels = 3; break;
+        default: channels = 4; break;
+    }
+
+    switch (type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return channels;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return 2 * channels;
+        case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_8_8_8_8:
+        case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4;
+        default: return 4 * channels;
+    }
 }
 
 }; /* namespace nanogui */
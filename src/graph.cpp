@@ -12,20 +12,292 @@
 #include <nanogui/graph.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <limits>
+#if defined(NANOGUI_SSE2)
+#include <emmintrin.h>
+#endif
 
 NAMESPACE_BEGIN(nanogui)
 
+/* Number of history slots per block of the streaming envelope */
+static const size_t graphBlockSize = 64;
+
+/* Compute the minimum and maximum of count >= 1 values */
+static void minMax(const float *data, size_t count, float &outMin, float &outMax) {
+    float lo = data[0], hi = data[0];
+    size_t i = 0;
+#if defined(NANOGUI_SSE2)
+    if (count >= 8) {
+        __m128 lo0 = _mm_loadu_ps(data), hi0 = lo0;
+        __m128 lo1 = _mm_loadu_ps(data + 4), hi1 = lo1;
+        for (i = 8; i + 8 <= count; i += 8) {
+            __m128 v0 = _mm_loadu_ps(data + i), v1 = _mm_loadu_ps(data + i + 4);
+            lo0 = _mm_min_ps(lo0, v0); hi0 = _mm_max_ps(hi0, v0);
+            lo1 = _mm_min_ps(lo1, v1); hi1 = _mm_max_ps(hi1, v1);
+        }
+        lo0 = _mm_min_ps(lo0, lo1);
+        hi0 = _mm_max_ps(hi0, hi1);
+        lo0 = _mm_min_ps(lo0, _mm_shuffle_ps(lo0, lo0, _MM_SHUFFLE(2, 3, 0, 1)));
+        hi0 = _mm_max_ps(hi0, _mm_shuffle_ps(hi0, hi0, _MM_SHUFFLE(2, 3, 0, 1)));
+        lo0 = _mm_min_ps(lo0, _mm_shuffle_ps(lo0, lo0, _MM_SHUFFLE(1, 0, 3, 2)));
+        hi0 = _mm_max_ps(hi0, _mm_shuffle_ps(hi0, hi0, _MM_SHUFFLE(1, 0, 3, 2)));
+        lo = _mm_cvtss_f32(lo0);
+        hi = _mm_cvtss_f32(hi0);
+    }
+#endif
+    for (; i < count; ++i) {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+    outMin = lo;
+    outMax = hi;
+}
+
+/* In-place affine remapping: data[i] = (data[i] - offset) * scale */
+static void remap(float *data, size_t count, float offset, float scale) {
+    size_t i = 0;
+#if defined(NANOGUI_SSE2)
+    __m128 o = _mm_set1_ps(offset), s = _mm_set1_ps(scale);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(data + i), o), s));
+#endif
+    for (; i < count; ++i)
+        data[i] = (data[i] - offset) * scale;
+}
+
 Graph::Graph(ref<Widget> parent, const std::string &caption)
-    : Widget(parent), mCaption(caption) {
+    : Widget(parent), mCaption(caption), mEnvelopeColumns(0), mDecimated(false),
+      mRange(0.f, 1.f), mAutoRange(false), mDirty(true), mEnvelopeStride(0),
+      mWindow(0), mHead(0), mFilled(0), mWakeupPending(false) {
     mBackgroundColor = Color(20, 128);
     mForegroundColor = Color(255, 192, 0, 128);
     mTextColor = Color(240, 192);
+    mSeriesColors.push_back(Color(255, 192, 0, 255));
 }
 
 Vector2i Graph::preferredSize(NVGcontext *) const {
     return Vector2i(180, 45);
 }
 
+void Graph::setStreaming(int series, size_t window, size_t capacity) {
+    mRing.reset();
+    mHistory.clear();
+    mIncoming.clear();
+    mBlocks.clear();
+    mWindow = mHead = mFilled = 0;
+    mSeriesColors.resize(1);
+    mDirty = true;
+    if (series <= 0)
+        return;
+    if (window < 2)
+        throw std::runtime_error("Graph::setStreaming(): the window must span at least two samples!");
+
+    static const Color palette[] = {
+        Color(255, 192, 0, 255), Color(80, 180, 255, 255), Color(255, 90, 90, 255),
+        Color(120, 220, 110, 255), Color(210, 130, 255, 255), Color(240, 240, 240, 255)
+    };
+    mSeriesColors.resize(series);
+    for (int i = 0; i < series; ++i)
+        mSeriesColors[i] = palette[i % (sizeof(palette) / sizeof(Color))];
+
+    mRing.reset(new SampleRing(capacity > 0 ? capacity : window, series));
+    mHistory.resize(2 * window * series);
+    mWindow = window;
+    mBlocks.resize(2 * ((window + graphBlockSize - 1) / graphBlockSize) * series);
+}
+
+bool Graph::push(const float *values) {
+    if (!mRing)
+        throw std::runtime_error("Graph::push(): the graph is not in streaming mode!");
+    if (!mRing->push(values))
+        return false;
+    /* Wake up the main loop once per drained batch rather than per sample */
+    if (!mWakeupPending.exchange(true))
+        glfwPostEmptyEvent();
+    return true;
+}
+
+void Graph::drainSamples() {
+    int series = mRing->frameSize();
+    mIncoming.resize(mRing->capacity() * series);
+    mWakeupPending = false;
+    size_t count = mRing->pop(mIncoming.data(), mRing->capacity());
+    if (count == 0)
+        return;
+
+    /* Samples older than the window would be overwritten right away */
+    size_t skip = count > mWindow ? count - mWindow : 0;
+    size_t first = mHead;
+    for (size_t i = skip; i < count; ++i) {
+        const float *frame = &mIncoming[i * series];
+        for (int s = 0; s < series; ++s) {
+            float *history = &mHistory[2 * mWindow * s];
+            history[mHead] = history[mHead + mWindow] = frame[s];
+        }
+        mHead = (mHead + 1) % mWindow;
+    }
+    mFilled = std::min(mFilled + count, mWindow);
+    updateBlocks(first, count - skip);
+    mDirty = true;
+}
+
+void Graph::updateBlocks(size_t first, size_t count) {
+    size_t blocks = (mWindow + graphBlockSize - 1) / graphBlockSize;
+    size_t b0 = first / graphBlockSize, b1 = (first + count - 1) / graphBlockSize + 1;
+    if (count >= mWindow || b1 - b0 >= blocks) {
+        b0 = 0;
+        b1 = blocks;
+    }
+
+    /* Written slots past the end of the ring wrap around to slot 0, whose
+       block does not necessarily follow the last one */
+    size_t wrapped = first + count > mWindow ? (first + count - mWindow - 1) / graphBlockSize + 1 : 0;
+
+    for (int s = 0; s < seriesCount(); ++s) {
+        const float *history = &mHistory[2 * mWindow * s];
+        float *block = &mBlocks[2 * blocks * s];
+        auto update = [&](size_t b) {
+            size_t i0 = b * graphBlockSize, i1 = std::min(i0 + graphBlockSize, mWindow);
+            minMax(history + i0, i1 - i0, block[2 * b], block[2 * b + 1]);
+        };
+        for (size_t b = b0; b < std::min(b1, blocks); ++b)
+            update(b);
+        for (size_t b = 0; b < std::min(wrapped, b0); ++b)
+            update(b);
+    }
+}
+
+void Graph::historyMinMax(int series, size_t begin, size_t end, float &lo, float &hi) const {
+    const float *history = &mHistory[2 * mWindow * series];
+    const float *block = &mBlocks[2 * ((mWindow + graphBlockSize - 1) / graphBlockSize) * series];
+    lo = std::numeric_limits<float>::infinity();
+    hi = -lo;
+
+    auto scan = [&](size_t i0, size_t i1) {
+        if (i1 <= i0)
+            return;
+        float l, h;
+        minMax(history + i0, i1 - i0, l, h);
+        lo = std::min(lo, l);
+        hi = std::max(hi, h);
+    };
+
+    /* Whole blocks within [i0, i1) are looked up, the partial ones at the edges scanned */
+    auto segment = [&](size_t i0, size_t i1) {
+        size_t b0 = (i0 + graphBlockSize - 1) / graphBlockSize, b1 = i1 / graphBlockSize;
+        if (b0 >= b1) {
+            scan(i0, i1);
+            return;
+        }
+        scan(i0, b0 * graphBlockSize);
+        for (size_t b = b0; b < b1; ++b) {
+            lo = std::min(lo, block[2 * b]);
+            hi = std::max(hi, block[2 * b + 1]);
+        }
+        scan(b1 * graphBlockSize, i1);
+    };
+
+    if (end <= mWindow) {
+        segment(begin, end);
+    } else if (begin >= mWindow) {
+        segment(begin - mWindow, end - mWindow);
+    } else {
+        segment(begin, mWindow);
+        segment(0, end - mWindow);
+    }
+}
+
+const float *Graph::seriesData(int series, size_t &count) const {
+    if (!mRing) {
+        count = mValues.size();
+        return mValues.data();
+    }
+    count = mFilled;
+    size_t start = (mHead + mWindow - mFilled) % mWindow;
+    return &mHistory[2 * mWindow * series + start];
+}
+
+void Graph::updateEnvelope(int columns) {
+    int series = seriesCount();
+    size_t count;
+    seriesData(0, count);
+    mDecimated = count > 2 * (size_t) columns;
+    mEnvelopeStride = mDecimated ? 2 * columns : count;
+    mEnvelope.resize(mEnvelopeStride * series);
+
+    for (int s = 0; s < series; ++s) {
+        const float *values = seriesData(s, count);
+        float *envelope = &mEnvelope[mEnvelopeStride * s];
+        if (mDecimated) {
+            /* Pixel column c covers the samples [c*count/columns, (c+1)*count/columns) */
+            size_t start = mRing ? (mHead + mWindow - mFilled) % mWindow : 0;
+            for (int c = 0; c < columns; ++c) {
+                size_t i0 = (size_t) c * count / columns;
+                size_t i1 = (size_t) (c + 1) * count / columns;
+                if (mRing)
+                    historyMinMax(s, start + i0, start + i1, envelope[2 * c], envelope[2 * c + 1]);
+                else
+                    minMax(values + i0, i1 - i0, envelope[2 * c], envelope[2 * c + 1]);
+            }
+        } else {
+            std::copy(values, values + count, envelope);
+        }
+    }
+
+    /* All series share the vertical axis */
+    minMax(mEnvelope.data(), mEnvelope.size(), mRange.x, mRange.y);
+
+    if (mAutoRange) {
+        float extent = mRange.y - mRange.x;
+        remap(mEnvelope.data(), mEnvelope.size(), mRange.x,
+              extent > 0 ? 1.f / extent : 0.f);
+    }
+
+    mEnvelopeColumns = columns;
+    mDirty = false;
+}
+
+void Graph::tracePath(NVGcontext *ctx, int series, bool closed) {
+    const float *envelope = &mEnvelope[mEnvelopeStride * series];
+    bool first = !closed;
+    auto point = [&](float x, float y) {
+        if (first)
+            nvgMoveTo(ctx, x, y);
+        else
+            nvgLineTo(ctx, x, y);
+        first = false;
+    };
+
+    if (closed)
+        nvgMoveTo(ctx, mPos.x, mPos.y + mSize.y);
+
+    if (mDecimated) {
+        /* Emit each column's extrema in the order closest to the previous
+           point, which keeps the outline from crossing itself */
+        int columns = (int) mEnvelopeStride / 2;
+        float prev = envelope[0];
+        for (int c = 0; c < columns; c++) {
+            float lo = envelope[2 * c], hi = envelope[2 * c + 1];
+            if (std::abs(prev - hi) < std::abs(prev - lo))
+                std::swap(lo, hi);
+            float vx = mPos.x + c * mSize.x / (float) (columns - 1);
+            point(vx, mPos.y + (1 - lo) * mSize.y);
+            point(vx, mPos.y + (1 - hi) * mSize.y);
+            prev = hi;
+        }
+    } else {
+        for (size_t i = 0; i < mEnvelopeStride; i++) {
+            float value = envelope[i];
+            float vx = mPos.x + i * mSize.x / (float) (mEnvelopeStride - 1);
+            float vy = mPos.y + (1-value) * mSize.y;
+            point(vx, vy);
+        }
+    }
+
+    if (closed)
+        nvgLineTo(ctx, mPos.x + mSize.x, mPos.y + mSize.y);
+}
+
 void Graph::draw(NVGcontext *ctx) {
     Widget::draw(ctx);
 
@@ -34,23 +306,33 @@ void Graph::draw(NVGcontext *ctx) {
     nvgFillColor(ctx, mBackgroundColor);
     nvgFill(ctx);
 
-    if (mValues.size() < 2)
+    if (mRing)
+        drainSamples();
+
+    size_t count;
+    seriesData(0, count);
+    if (count < 2)
         return;
 
-    nvgBeginPath(ctx);
-    nvgMoveTo(ctx, mPos.x, mPos.y+mSize.y);
-    for (size_t i = 0; i < (size_t) mValues.size(); i++) {
-        float value = mValues[i];
-        float vx = mPos.x + i * mSize.x / (float) (mValues.size() - 1);
-        float vy = mPos.y + (1-value) * mSize.y;
-        nvgLineTo(ctx, vx, vy);
-    }
+    int columns = std::max(mSize.x, 2);
+    if (mDirty || columns != mEnvelopeColumns)
+        updateEnvelope(columns);
 
-    nvgLineTo(ctx, mPos.x + mSize.x, mPos.y + mSize.y);
-    nvgStrokeColor(ctx, Color(100, 255));
-    nvgStroke(ctx);
-    nvgFillColor(ctx, mForegroundColor);
-    nvgFill(ctx);
+    if (seriesCount() == 1) {
+        nvgBeginPath(ctx);
+        tracePath(ctx, 0, true);
+        nvgStrokeColor(ctx, Color(100, 255));
+        nvgStroke(ctx);
+        nvgFillColor(ctx, mForegroundColor);
+        nvgFill(ctx);
+    } else {
+        for (int s = 0; s < seriesCount(); ++s) {
+            nvgBeginPath(ctx);
+            tracePath(ctx, s, false);
+            nvgStrokeColor(ctx, mSeriesColors[s]);
+            nvgStroke(ctx);
+        }
+    }
 
     nvgFontFace(ctx, "sans");
 
@@ -0,0 +1,356 @@
+/*
+    src/histogram.cpp -- Histogram widget with parallel binning of
+    large data sets
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/histogram.h>
+#include <nanogui/opengl.h>
+#include <cmath>
+#include <limits>
+#if defined(NANOGUI_SSE2)
+#include <emmintrin.h>
+#endif
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Number of threads used to process 'count' values; small inputs are processed serially */
+static int threadCount(size_t count) {
+    return count < (1 << 20) ? 1 : (int) std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Split [0, count) into 'threads' contiguous chunks and call f(begin, end, chunk)
+   for each; the calling thread processes the first chunk */
+template <typename Func> static void parallelChunks(size_t count, int threads, const Func &f) {
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back(f, count * t / threads, count * (t + 1) / threads, t);
+    f((size_t) 0, count / threads, 0);
+    for (auto &w : workers)
+        w.join();
+}
+
+/* Minimum and maximum of the non-NaN values in [begin, end) */
+static void minMaxRange(const float *data, size_t begin, size_t end, float &outMin, float &outMax) {
+    float lo = std::numeric_limits<float>::infinity(), hi = -lo;
+    size_t i = begin;
+#if defined(NANOGUI_SSE2)
+    /* NaN operands make minps/maxps return the second operand, i.e. the accumulator */
+    __m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+    for (; i + 4 <= end; i += 4) {
+        __m128 v = _mm_loadu_ps(data + i);
+        vlo = _mm_min_ps(v, vlo);
+        vhi = _mm_max_ps(v, vhi);
+    }
+    float l[4], h[4];
+    _mm_storeu_ps(l, vlo);
+    _mm_storeu_ps(h, vhi);
+    for (int j = 0; j < 4; ++j) {
+        lo = std::min(lo, l[j]);
+        hi = std::max(hi, h[j]);
+    }
+#endif
+    for (; i < end; ++i) {
+        if (data[i] < lo) lo = data[i];
+        if (data[i] > hi) hi = data[i];
+    }
+    outMin = lo;
+    outMax = hi;
+}
+
+/* Add the values in [begin, end) to 'counts'. Four interleaved sub-histograms
+   avoid stalls when consecutive values fall into the same bin. */
+static void binRange(const float *data, size_t begin, size_t end, float lo, float hi,
+                     uint32_t bins, uint64_t *counts) {
+    std::vector<uint32_t> sub(4 * (size_t) bins, 0);
+    float scale = bins / (hi - lo);
+
+    /* Flush the 32-bit sub-histograms before they can overflow */
+    const size_t block = (size_t) 1 << 30;
+    for (size_t b0 = begin; b0 < end; b0 += block) {
+        size_t b1 = std::min(end, b0 + block), i = b0;
+#if defined(NANOGUI_SSE2)
+        __m128 vlo = _mm_set1_ps(lo), vscale = _mm_set1_ps(scale);
+        int32_t idx[4];
+        for (; i + 4 <= b1; i += 4) {
+            __m128 v = _mm_loadu_ps(data + i);
+            __m128i k = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(v, vlo), vscale));
+            /* Values below 'lo' (which truncate towards bin 0) become -1 */
+            k = _mm_or_si128(k, _mm_castps_si128(_mm_cmplt_ps(v, vlo)));
+            _mm_storeu_si128((__m128i *) idx, k);
+            for (int j = 0; j < 4; ++j) {
+                uint32_t u = (uint32_t) idx[j];
+                if (u < bins) {
+                    sub[j * bins + u]++;
+                } else {
+                    /* 'hi' itself, or a value just below it that rounds up to 'bins' */
+                    float v = data[i + j];
+                    if (v >= lo && v <= hi)
+                        sub[j * bins + bins - 1]++;
+                }
+            }
+        }
+#endif
+        for (; i < b1; ++i) {
+            float v = data[i];
+            if (v >= lo && v <= hi)
+                sub[(i & 3) * bins + std::min((uint32_t) ((v - lo) * scale), bins - 1)]++;
+        }
+        for (uint32_t k = 0; k < bins; ++k) {
+            counts[k] += (uint64_t) sub[k] + sub[bins + k] + sub[2 * bins + k] + sub[3 * bins + k];
+            sub[k] = sub[bins + k] = sub[2 * bins + k] = sub[3 * bins + k] = 0;
+        }
+    }
+}
+
+/* Parallel binning with per-thread bins that are merged at the end */
+static void binParallel(const float *data, size_t count, const Vector2f &range,
+                        std::vector<uint64_t> &counts) {
+    uint32_t bins = (uint32_t) counts.size();
+    int threads = threadCount(count);
+    std::vector<std::vector<uint64_t>> local(threads, std::vector<uint64_t>(bins, 0));
+    parallelChunks(count, threads, [&](size_t begin, size_t end, int t) {
+        binRange(data, begin, end, range.x, range.y, bins, local[t].data());
+    });
+    for (auto const &l : local)
+        for (uint32_t k = 0; k < bins; ++k)
+            counts[k] += l[k];
+}
+
+static void minMaxParallel(const float *data, size_t count, float &lo, float &hi) {
+    int threads = threadCount(count);
+    std::vector<Vector2f> local(threads);
+    parallelChunks(count, threads, [&](size_t begin, size_t end, int t) {
+        minMaxRange(data, begin, end, local[t].x, local[t].y);
+    });
+    lo = std::numeric_limits<float>::infinity();
+    hi = -lo;
+    for (auto const &l : local) {
+        lo = std::min(lo, l.x);
+        hi = std::max(hi, l.y);
+    }
+}
+
+Histogram::Histogram(ref<Widget> parent, const std::string &caption, int bins)
+    : Widget(parent), mCaption(caption), mLogScale(false), mBinCount(bins),
+      mAutoRange(true), mRange(0.f, 1.f), mFixedRange(0.f, 1.f), mTotal(0),
+      mOutliers(0), mStop(false), mResultReady(false), mResultTotal(0),
+      mResultOutliers(0), mPendingJobs(0), mWorkerRange(0.f, 1.f) {
+    if (bins < 1)
+        throw std::runtime_error("Histogram: the bin count must be positive!");
+    mBackgroundColor = Color(20, 128);
+    mForegroundColor = Color(255, 192, 0, 128);
+    mTextColor = Color(240, 192);
+    mCounts.assign(bins, 0);
+    mWorker = std::thread([this]() { worker(); });
+}
+
+Histogram::~Histogram() {
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mStop = true;
+    }
+    mCondition.notify_one();
+    mWorker.join();
+}
+
+void Histogram::setValues(std::vector<float> values) {
+    submit(Job::Reset, std::move(values));
+}
+
+void Histogram::appendValues(const float *values, size_t count) {
+    submit(Job::Append, std::vector<float>(values, values + count));
+}
+
+void Histogram::setBinCount(int bins) {
+    if (bins < 1)
+        throw std::runtime_error("Histogram::setBinCount(): the bin count must be positive!");
+    mBinCount = bins;
+    submit(Job::Rebin);
+}
+
+void Histogram::setRange(const Vector2f &range) {
+    if (!(range.y > range.x))
+        throw std::runtime_error("Histogram::setRange(): invalid range!");
+    mFixedRange = range;
+    mAutoRange = false;
+    submit(Job::Rebin);
+}
+
+void Histogram::setAutoRange() {
+    mAutoRange = true;
+    submit(Job::Rebin);
+}
+
+void Histogram::submit(Job::Type type, std::vector<float> values) {
+    Job job;
+    job.type = type;
+    job.values = std::move(values);
+    job.bins = mBinCount;
+    job.range = mFixedRange;
+    job.autoRange = mAutoRange;
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mJobs.push_back(std::move(job));
+        mPendingJobs++;
+    }
+    mCondition.notify_one();
+}
+
+void Histogram::worker() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [&]() { return mStop || !mJobs.empty(); });
+            if (mStop)
+                return;
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+
+        switch (job.type) {
+            case Job::Reset:
+                mValues = std::move(job.values);
+                binAll(job);
+                break;
+
+            case Job::Rebin:
+                binAll(job);
+                break;
+
+            case Job::Append: {
+                    size_t offset = mValues.size();
+                    mValues.insert(mValues.end(), job.values.begin(), job.values.end());
+
+                    bool rebin = mWorkerCounts.size() != (size_t) job.bins || offset == 0;
+                    if (job.autoRange && !rebin) {
+                        float lo, hi;
+                        minMaxParallel(job.values.data(), job.values.size(), lo, hi);
+                        rebin = lo < mWorkerRange.x || hi > mWorkerRange.y;
+                    } else if (!job.autoRange) {
+                        rebin |= mWorkerRange != job.range;
+                    }
+
+                    if (rebin)
+                        binAll(job);
+                    else
+                        binParallel(mValues.data() + offset, job.values.size(),
+                                    mWorkerRange, mWorkerCounts);
+                }
+                break;
+        }
+
+        uint64_t binned = 0;
+        for (uint64_t c : mWorkerCounts)
+            binned += c;
+
+        {
+            std::lock_guard<std::mutex> guard(mMutex);
+            mResultCounts = mWorkerCounts;
+            mResultRange = mWorkerRange;
+            mResultTotal = mValues.size();
+            mResultOutliers = mValues.size() - binned;
+            mResultReady = true;
+        }
+        mPendingJobs--;
+        glfwPostEmptyEvent();
+    }
+}
+
+void Histogram::binAll(const Job &job) {
+    if (job.autoRange) {
+        float lo, hi;
+        minMaxParallel(mValues.data(), mValues.size(), lo, hi);
+        if (!(lo <= hi))
+            lo = 0.f, hi = 1.f;
+        else if (lo == hi)
+            lo -= 0.5f, hi += 0.5f;
+        mWorkerRange = Vector2f(lo, hi);
+    } else {
+        mWorkerRange = job.range;
+    }
+    mWorkerCounts.assign(job.bins, 0);
+    binParallel(mValues.data(), mValues.size(), mWorkerRange, mWorkerCounts);
+}
+
+void Histogram::fetchResult() {
+    std::lock_guard<std::mutex> guard(mMutex);
+    if (!mResultReady)
+        return;
+    mCounts.swap(mResultCounts);
+    mRange = mResultRange;
+    mTotal = mResultTotal;
+    mOutliers = mResultOutliers;
+    mResultReady = false;
+}
+
+Vector2i Histogram::preferredSize(NVGcontext *) {
+    return Vector2i(180, 80);
+}
+
+void Histogram::draw(NVGcontext *ctx) {
+    Widget::draw(ctx);
+    fetchResult();
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillColor(ctx, mBackgroundColor);
+    nvgFill(ctx);
+
+    uint64_t maxCount = 0;
+    for (uint64_t c : mCounts)
+        maxCount = std::max(maxCount, c);
+
+    if (maxCount > 0) {
+        /* All bars form a single path with one fill */
+        float barWidth = mSize.x / (float) mCounts.size();
+        float gap = barWidth > 3 ? 1.f : 0.f;
+        float norm = mLogScale ? 1.f / std::log1p((float) maxCount) : 1.f / maxCount;
+        nvgBeginPath(ctx);
+        for (size_t i = 0; i < mCounts.size(); ++i) {
+            if (mCounts[i] == 0)
+                continue;
+            float h = (mLogScale ? std::log1p((float) mCounts[i]) : (float) mCounts[i]) * norm * mSize.y;
+            nvgRect(ctx, mPos.x + i * barWidth, mPos.y + mSize.y - h, barWidth - gap, h);
+        }
+        nvgFillColor(ctx, mForegroundColor);
+        nvgFill(ctx);
+    }
+
+    nvgFontFace(ctx, "sans");
+    nvgFillColor(ctx, mTextColor);
+
+    if (!mCaption.empty()) {
+        nvgFontSize(ctx, 14.0f);
+        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+        nvgText(ctx, mPos.x + 3, mPos.y + 1, mCaption.c_str(), NULL);
+    }
+
+    char buf[64];
+    nvgFontSize(ctx, 13.0f);
+    snprintf(buf, sizeof(buf), "%llu%s", (unsigned long long) mTotal, busy() ? " .." : "");
+    nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+    nvgText(ctx, mPos.x + mSize.x - 3, mPos.y + 1, buf, NULL);
+
+    snprintf(buf, sizeof(buf), "%g", mRange.x);
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
+    nvgText(ctx, mPos.x + 3, mPos.y + mSize.y - 1, buf, NULL);
+
+    snprintf(buf, sizeof(buf), "%g", mRange.y);
+    nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
+    nvgText(ctx, mPos.x + mSize.x - 3, mPos.y + mSize.y - 1, buf, NULL);
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgStrokeColor(ctx, Color(100, 255));
+    nvgStroke(ctx);
+}
+
+NAMESPACE_END(nanogui)
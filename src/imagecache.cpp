@@ -0,0 +1,174 @@
+/*
+    src/imagecache.cpp -- Per-context cache of NanoVG images with
+    memory accounting and LRU eviction
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/imagecache.h>
+#include <nanogui/opengl.h>
+#include <map>
+
+NAMESPACE_BEGIN(nanogui)
+
+static std::map<NVGcontext *, ImageCache *> __nanogui_image_caches;
+
+ImageCache *ImageCache::get(NVGcontext *ctx, bool create) {
+    auto it = __nanogui_image_caches.find(ctx);
+    if (it != __nanogui_image_caches.end())
+        return it->second;
+    if (!create)
+        return nullptr;
+    ImageCache *cache = new ImageCache(ctx);
+    __nanogui_image_caches[ctx] = cache;
+    return cache;
+}
+
+void ImageCache::release(NVGcontext *ctx) {
+    auto it = __nanogui_image_caches.find(ctx);
+    if (it == __nanogui_image_caches.end())
+        return;
+    delete it->second;
+    __nanogui_image_caches.erase(it);
+}
+
+ImageCache::~ImageCache() {
+    for (auto &kv : mEntries)
+        if (kv.second.image)
+            nvgDeleteImage(mContext, kv.second.image);
+}
+
+int ImageCache::image(const std::string &key, const Loader &loader) {
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+        return loader ? create(key, loader, 0) : 0;
+
+    Entry &entry = it->second;
+    if (!entry.image) {
+        if (!load(entry))
+            return 0;
+        evict();
+    }
+    touch(entry);
+    return entry.image;
+}
+
+int ImageCache::imageFromFile(const std::string &filename, int imageFlags) {
+    if (contains(filename))
+        return image(filename);
+    return create(filename, [filename, imageFlags](NVGcontext *ctx) {
+        return nvgCreateImage(ctx, filename.c_str(), imageFlags);
+    }, imageFlags);
+}
+
+int ImageCache::imageFromMemory(const std::string &key, const uint8_t *data,
+                                uint32_t size, int imageFlags) {
+    if (contains(key))
+        return image(key);
+    return create(key, [data, size, imageFlags](NVGcontext *ctx) {
+        return nvgCreateImageMem(ctx, imageFlags, (unsigned char *) data, (int) size);
+    }, imageFlags);
+}
+
+int ImageCache::create(const std::string &key, const Loader &loader, int imageFlags) {
+    Entry &entry = mEntries[key];
+    entry.flags = imageFlags;
+    entry.loader = loader;
+    entry.lru = mLRU.insert(mLRU.begin(), key);
+    if (!load(entry)) {
+        remove(key);
+        return 0;
+    }
+    int id = entry.image;
+    evict();
+    return id;
+}
+
+void ImageCache::insert(const std::string &key, int image, const Loader &loader) {
+    remove(key);
+    Entry &entry = mEntries[key];
+    entry.image = image;
+    entry.loader = loader;
+    entry.bytes = imageBytes(image, 0);
+    entry.lru = mLRU.insert(mLRU.begin(), key);
+    entry.lastUsed = mFrame;
+    mUsage += entry.bytes;
+    mLoaded++;
+    evict();
+}
+
+void ImageCache::remove(const std::string &key) {
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+        return;
+    unload(it->second);
+    mLRU.erase(it->second.lru);
+    mEntries.erase(it);
+}
+
+void ImageCache::setPinned(const std::string &key, bool pinned) {
+    auto it = mEntries.find(key);
+    if (it != mEntries.end())
+        it->second.pinned = pinned;
+}
+
+bool ImageCache::load(Entry &entry) {
+    if (!entry.loader)
+        return false;
+    entry.image = entry.loader(mContext);
+    if (!entry.image)
+        return false;
+    entry.bytes = imageBytes(entry.image, entry.flags);
+    mUsage += entry.bytes;
+    mLoaded++;
+    mLoads++;
+    touch(entry);
+    return true;
+}
+
+void ImageCache::unload(Entry &entry) {
+    if (!entry.image)
+        return;
+    nvgDeleteImage(mContext, entry.image);
+    entry.image = 0;
+    mUsage -= entry.bytes;
+    mLoaded--;
+    entry.bytes = 0;
+}
+
+void ImageCache::touch(Entry &entry) {
+    entry.lastUsed = mFrame;
+    mLRU.splice(mLRU.begin(), mLRU, entry.lru);
+}
+
+void ImageCache::evict() {
+    if (mBudget == 0 || mUsage <= mBudget)
+        return;
+
+    for (auto it = mLRU.rbegin(); it != mLRU.rend() && mUsage > mBudget; ++it) {
+        Entry &entry = mEntries.find(*it)->second;
+        /* Images drawn during this frame may still be referenced by
+           queued NanoVG commands, so they have to stay resident */
+        if (!entry.image || entry.pinned || !entry.loader ||
+            entry.lastUsed == mFrame)
+            continue;
+        unload(entry);
+        mEvictions++;
+    }
+}
+
+size_t ImageCache::imageBytes(int image, int imageFlags) const {
+    int w = 0, h = 0;
+    nvgImageSize(mContext, image, &w, &h);
+    size_t bytes = (size_t) w * (size_t) h * 4;
+    if (imageFlags & NVG_IMAGE_GENERATE_MIPMAPS)
+        bytes += bytes / 3;
+    return bytes;
+}
+
+NAMESPACE_END(nanogui)
@@ -12,13 +12,133 @@
 
 #include <nanogui/imageview.h>
 #include <nanogui/opengl.h>
+#include <nanogui/screen.h>
+#include <cmath>
 
 NAMESPACE_BEGIN(nanogui)
 
+extern std::map<GLFWwindow *, Screen *> __nanogui_screens;
+
+static const char *toneMapFragmentShader =
+    "#version 330\n"
+    "uniform sampler2D source;\n"
+    "uniform float scale;\n"
+    "uniform float invGamma;\n"
+    "uniform int falseColor;\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "\n"
+    "/* Polynomial fit of the 'Turbo' colormap */\n"
+    "vec3 turbo(float x) {\n"
+    "    const vec4 kR4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);\n"
+    "    const vec4 kG4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);\n"
+    "    const vec4 kB4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);\n"
+    "    const vec2 kR2 = vec2(-152.94239396, 59.28637943);\n"
+    "    const vec2 kG2 = vec2(4.27729857, 2.82956604);\n"
+    "    const vec2 kB2 = vec2(-89.90310912, 27.34824973);\n"
+    "    x = clamp(x, 0.0, 1.0);\n"
+    "    vec4 v4 = vec4(1.0, x, x * x, x * x * x);\n"
+    "    vec2 v2 = v4.zw * v4.z;\n"
+    "    return vec3(dot(v4, kR4) + dot(v2, kR2),\n"
+    "                dot(v4, kG4) + dot(v2, kG2),\n"
+    "                dot(v4, kB4) + dot(v2, kB2));\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "    vec4 value = texture(source, uv);\n"
+    "    vec3 c = max(value.rgb * scale, vec3(0.0));\n"
+    "    if (falseColor != 0)\n"
+    "        c = turbo(dot(c, vec3(0.2126, 0.7152, 0.0722)));\n"
+    "    else\n"
+    "        c = pow(c, vec3(invGamma));\n"
+    "    color = vec4(clamp(c, 0.0, 1.0), clamp(value.a, 0.0, 1.0));\n"
+    "}";
+
 ImageView::ImageView(ref<Widget> parent, int img, SizePolicy policy)
-    : Widget(parent), mImage(img), mPolicy(policy) {}
+    : Widget(parent), mImage(img), mPolicy(policy), mContext(nullptr),
+      mExposure(0.f), mGamma(2.2f), mFalseColor(false), mDirty(false) {}
+
+ImageView::~ImageView() {
+    if (!mOffscreen.releaseIfAlive(mContext))
+        return;
+    freeImageData();
+    mToneMapShader.free();
+}
+
+void ImageView::setImageData(const uint8_t *data, const Vector2i &size,
+                             int channels, GLuint glType) {
+    static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum formats8[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    static const GLenum formats16f[4] = { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+    static const GLenum formats32f[4] = { GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+    static const GLint swizzles[4][4] = {
+        { GL_RED, GL_RED, GL_RED, GL_ONE },
+        { GL_RED, GL_RED, GL_RED, GL_GREEN },
+        { GL_RED, GL_GREEN, GL_BLUE, GL_ONE },
+        { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }
+    };
+
+    if (channels < 1 || channels > 4)
+        throw std::runtime_error("ImageView::setImageData(): invalid channel count!");
+
+    GLenum internalFormat;
+    switch (glType) {
+        case GL_UNSIGNED_BYTE: internalFormat = formats8[channels - 1]; break;
+        case GL_HALF_FLOAT: internalFormat = formats16f[channels - 1]; break;
+        case GL_FLOAT: internalFormat = formats32f[channels - 1]; break;
+        default:
+            throw std::runtime_error("ImageView::setImageData(): unsupported pixel type!");
+    }
+
+    /* Remember the context that owns the texture (see the destructor) */
+    auto it = __nanogui_screens.find(glfwGetCurrentContext());
+    if (it != __nanogui_screens.end())
+        mContext = it->second->nvgContext();
+
+    /* The texture storage is only reallocated when the size changes */
+    mSourceTexture.init(size, internalFormat, formats[channels - 1], glType, data);
+    mSourceTexture.setFilter(GL_NEAREST, GL_NEAREST);
+    mSourceTexture.setSwizzle(swizzles[channels - 1][0], swizzles[channels - 1][1],
+                              swizzles[channels - 1][2], swizzles[channels - 1][3]);
+
+    mImage = 0;
+    mDirty = true;
+}
+
+void ImageView::freeImageData() {
+    mOffscreen.release();
+    mSourceTexture.free();
+}
+
+int ImageView::toneMappedImage(NVGcontext *ctx) {
+    mContext = ctx;
+    if (mOffscreen.prepare(ctx, mSourceTexture.size()))
+        mDirty = true;
+    if (!mDirty)
+        return mOffscreen.image();
+
+    if (mToneMapShader.name().empty())
+        mToneMapShader.init("imageview_tonemap", GLOffscreenTarget::fullscreenVertexShader(),
+                            toneMapFragmentShader);
+
+    mOffscreen.begin();
+    mToneMapShader.bind();
+    mSourceTexture.bind(0);
+    mToneMapShader.setUniform("source", 0);
+    mToneMapShader.setUniform("scale", std::pow(2.f, mExposure));
+    mToneMapShader.setUniform("invGamma", 1.f / mGamma);
+    mToneMapShader.setUniform("falseColor", mFalseColor ? 1 : 0);
+    GLOffscreenTarget::drawFullscreen(mToneMapShader);
+    mSourceTexture.release(0);
+    mOffscreen.end();
+
+    mDirty = false;
+    return mOffscreen.image();
+}
 
 Vector2i ImageView::preferredSize(NVGcontext *ctx) {
+    if (mSourceTexture.ready())
+        return mSourceTexture.size();
     if (!mImage)
         return Vector2i(0, 0);
     int w,h;
@@ -27,13 +147,21 @@ Vector2i ImageView::preferredSize(NVGcontext *ctx) {
 }
 
 void ImageView::draw(NVGcontext* ctx) {
-    if (!mImage)
+    bool hdr = mSourceTexture.ready();
+    int image = hdr ? toneMappedImage(ctx) : mImage;
+    if (!image)
         return;
     Vector2i p = mPos;
     Vector2i s = Widget::size();
 
+    /* The tone mapped image may only cover part of its pooled texture */
     int w, h;
-    nvgImageSize(ctx, mImage, &w, &h);
+    if (hdr) {
+        w = mSourceTexture.size().x;
+        h = mSourceTexture.size().y;
+    } else {
+        nvgImageSize(ctx, image, &w, &h);
+    }
 
     if (mPolicy == SizePolicy::Fixed) {
         if (s.x < w) {
@@ -57,7 +185,8 @@ void ImageView::draw(NVGcontext* ctx) {
         }
     }
 
-    NVGpaint imgPaint = nvgImagePattern(ctx, p.x, p.y, w, h, 0, mImage, 1.0);
+    NVGpaint imgPaint = hdr ? mOffscreen.paint(ctx, p.x, p.y, w, h)
+                            : nvgImagePattern(ctx, p.x, p.y, w, h, 0, image, 1.0);
 
     nvgBeginPath(ctx);
     nvgRect(ctx, p.x, p.y, w, h);
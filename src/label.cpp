@@ -33,7 +33,17 @@ Vector2i Label::preferredSize(NVGcontext *ctx) {
         return Vector2i(mFixedSize.x, bounds[3]-bounds[1]);
     } else {
         nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
-        return Vector2i(nvgTextBounds(ctx, 0, 0, mCaption.c_str(), nullptr, nullptr), mTheme->mStandardFontSize);
+        float width = nvgTextBounds(ctx, 0, 0, mCaption.c_str(), nullptr, nullptr);
+
+        /* Wrap to the available width if the caption does not fit */
+        const LayoutConstraints &constraints = measureConstraints();
+        if (constraints.bounded(0) && width > constraints.max.x) {
+            float bounds[4];
+            nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+            nvgTextBoxBounds(ctx, 0, 0, constraints.max.x, mCaption.c_str(), nullptr, bounds);
+            return Vector2i(constraints.max.x, bounds[3]-bounds[1]);
+        }
+        return Vector2i(width, mTheme->mStandardFontSize);
     }
 }
 
@@ -42,11 +52,14 @@ void Label::draw(NVGcontext *ctx) {
     nvgFontSize(ctx, fontSize());
     nvgFontFace(ctx, mFont.c_str());
     nvgFillColor(ctx, mColor);
-    if (mFixedSize.x > 0) {
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
+    int wrapWidth = mFixedSize.x;
+    if (wrapWidth <= 0 && nvgTextBounds(ctx, 0, 0, mCaption.c_str(), nullptr, nullptr) > mSize.x)
+        wrapWidth = mSize.x; /* Wrapped by preferredSize() */
+    if (wrapWidth > 0) {
         nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-        nvgTextBox(ctx, mPos.x, mPos.y, mFixedSize.x, mCaption.c_str(), nullptr);
+        nvgTextBox(ctx, mPos.x, mPos.y, wrapWidth, mCaption.c_str(), nullptr);
     } else {
-        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
         nvgText(ctx, mPos.x, mPos.y + mSize.y * 0.5f, mCaption.c_str(), nullptr);
     }
 }
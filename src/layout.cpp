@@ -21,40 +21,114 @@
 
 NAMESPACE_BEGIN(nanogui)
 
+static int __nanogui_layout_pass_depth = 0;
+static uint64_t __nanogui_layout_pass_id = 0;
+
+constexpr int LayoutConstraints::Unbounded;
+
+LayoutPass::LayoutPass() {
+	if (__nanogui_layout_pass_depth++ == 0)
+		__nanogui_layout_pass_id++;
+}
+
+LayoutPass::~LayoutPass() {
+	__nanogui_layout_pass_depth--;
+}
+
+uint64_t LayoutPass::current() {
+	return __nanogui_layout_pass_depth > 0 ? __nanogui_layout_pass_id : 0;
+}
+
+/* Layout and widget for which a default method of the measure/preferredSize
+   (or arrange/performLayout) pair is forwarding to the other one. Reaching
+   the other default for the same pair means that neither is overridden. */
+struct LayoutForward {
+	const Layout *layout = nullptr;
+	const Widget *widget = nullptr;
+};
+
+static LayoutForward __nanogui_layout_measure_forward, __nanogui_layout_arrange_forward;
+
+class LayoutForwardScope {
+public:
+	LayoutForwardScope(LayoutForward &forward, const Layout *layout, const Widget *widget,
+					   const char *pair)
+		: mForward(forward), mPrevious(forward) {
+		if (forward.layout == layout && forward.widget == widget)
+			throw std::runtime_error(std::string("Layout: one of ") + pair +
+									 " must be overridden!");
+		forward.layout = layout;
+		forward.widget = widget;
+	}
+
+	~LayoutForwardScope() { mForward = mPrevious; }
+
+private:
+	LayoutForward &mForward;
+	LayoutForward mPrevious;
+};
+
+Vector2i Layout::measure(NVGcontext *ctx, ref<Widget> widget,
+						 const LayoutConstraints &) const {
+	LayoutForwardScope scope(__nanogui_layout_measure_forward, this, widget.get(),
+							 "measure() and preferredSize()");
+	return preferredSize(ctx, widget);
+}
+
+Vector2i Layout::preferredSize(NVGcontext *ctx, ref<Widget> widget) const {
+	LayoutForwardScope scope(__nanogui_layout_measure_forward, this, widget.get(),
+							 "measure() and preferredSize()");
+	return measure(ctx, widget, widget->measureConstraints());
+}
+
+void Layout::arrange(NVGcontext *ctx, ref<Widget> widget) const {
+	LayoutForwardScope scope(__nanogui_layout_arrange_forward, this, widget.get(),
+							 "arrange() and performLayout()");
+	performLayout(ctx, widget);
+}
+
+void Layout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
+	LayoutForwardScope scope(__nanogui_layout_arrange_forward, this, widget.get(),
+							 "arrange() and performLayout()");
+	arrange(ctx, widget);
+}
+
 BoxLayout::BoxLayout(Orientation orientation, Alignment alignment,
 					 int margin, int spacing)
 		: mOrientation(orientation), mAlignment(alignment), mMargin(margin),
 		  mSpacing(spacing) {
 }
 
-Vector2i BoxLayout::preferredSize(NVGcontext *ctx, const ref<Widget> widget) const {
+Vector2i BoxLayout::measure(NVGcontext *ctx, const ref<Widget> widget,
+							const LayoutConstraints &constraints) const {
 	Vector2i size = Vector2i(2 * mMargin);
 
 	if (dynamic_pointer_cast<const Window>(widget))
 		size[1] += widget->theme()->mWindowHeaderHeight;
 
-	bool first = true;
+	/* Children are only constrained across the box */
 	int axis1 = (int) mOrientation, axis2 = ((int) mOrientation + 1) % 2;
+	LayoutConstraints childConstraints;
+	if (constraints.bounded(axis2))
+		childConstraints.setMax(axis2, constraints.max[axis2] - 2 * mMargin);
+
+	bool first = true;
 	for (auto w : widget->children()) {
 		if (first)
 			first = false;
 		else
 			size[axis1] += mSpacing;
 
-		Vector2i ps = w->preferredSize(ctx);
-		Vector2i fs = w->fixedSize();
-		Vector2i targetSize(fs[0] ? fs[0] : ps[0],
-							fs[1] ? fs[1] : ps[1]);
+		Vector2i targetSize = w->measure(ctx, childConstraints);
 
 		size[axis1] += targetSize[axis1];
-		maxAxis2Size = std::max(size[axis2], targetSize[axis2] + 2 * mMargin);
-		size[axis2] = maxAxis2Size;
+		size[axis2] = std::max(size[axis2], targetSize[axis2] + 2 * mMargin);
 	}
 
 	return size;
 }
 
-void BoxLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
+void BoxLayout::arrange(NVGcontext *ctx, ref<Widget> widget) const {
 	Vector2i fs_w = widget->fixedSize();
 	Vector2i containerSize(
 			fs_w[0] ? fs_w[0] : widget->width(),
@@ -68,6 +142,9 @@ void BoxLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 	if (dynamic_pointer_cast<const Window>(widget))
 		position += widget->theme()->mWindowHeaderHeight - mMargin / 2;
 
+	LayoutConstraints childConstraints;
+	childConstraints.setMax(axis2, containerSize[axis2] - 2 * mMargin);
+
 	bool first = true;
 	for (auto w : widget->children()) {
 		if (first)
@@ -75,10 +152,8 @@ void BoxLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 		else
 			position += mSpacing;
 
-		Vector2i ps = w->preferredSize(ctx);
+		Vector2i targetSize = w->measure(ctx, childConstraints);
 		Vector2i fs = w->fixedSize();
-		Vector2i targetSize(fs[0] ? fs[0] : ps[0],
-							fs[1] ? fs[1] : ps[1]);
 		Vector2i pos = Vector2i(0);
 		pos[axis1] = position;
 
@@ -98,14 +173,13 @@ void BoxLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 			break;
 		}
 
-		w->setPosition(pos);
-		w->setSize(targetSize);
-		w->performLayout(ctx);
+		w->arrange(ctx, pos, targetSize);
 		position += targetSize[axis1];
 	}
 }
 
-Vector2i GroupLayout::preferredSize(NVGcontext *ctx, const ref<Widget> widget) const {
+Vector2i GroupLayout::measure(NVGcontext *ctx, const ref<Widget> widget,
+							  const LayoutConstraints &constraints) const {
 	int height = mMargin, width = 2 * mMargin;
 
 	ref<const Window> window = dynamic_pointer_cast<const Window>(widget);
@@ -119,13 +193,14 @@ Vector2i GroupLayout::preferredSize(NVGcontext *ctx, const ref<Widget> widget) c
 			height += (label == nullptr) ? mSpacing : mGroupSpacing;
 		first = false;
 
-		Vector2i ps = c->preferredSize(ctx), fs = c->fixedSize();
-		Vector2i targetSize(
-				fs[0] ? fs[0] : ps[0],
-				fs[1] ? fs[1] : ps[1]
-		);
-
 		bool indentCur = indent && label == nullptr;
+		LayoutConstraints childConstraints;
+		if (constraints.bounded(0))
+			childConstraints.setMax(0, constraints.max.x - 2 * mMargin -
+										   (indentCur ? mGroupIndent : 0));
+
+		Vector2i targetSize = c->measure(ctx, childConstraints);
+
 		height += targetSize.y;
 		width = std::max(width, targetSize.x + 2 * mMargin + (indentCur ? mGroupIndent : 0));
 
@@ -136,7 +211,7 @@ Vector2i GroupLayout::preferredSize(NVGcontext *ctx, const ref<Widget> widget) c
 	return Vector2i(width, height);
 }
 
-void GroupLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
+void GroupLayout::arrange(NVGcontext *ctx, ref<Widget> widget) const {
 	int height = mMargin, availableWidth =
 			(widget->fixedWidth() ? widget->fixedWidth() : widget->width()) - 2 * mMargin;
 
@@ -151,19 +226,18 @@ void GroupLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 			height += (label == nullptr) ? mSpacing : mGroupSpacing;
 		first = false;
 
+		/* Children span the available width, so they are measured (e.g. their
+		   height with wrapped text) with exactly that much space */
 		bool indentCur = indent && label == nullptr;
-		Vector2i ps = Vector2i(availableWidth - (indentCur ? mGroupIndent : 0),
-							   c->preferredSize(ctx).y);
-		Vector2i fs = c->fixedSize();
+		LayoutConstraints childConstraints;
+		childConstraints.setMax(0, availableWidth - (indentCur ? mGroupIndent : 0));
 
-		Vector2i targetSize(
-				fs[0] ? fs[0] : ps[0],
-				fs[1] ? fs[1] : ps[1]
-		);
+		Vector2i targetSize = c->measure(ctx, childConstraints);
+		if (!c->fixedWidth())
+			targetSize.x = childConstraints.max.x;
 
-		c->setPosition(Vector2i(mMargin + (indentCur ? mGroupIndent : 0), height));
-		c->setSize(targetSize);
-		c->performLayout(ctx);
+		c->arrange(ctx, Vector2i(mMargin + (indentCur ? mGroupIndent : 0), height),
+				   targetSize);
 
 		height += targetSize.y;
 
@@ -172,8 +246,8 @@ void GroupLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 	}
 }
 
-Vector2i GridLayout::preferredSize(NVGcontext *ctx,
-								   const ref<Widget> widget) const {
+Vector2i GridLayout::measure(NVGcontext *ctx, const ref<Widget> widget,
+							 const LayoutConstraints &) const {
 	/* Compute minimum row / column sizes */
 	std::vector<int> grid[2];
 	computeLayout(ctx, widget, grid);
@@ -191,7 +265,8 @@ Vector2i GridLayout::preferredSize(NVGcontext *ctx,
 	return size;
 }
 
-void GridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget, std::vector<int> *grid) const {
+void GridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget,
+							   std::vector<int> *grid, std::vector<Vector2i> *sizes) const {
 	int axis1 = (int) mOrientation, axis2 = (axis1 + 1) % 2;
 	size_t numChildren = widget->children().size();
 
@@ -211,12 +286,10 @@ void GridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget, std::v
 				return;
 			ref<Widget> w = widget->children()[child++];
 
-			Vector2i ps = w->preferredSize(ctx);
-			Vector2i fs = w->fixedSize();
-			Vector2i targetSize(
-					fs[0] ? fs[0] : ps[0],
-					fs[1] ? fs[1] : ps[1]
-			);
+			/* Cells are sized to fit their contents, so children are unconstrained */
+			Vector2i targetSize = w->measure(ctx);
+			if (sizes)
+				sizes->push_back(targetSize);
 
 			grid[axis1][i1] = std::max(grid[axis1][i1], targetSize[axis1]);
 			grid[axis2][i2] = std::max(grid[axis2][i2], targetSize[axis2]);
@@ -224,7 +297,7 @@ void GridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget, std::v
 	}
 }
 
-void GridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
+void GridLayout::arrange(NVGcontext *ctx, ref<Widget> widget) const {
 	Vector2i fs_w = widget->fixedSize();
 	Vector2i containerSize(
 			fs_w[0] ? fs_w[0] : widget->width(),
@@ -233,7 +306,8 @@ void GridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 
 	/* Compute minimum row / column sizes */
 	std::vector<int> grid[2];
-	computeLayout(ctx, widget, grid);
+	std::vector<Vector2i> sizes;
+	computeLayout(ctx, widget, grid, &sizes);
 	int dim[2] = {(int) grid[0].size(), (int) grid[1].size()};
 
 	Vector2i extra = Vector2i(0);
@@ -273,14 +347,9 @@ void GridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 		for (int i1 = 0; i1 < dim[axis1]; i1++) {
 			if (child >= numChildren)
 				return;
+			Vector2i targetSize = sizes[child];
 			ref<Widget> w = widget->children()[child++];
-
-			Vector2i ps = w->preferredSize(ctx);
 			Vector2i fs = w->fixedSize();
-			Vector2i targetSize(
-					fs[0] ? fs[0] : ps[0],
-					fs[1] ? fs[1] : ps[1]
-			);
 
 			Vector2i itemPos(pos);
 			for (int j = 0; j < 2; j++) {
@@ -302,9 +371,7 @@ void GridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
 					break;
 				}
 			}
-			w->setPosition(itemPos);
-			w->setSize(targetSize);
-			w->performLayout(ctx);
+			w->arrange(ctx, itemPos, targetSize);
 			pos[axis1] += grid[axis1][i1] + mSpacing[axis1];
 		}
 		pos[axis2] += grid[axis2][i2] + mSpacing[axis2];
@@ -317,7 +384,8 @@ AdvancedGridLayout::AdvancedGridLayout(const std::vector<int> &cols, const std::
 	mRowStretch.resize(mRows.size(), 0);
 }
 
-Vector2i AdvancedGridLayout::preferredSize(NVGcontext *ctx, const ref<Widget> widget) const {
+Vector2i AdvancedGridLayout::measure(NVGcontext *ctx, const ref<Widget> widget,
+									 const LayoutConstraints &) const {
 	/* Compute minimum row / column sizes */
 	std::vector<int> grid[2];
 	computeLayout(ctx, widget, grid);
@@ -333,7 +401,7 @@ Vector2i AdvancedGridLayout::preferredSize(NVGcontext *ctx, const ref<Widget> wi
 	return size + extra;
 }
 
-void AdvancedGridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) const {
+void AdvancedGridLayout::arrange(NVGcontext *ctx, ref<Widget> widget) const {
 	std::vector<int> grid[2];
 	computeLayout(ctx, widget, grid);
 
@@ -343,17 +411,21 @@ void AdvancedGridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) cons
 	else
 		grid[1].insert(grid[1].begin(), mMargin);
 
+	/* Place both axes first, so that each child is laid out only once */
+	const std::vector<ref<Widget>> &children = widget->children();
+	std::vector<Vector2i> positions(children.size()), sizes(children.size());
+
 	for (int axis = 0; axis < 2; ++axis) {
 		for (size_t i = 1; i < grid[axis].size(); ++i)
 			grid[axis][i] += grid[axis][i - 1];
 
-		for (ref<Widget> w : widget->children()) {
+		for (size_t index = 0; index < children.size(); ++index) {
+			const ref<Widget> &w = children[index];
 			Anchor anchor = this->anchor(w);
 
 			int itemPos = grid[axis][anchor.pos[axis]];
 			int cellSize = grid[axis][anchor.pos[axis] + anchor.size[axis]] - itemPos;
-			int ps = w->preferredSize(ctx)[axis], fs = w->fixedSize()[axis];
-			int targetSize = fs ? fs : ps;
+			int targetSize = w->measure(ctx)[axis], fs = w->fixedSize()[axis];
 
 			switch (anchor.align[axis]) {
 			case Alignment::Minimum:
@@ -369,14 +441,13 @@ void AdvancedGridLayout::performLayout(NVGcontext *ctx, ref<Widget> widget) cons
 				break;
 			}
 
-			Vector2i pos = w->position(), size = w->size();
-			pos[axis] = itemPos;
-			size[axis] = targetSize;
-			w->setPosition(pos);
-			w->setSize(size);
-			w->performLayout(ctx);
+			positions[index][axis] = itemPos;
+			sizes[index][axis] = targetSize;
 		}
 	}
+
+	for (size_t index = 0; index < children.size(); ++index)
+		children[index]->arrange(ctx, positions[index], sizes[index]);
 }
 
 void AdvancedGridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget,
@@ -405,8 +476,7 @@ void AdvancedGridLayout::computeLayout(NVGcontext *ctx, const ref<Widget> widget
 				const Anchor &anchor = pair.second;
 				if ((anchor.size[axis] == 1) != (phase == 0))
 					continue;
-				int ps = w->preferredSize(ctx)[axis], fs = w->fixedSize()[axis];
-				int targetSize = fs ? fs : ps;
+				int targetSize = w->measure(ctx)[axis];
 
 				if (anchor.pos[axis] + anchor.size[axis] > grid.size())
 					throw std::runtime_error(
@@ -0,0 +1,727 @@
+/*
+    src/plot.cpp -- Zoomable multi-channel time series plot backed by a
+    memory-mapped sample file and a precomputed min/max pyramid
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/plot.h>
+#include <nanogui/opengl.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Read-only memory mapping of an entire file */
+struct PlotData::MappedFile {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    int64_t mtime = 0; /* Last modification, in platform-specific units */
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+    bool open(const std::string &filename) {
+#if defined(_WIN32)
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+            return false;
+        size = (size_t) fileSize.QuadPart;
+        FILETIME writeTime;
+        if (!GetFileTime(file, nullptr, nullptr, &writeTime))
+            return false;
+        mtime = ((int64_t) writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+        if (size == 0)
+            return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return false;
+        data = (const uint8_t *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            return false;
+        struct stat sb;
+        if (fstat(fd, &sb) != 0) {
+            close(fd);
+            return false;
+        }
+        size = (size_t) sb.st_size;
+        /* Nanoseconds, so that rewrites within the same second are noticed */
+#  if defined(__APPLE__)
+        const struct timespec &ts = sb.st_mtimespec;
+#  else
+        const struct timespec &ts = sb.st_mtim;
+#  endif
+        mtime = (int64_t) ts.tv_sec * 1000000000 + (int64_t) ts.tv_nsec;
+        void *ptr = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+        close(fd);
+        if (ptr == MAP_FAILED)
+            return false;
+        data = (const uint8_t *) ptr;
+        return true;
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (data)
+            munmap((void *) data, size);
+#endif
+    }
+};
+
+/* Layout of the sidecar file: this header, followed by the pyramid levels
+   1, 2, ..., each an array of (min, max) pairs per channel and block. The
+   size and modification time of the sample file detect stale sidecars. */
+struct PlotIndexHeader {
+    char magic[8];
+    uint32_t channels, factor;
+    uint64_t frames;
+    uint32_t levels, reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+static const char plotIndexMagic[8] = "NGPLOD2";
+
+static std::vector<uint64_t> plotLevelSizes(uint64_t frames) {
+    std::vector<uint64_t> sizes;
+    uint64_t n = frames;
+    while (n > 1) {
+        n = (n + PlotData::LevelFactor - 1) / PlotData::LevelFactor;
+        sizes.push_back(n);
+    }
+    return sizes;
+}
+
+static bool seekFile(FILE *f, uint64_t offset) {
+#if defined(_WIN32)
+    return _fseeki64(f, (__int64) offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+PlotData::PlotData(const std::string &filename, int channels, double sampleRate,
+                   bool indexInBackground)
+    : mFilename(filename), mChannels(channels), mSampleRate(sampleRate), mFrameCount(0),
+      mProgress(0.f), mIndexerDone(false), mCancel(false) {
+    if (channels < 1 || sampleRate <= 0)
+        throw std::runtime_error("PlotData: invalid channel count or sample rate!");
+    mSamples.reset(new MappedFile());
+    if (!mSamples->open(filename))
+        throw std::runtime_error("PlotData: could not map \"" + filename + "\"!");
+    mFrameCount = mSamples->size / (sizeof(float) * channels);
+
+    if (openIndex()) {
+        mProgress = 1.f;
+    } else if (indexInBackground) {
+        mIndexer = std::thread([this]() {
+            buildIndex(mFilename, mChannels, &mProgress, &mCancel);
+            mIndexerDone = true;
+        });
+    }
+}
+
+PlotData::~PlotData() {
+    mCancel = true;
+    if (mIndexer.joinable())
+        mIndexer.join();
+}
+
+float PlotData::sample(uint64_t frame, int channel) const {
+    return ((const float *) mSamples->data)[frame * mChannels + channel];
+}
+
+bool PlotData::indexed() {
+    if (mIndex)
+        return true;
+    if (mIndexerDone) {
+        mIndexer.join();
+        mIndexerDone = false;
+        if (openIndex())
+            mProgress = 1.f;
+    }
+    return (bool) mIndex;
+}
+
+bool PlotData::openIndex() {
+    std::unique_ptr<MappedFile> index(new MappedFile());
+    if (!index->open(indexFilename(mFilename)) || index->size < sizeof(PlotIndexHeader))
+        return false;
+
+    PlotIndexHeader header;
+    memcpy(&header, index->data, sizeof(PlotIndexHeader));
+    std::vector<uint64_t> sizes = plotLevelSizes(mFrameCount);
+    if (memcmp(header.magic, plotIndexMagic, sizeof(plotIndexMagic)) != 0 ||
+        header.channels != (uint32_t) mChannels || header.factor != (uint32_t) LevelFactor ||
+        header.frames != mFrameCount || header.levels != (uint32_t) sizes.size() ||
+        header.sourceSize != (uint64_t) mSamples->size || header.sourceTime != mSamples->mtime)
+        return false;
+
+    uint64_t offset = sizeof(PlotIndexHeader);
+    std::vector<const float *> levels;
+    for (uint64_t size : sizes) {
+        levels.push_back((const float *) (index->data + offset));
+        offset += size * mChannels * 2 * sizeof(float);
+    }
+    if (offset != index->size)
+        return false;
+
+    mIndex = std::move(index);
+    mLevels = levels;
+    mLevelSizes = sizes;
+    return true;
+}
+
+bool PlotData::buildIndex(const std::string &filename, int channels,
+                          std::atomic<float> *progress,
+                          const std::atomic<bool> *cancel) {
+    MappedFile samples;
+    if (!samples.open(filename))
+        return false;
+
+    const float *data = (const float *) samples.data;
+    uint64_t frames = samples.size / (sizeof(float) * channels);
+    std::vector<uint64_t> sizes = plotLevelSizes(frames);
+    size_t levelCount = sizes.size(), pairs = 2 * channels;
+
+    PlotIndexHeader header;
+    memset(&header, 0, sizeof(PlotIndexHeader));
+    memcpy(header.magic, plotIndexMagic, sizeof(plotIndexMagic));
+    header.channels = (uint32_t) channels;
+    header.factor = (uint32_t) LevelFactor;
+    header.frames = frames;
+    header.levels = (uint32_t) levelCount;
+    header.sourceSize = (uint64_t) samples.size;
+    header.sourceTime = samples.mtime;
+
+    std::string target = indexFilename(filename), temp = target + ".tmp";
+    FILE *f = fopen(temp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool success = fwrite(&header, sizeof(PlotIndexHeader), 1, f) == 1;
+
+    /* Each level is accumulated from the one below it and written to its
+       own region of the file in chunks, so that only O(levels) memory is
+       needed regardless of the length of the recording */
+    struct Level {
+        uint64_t offset;
+        std::vector<float> accum, buffer;
+        int count;
+    };
+    std::vector<Level> levels(levelCount);
+    uint64_t offset = sizeof(PlotIndexHeader);
+    for (size_t l = 0; l < levelCount; ++l) {
+        levels[l].offset = offset;
+        levels[l].accum.resize(pairs);
+        levels[l].count = 0;
+        offset += sizes[l] * pairs * sizeof(float);
+    }
+
+    const size_t chunkSize = 1 << 16;
+    auto flush = [&](Level &level) {
+        if (level.buffer.empty())
+            return;
+        success &= seekFile(f, level.offset) &&
+            fwrite(level.buffer.data(), sizeof(float), level.buffer.size(), f) == level.buffer.size();
+        level.offset += level.buffer.size() * sizeof(float);
+        level.buffer.clear();
+    };
+
+    std::function<void(size_t, const float *)> emit = [&](size_t l, const float *entry) {
+        Level &level = levels[l];
+        level.buffer.insert(level.buffer.end(), entry, entry + pairs);
+        if (level.buffer.size() >= chunkSize)
+            flush(level);
+        if (l + 1 == levelCount)
+            return;
+
+        Level &parent = levels[l + 1];
+        for (size_t i = 0; i < pairs; i += 2) {
+            parent.accum[i]     = parent.count == 0 ? entry[i]     : std::min(parent.accum[i], entry[i]);
+            parent.accum[i + 1] = parent.count == 0 ? entry[i + 1] : std::max(parent.accum[i + 1], entry[i + 1]);
+        }
+        if (++parent.count == LevelFactor) {
+            emit(l + 1, parent.accum.data());
+            parent.count = 0;
+        }
+    };
+
+    /* Level 1 is computed directly from blocks of the recording */
+    std::vector<float> entry(pairs);
+    for (uint64_t block = 0; levelCount > 0 && block < sizes[0] && success; ++block) {
+        uint64_t f0 = block * LevelFactor, f1 = std::min(f0 + LevelFactor, frames);
+        for (int c = 0; c < channels; ++c) {
+            float lo = data[f0 * channels + c], hi = lo;
+            for (uint64_t i = f0 + 1; i < f1; ++i) {
+                float value = data[i * channels + c];
+                lo = std::min(lo, value);
+                hi = std::max(hi, value);
+            }
+            entry[2 * c] = lo;
+            entry[2 * c + 1] = hi;
+        }
+        emit(0, entry.data());
+
+        if ((block & 0xFFFF) == 0) {
+            if (cancel && *cancel) {
+                success = false;
+                break;
+            }
+            if (progress)
+                *progress = (float) block / (float) sizes[0];
+        }
+    }
+
+    /* Emit the partial blocks at the end of each level */
+    for (size_t l = 1; l < levelCount && success; ++l) {
+        if (levels[l].count > 0) {
+            emit(l, levels[l].accum.data());
+            levels[l].count = 0;
+        }
+    }
+    for (size_t l = 0; l < levelCount; ++l)
+        flush(levels[l]);
+
+    success &= fclose(f) == 0;
+    if (success) {
+        std::remove(target.c_str());
+        success = std::rename(temp.c_str(), target.c_str()) == 0;
+    } else {
+        std::remove(temp.c_str());
+    }
+    if (success && progress)
+        *progress = 1.f;
+    return success;
+}
+
+bool PlotData::envelope(int channel, double start, double end, int columns, float *out) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const double rawLimit = 1024; /* Max. frames per column read without an index */
+    double spp = (end - start) / columns;
+
+    /* Pick the coarsest level whose blocks are no larger than a column */
+    int level = 0;
+    double blockSize = 1;
+    if (indexed()) {
+        while (level < (int) mLevels.size() && blockSize * LevelFactor <= spp) {
+            blockSize *= LevelFactor;
+            ++level;
+        }
+    } else if (spp > rawLimit) {
+        for (int c = 0; c < 2 * columns; ++c)
+            out[c] = nan;
+        return false;
+    }
+
+    int64_t count = (int64_t) (level == 0 ? mFrameCount : mLevelSizes[level - 1]);
+    const float *raw = (const float *) mSamples->data;
+    const float *pyramid = level > 0 ? mLevels[level - 1] : nullptr;
+
+    for (int c = 0; c < columns; ++c) {
+        double s0 = start + c * spp, s1 = s0 + spp;
+        int64_t i0 = (int64_t) std::floor(s0 / blockSize);
+        int64_t i1 = std::max(i0 + 1, (int64_t) std::floor(s1 / blockSize));
+        i0 = std::max(i0, (int64_t) 0);
+        i1 = std::min(i1, count);
+
+        float lo = nan, hi = nan;
+        if (i0 < i1) {
+            if (level == 0) {
+                lo = hi = raw[i0 * mChannels + channel];
+                for (int64_t i = i0 + 1; i < i1; ++i) {
+                    float value = raw[i * mChannels + channel];
+                    lo = std::min(lo, value);
+                    hi = std::max(hi, value);
+                }
+            } else {
+                const float *e = pyramid + 2 * (i0 * mChannels + channel);
+                lo = e[0]; hi = e[1];
+                for (int64_t i = i0 + 1; i < i1; ++i) {
+                    e = pyramid + 2 * (i * mChannels + channel);
+                    lo = std::min(lo, e[0]);
+                    hi = std::max(hi, e[1]);
+                }
+            }
+        }
+        out[2 * c] = lo;
+        out[2 * c + 1] = hi;
+    }
+    return true;
+}
+
+/* Return a round step (1, 2 or 5 times a power of ten) giving roughly 'count' ticks */
+static double niceStep(double range, double count) {
+    double raw = range / std::max(count, 1.0);
+    double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    double residual = raw / magnitude;
+    if (residual > 5)
+        return 10 * magnitude;
+    else if (residual > 2)
+        return 5 * magnitude;
+    else if (residual > 1)
+        return 2 * magnitude;
+    return magnitude;
+}
+
+static std::string formatTime(double t, double step) {
+    char buf[64];
+    if (step >= 1 && std::abs(t) >= 60) {
+        long long s = (long long) std::floor(t + 0.5);
+        snprintf(buf, sizeof(buf), "%lld:%02lld:%02lld", s / 3600, (s / 60) % 60, s % 60);
+    } else {
+        int decimals = std::max(0, (int) std::ceil(-std::log10(step) - 1e-6));
+        snprintf(buf, sizeof(buf), "%.*f s", decimals, t);
+    }
+    return buf;
+}
+
+Plot::Plot(ref<Widget> parent, const std::string &caption)
+    : Widget(parent), mCaption(caption), mViewStart(0), mViewEnd(1),
+      mValueRange(0.f, 1.f), mAutoScale(true), mColumns(0), mComplete(true),
+      mCursorVisible(false) {
+    mBackgroundColor = Color(20, 128);
+    mTextColor = Color(240, 192);
+}
+
+void Plot::setData(ref<PlotData> data) {
+    static const Color palette[] = {
+        Color(255, 192, 0, 255), Color(80, 180, 255, 255), Color(255, 90, 90, 255),
+        Color(120, 220, 110, 255), Color(210, 130, 255, 255), Color(240, 240, 240, 255)
+    };
+
+    mData = data;
+    mChannelInfo.clear();
+    if (!mData)
+        return;
+    for (int i = 0; i < mData->channels(); ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "Channel %i", i + 1);
+        mChannelInfo.push_back(ChannelInfo {
+            name, palette[i % (sizeof(palette) / sizeof(Color))], true });
+    }
+    setView(0, std::max(mData->duration(), 1.0 / mData->sampleRate()));
+}
+
+void Plot::setView(double start, double end) {
+    double span = end - start;
+    if (mData) {
+        /* At least a few samples, at most the entire recording */
+        double minSpan = 4 / mData->sampleRate();
+        double maxSpan = std::max(mData->duration(), minSpan);
+        double center = (start + end) * 0.5;
+        span = std::min(std::max(span, minSpan), maxSpan);
+        start = center - span * 0.5;
+        start = std::max(0.0, std::min(start, maxSpan - span));
+    } else if (!(span > 0)) {
+        span = 1;
+    }
+    mViewStart = start;
+    mViewEnd = start + span;
+}
+
+void Plot::plotArea(Vector2f &origin, Vector2f &size) const {
+    origin = Vector2f(mPos) + Vector2f(48, 4);
+    size = glm::max(Vector2f(mSize) - Vector2f(52, 22), Vector2f(1.f));
+}
+
+double Plot::timeAt(int x) const {
+    Vector2f origin, size;
+    plotArea(origin, size);
+    return mViewStart + (x - origin.x) / size.x * (mViewEnd - mViewStart);
+}
+
+Vector2i Plot::preferredSize(NVGcontext *) {
+    return Vector2i(400, 200);
+}
+
+bool Plot::mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers) {
+    Widget::mouseButtonEvent(p, button, down, modifiers);
+    return true;
+}
+
+bool Plot::mouseMotionEvent(const Vector2i &p, const Vector2i & /* rel */,
+                            int /* button */, int /* modifiers */) {
+    mCursor = p;
+    mCursorVisible = true;
+    return true;
+}
+
+bool Plot::mouseDragEvent(const Vector2i &p, const Vector2i &rel,
+                          int /* button */, int /* modifiers */) {
+    Vector2f origin, size;
+    plotArea(origin, size);
+    double dt = -rel.x * (mViewEnd - mViewStart) / size.x;
+    setView(mViewStart + dt, mViewEnd + dt);
+    mCursor = p;
+    return true;
+}
+
+bool Plot::mouseEnterEvent(const Vector2i &p, bool enter) {
+    Widget::mouseEnterEvent(p, enter);
+    mCursorVisible = enter;
+    return true;
+}
+
+bool Plot::scrollEvent(const Vector2i &p, const Vector2f &rel) {
+    double t = timeAt(p.x);
+    double scale = std::pow(1.2, -rel.y);
+    setView(t - (t - mViewStart) * scale, t + (mViewEnd - t) * scale);
+    return true;
+}
+
+void Plot::drawAxes(NVGcontext *ctx, const Vector2f &origin, const Vector2f &size) {
+    nvgFontFace(ctx, "sans");
+    nvgFontSize(ctx, 13.0f);
+    nvgFillColor(ctx, mTextColor);
+
+    /* Value axis */
+    float range = mValueRange.y - mValueRange.x;
+    double vstep = niceStep(range, size.y / 30);
+    nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_MIDDLE);
+    nvgBeginPath(ctx);
+    for (double v = std::ceil(mValueRange.x / vstep) * vstep; v <= mValueRange.y; v += vstep) {
+        float y = origin.y + (1 - (float) (v - mValueRange.x) / range) * size.y;
+        nvgMoveTo(ctx, origin.x, y);
+        nvgLineTo(ctx, origin.x + size.x, y);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", std::abs(v) < vstep * 1e-6 ? 0.0 : v);
+        nvgText(ctx, origin.x - 4, y, buf, NULL);
+    }
+
+    /* Time axis */
+    double span = mViewEnd - mViewStart;
+    double tstep = niceStep(span, size.x / 90);
+    nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
+    for (double t = std::ceil(mViewStart / tstep) * tstep; t <= mViewEnd; t += tstep) {
+        float x = origin.x + (float) ((t - mViewStart) / span) * size.x;
+        nvgMoveTo(ctx, x, origin.y);
+        nvgLineTo(ctx, x, origin.y + size.y);
+        nvgText(ctx, x, origin.y + size.y + 2, formatTime(t, tstep).c_str(), NULL);
+    }
+    nvgStrokeColor(ctx, Color(255, 20));
+    nvgStroke(ctx);
+}
+
+void Plot::drawReadout(NVGcontext *ctx, const Vector2f &origin, const Vector2f &size) {
+    float cx = (float) mCursor.x;
+    if (cx < origin.x || cx >= origin.x + size.x || mCursor.y < origin.y ||
+        mCursor.y >= origin.y + size.y)
+        return;
+
+    nvgBeginPath(ctx);
+    nvgMoveTo(ctx, cx + 0.5f, origin.y);
+    nvgLineTo(ctx, cx + 0.5f, origin.y + size.y);
+    nvgStrokeColor(ctx, Color(255, 100));
+    nvgStroke(ctx);
+
+    double t = timeAt(mCursor.x);
+    double fs = mData->sampleRate();
+    bool perSample = (mViewEnd - mViewStart) * fs < mColumns;
+    int column = std::min((int) (cx - origin.x), mColumns - 1);
+    int64_t frame = (int64_t) std::floor(t * fs + 0.5);
+
+    std::vector<std::pair<std::string, Color>> lines;
+    lines.push_back(std::make_pair(formatTime(t, 1.0 / fs), mTextColor));
+    for (int ch = 0; ch < (int) mChannelInfo.size(); ++ch) {
+        if (!mChannelInfo[ch].visible)
+            continue;
+        char buf[128];
+        if (perSample) {
+            if (frame < 0 || frame >= (int64_t) mData->frameCount())
+                continue;
+            snprintf(buf, sizeof(buf), "%s: %g", mChannelInfo[ch].name.c_str(),
+                     mData->sample((uint64_t) frame, ch));
+        } else {
+            float lo = mEnvelope[2 * (mColumns * ch + column)];
+            float hi = mEnvelope[2 * (mColumns * ch + column) + 1];
+            if (std::isnan(lo))
+                continue;
+            if (lo == hi)
+                snprintf(buf, sizeof(buf), "%s: %g", mChannelInfo[ch].name.c_str(), lo);
+            else
+                snprintf(buf, sizeof(buf), "%s: %g .. %g", mChannelInfo[ch].name.c_str(), lo, hi);
+        }
+        lines.push_back(std::make_pair(std::string(buf), mChannelInfo[ch].color));
+    }
+
+    nvgFontFace(ctx, "sans");
+    nvgFontSize(ctx, 14.0f);
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    float width = 0, lineHeight = 16;
+    for (auto const &line : lines)
+        width = std::max(width, nvgTextBounds(ctx, 0, 0, line.first.c_str(), NULL, NULL));
+    Vector2f boxSize(width + 8, lines.size() * lineHeight + 4);
+    Vector2f boxPos(cx + 8, origin.y + 4);
+    if (boxPos.x + boxSize.x > origin.x + size.x)
+        boxPos.x = cx - 8 - boxSize.x;
+
+    nvgBeginPath(ctx);
+    nvgRoundedRect(ctx, boxPos.x, boxPos.y, boxSize.x, boxSize.y, 3);
+    nvgFillColor(ctx, Color(0, 200));
+    nvgFill(ctx);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        nvgFillColor(ctx, lines[i].second);
+        nvgText(ctx, boxPos.x + 4, boxPos.y + 2 + i * lineHeight, lines[i].first.c_str(), NULL);
+    }
+}
+
+void Plot::draw(NVGcontext *ctx) {
+    Widget::draw(ctx);
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillColor(ctx, mBackgroundColor);
+    nvgFill(ctx);
+
+    Vector2f origin, size;
+    plotArea(origin, size);
+
+    if (mData) {
+        double fs = mData->sampleRate();
+        double start = mViewStart * fs, end = mViewEnd * fs;
+        int channels = mData->channels();
+        bool perSample = end - start < size.x;
+
+        /* Fetch the envelopes of all visible channels */
+        mColumns = std::max((int) size.x, 2);
+        mEnvelope.resize(2 * mColumns * channels);
+        mComplete = true;
+        for (int ch = 0; ch < channels; ++ch) {
+            if (mChannelInfo[ch].visible)
+                mComplete &= mData->envelope(ch, start, end, mColumns, &mEnvelope[2 * mColumns * ch]);
+        }
+
+        if (mAutoScale) {
+            float lo = std::numeric_limits<float>::infinity(), hi = -lo;
+            for (int ch = 0; ch < channels; ++ch) {
+                if (!mChannelInfo[ch].visible)
+                    continue;
+                const float *envelope = &mEnvelope[2 * mColumns * ch];
+                for (int i = 0; i < 2 * mColumns; ++i) {
+                    if (!std::isnan(envelope[i])) {
+                        lo = std::min(lo, envelope[i]);
+                        hi = std::max(hi, envelope[i]);
+                    }
+                }
+            }
+            if (lo <= hi) {
+                float pad = hi > lo ? (hi - lo) * 0.05f : 0.5f;
+                mValueRange = Vector2f(lo - pad, hi + pad);
+            }
+        }
+
+        drawAxes(ctx, origin, size);
+
+        nvgSave(ctx);
+        nvgIntersectScissor(ctx, origin.x, origin.y, size.x, size.y);
+        float range = mValueRange.y - mValueRange.x;
+        auto yCoord = [&](float v) { return origin.y + (1 - (v - mValueRange.x) / range) * size.y; };
+
+        for (int ch = 0; ch < channels; ++ch) {
+            if (!mChannelInfo[ch].visible)
+                continue;
+            nvgBeginPath(ctx);
+            if (perSample) {
+                /* Zoomed in beyond one sample per pixel: connect the samples */
+                int64_t f0 = std::max((int64_t) std::floor(start), (int64_t) 0);
+                int64_t f1 = std::min((int64_t) std::ceil(end) + 1, (int64_t) mData->frameCount());
+                for (int64_t f = f0; f < f1; ++f) {
+                    float x = origin.x + (float) ((f - start) / (end - start)) * size.x;
+                    float y = yCoord(mData->sample((uint64_t) f, ch));
+                    if (f == f0)
+                        nvgMoveTo(ctx, x, y);
+                    else
+                        nvgLineTo(ctx, x, y);
+                }
+            } else {
+                /* Emit each column's extrema in the order closest to the
+                   previous point, which keeps the outline from crossing itself */
+                const float *envelope = &mEnvelope[2 * mColumns * ch];
+                bool first = true;
+                float prev = 0;
+                for (int c = 0; c < mColumns; ++c) {
+                    float lo = envelope[2 * c], hi = envelope[2 * c + 1];
+                    if (std::isnan(lo)) {
+                        first = true;
+                        continue;
+                    }
+                    if (!first && std::abs(prev - hi) < std::abs(prev - lo))
+                        std::swap(lo, hi);
+                    float x = origin.x + c + 0.5f;
+                    if (first)
+                        nvgMoveTo(ctx, x, yCoord(lo));
+                    else
+                        nvgLineTo(ctx, x, yCoord(lo));
+                    nvgLineTo(ctx, x, yCoord(hi));
+                    prev = hi;
+                    first = false;
+                }
+            }
+            nvgStrokeColor(ctx, mChannelInfo[ch].color);
+            nvgStroke(ctx);
+        }
+        nvgRestore(ctx);
+
+        if (!mComplete) {
+            char buf[64];
+            if (mData->indexing())
+                snprintf(buf, sizeof(buf), "Indexing .. %i%%", (int) (mData->indexProgress() * 100));
+            else
+                snprintf(buf, sizeof(buf), "No index");
+            nvgFontFace(ctx, "sans");
+            nvgFontSize(ctx, 18.0f);
+            nvgTextAlign(ctx, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
+            nvgFillColor(ctx, mTextColor);
+            nvgText(ctx, origin.x + size.x * 0.5f, origin.y + size.y * 0.5f, buf, NULL);
+        }
+
+        if (mCursorVisible)
+            drawReadout(ctx, origin, size);
+    }
+
+    if (!mCaption.empty()) {
+        nvgFontFace(ctx, "sans");
+        nvgFontSize(ctx, 14.0f);
+        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+        nvgFillColor(ctx, mTextColor);
+        nvgText(ctx, origin.x + 3, origin.y + 1, mCaption.c_str(), NULL);
+    }
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, origin.x, origin.y, size.x, size.y);
+    nvgStrokeColor(ctx, Color(100, 255));
+    nvgStroke(ctx);
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,75 @@
+/*
+    src/samplering.cpp -- Fixed-capacity lock-free queue of sample frames
+    for feeding plots from producer threads
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/samplering.h>
+#include <cstring>
+
+NAMESPACE_BEGIN(nanogui)
+
+SampleRing::SampleRing(size_t capacity, int frameSize)
+    : mMask(0), mFrameSize(frameSize), mDropped(0), mEnqueuePos(0), mDequeuePos(0) {
+    if (frameSize < 1)
+        throw std::runtime_error("SampleRing: frame size must be positive!");
+
+    /* Round the capacity up to a power of two so that positions can be masked */
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    mMask = size - 1;
+
+    mSequence.reset(new std::atomic<size_t>[size]);
+    for (size_t i = 0; i < size; ++i)
+        mSequence[i].store(i, std::memory_order_relaxed);
+    mData.resize(size * frameSize);
+}
+
+bool SampleRing::push(const float *frame) {
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        size_t seq = mSequence[pos & mMask].load(std::memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t) seq - (ptrdiff_t) pos;
+        if (diff == 0) {
+            /* The slot is free: try to claim it */
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            /* The consumer has not yet released this slot: the queue is full */
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    memcpy(&mData[(pos & mMask) * mFrameSize], frame, sizeof(float) * mFrameSize);
+    mSequence[pos & mMask].store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t SampleRing::pop(float *out, size_t maxFrames) {
+    size_t count = 0;
+    while (count < maxFrames) {
+        size_t pos = mDequeuePos;
+        size_t seq = mSequence[pos & mMask].load(std::memory_order_acquire);
+        if (seq != pos + 1)
+            break; /* Empty, or the next frame is still being written */
+
+        memcpy(out + count * mFrameSize, &mData[(pos & mMask) * mFrameSize],
+               sizeof(float) * mFrameSize);
+        mSequence[pos & mMask].store(pos + mMask + 1, std::memory_order_release);
+        mDequeuePos = pos + 1;
+        ++count;
+    }
+    return count;
+}
+
+NAMESPACE_END(nanogui)
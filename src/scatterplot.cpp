@@ -0,0 +1,373 @@
+/*
+    src/scatterplot.cpp -- GPU-accelerated scatter plot for very large
+    point clouds
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/scatterplot.h>
+#include <nanogui/screen.h>
+#include <nanogui/opengl.h>
+#include <cmath>
+
+NAMESPACE_BEGIN(nanogui)
+
+static const char *scatterVertexShader =
+    "#version 330\n"
+    "uniform vec2 scale;\n"
+    "uniform vec2 offset;\n"
+    "uniform float pixelRatio;\n"
+    "in vec2 position;\n"
+    "in vec4 color;\n"
+    "in float size;\n"
+    "out vec4 pointColor;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(position * scale + offset, 0.0, 1.0);\n"
+    "    gl_PointSize = size * pixelRatio;\n"
+    "    pointColor = color;\n"
+    "}";
+
+/* Round point sprites with an antialiased edge and premultiplied alpha */
+static const char *scatterFragmentShader =
+    "#version 330\n"
+    "in vec4 pointColor;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    float r = length(gl_PointCoord * 2.0 - 1.0);\n"
+    "    float alpha = pointColor.a * (1.0 - smoothstep(1.0 - fwidth(r), 1.0, r));\n"
+    "    if (alpha <= 0.0)\n"
+    "        discard;\n"
+    "    color = vec4(pointColor.rgb * alpha, alpha);\n"
+    "}";
+
+ScatterPlot::ScatterPlot(ref<Widget> parent)
+    : Widget(parent), mBoundsMin(0.f), mBoundsMax(1.f), mViewMin(0.f), mViewMax(1.f),
+      mPointSize(3.f), mUploadPending(false), mDirty(true), mCancelIndexer(false), mHoverIndex(-1) {
+    mPointColor = Color(255, 192, 0, 200);
+    mBackgroundColor = Color(20, 128);
+}
+
+ScatterPlot::~ScatterPlot() {
+    stopIndexer();
+
+    if (!mOffscreen.releaseIfAlive())
+        return;
+    mShader.free();
+}
+
+void ScatterPlot::setPoints(const std::vector<Vector2f> &positions,
+                            const std::vector<Color> &colors,
+                            const std::vector<float> &sizes) {
+    if ((!colors.empty() && colors.size() != positions.size()) ||
+        (!sizes.empty() && sizes.size() != positions.size()))
+        throw std::runtime_error("ScatterPlot::setPoints(): attribute count mismatch!");
+
+    stopIndexer();
+    mGrid.reset();
+    mPendingGrid.reset();
+
+    mPositions = positions;
+    mPendingSizes = sizes;
+
+    /* Colors are stored as normalized 8-bit RGBA on the GPU */
+    mPendingColors.resize(colors.size() * 4);
+    for (size_t i = 0; i < colors.size(); ++i) {
+        for (int j = 0; j < 4; ++j)
+            mPendingColors[4 * i + j] = (uint8_t) std::min(std::max(colors[i][j] * 255.f + 0.5f, 0.f), 255.f);
+    }
+
+    mBoundsMin = mBoundsMax = positions.empty() ? Vector2f(0.f) : positions[0];
+    for (const Vector2f &p : positions) {
+        mBoundsMin = glm::min(mBoundsMin, p);
+        mBoundsMax = glm::max(mBoundsMax, p);
+    }
+    fitView();
+
+    mUploadPending = true;
+    mHoverIndex = -1;
+
+    if (!mPositions.empty()) {
+        mCancelIndexer = false;
+        mIndexer = std::thread([this]() { buildGrid(); });
+    }
+}
+
+void ScatterPlot::setView(const Vector2f &min, const Vector2f &max) {
+    /* Keep the view from collapsing to zero area */
+    Vector2f center = (min + max) * 0.5f;
+    Vector2f extent = glm::max(max - min, glm::max(glm::abs(center) * 1e-6f, Vector2f(1e-20f)));
+    mViewMin = center - extent * 0.5f;
+    mViewMax = center + extent * 0.5f;
+    mDirty = true;
+}
+
+void ScatterPlot::fitView() {
+    Vector2f margin = (mBoundsMax - mBoundsMin) * 0.05f;
+    if (margin.x == 0)
+        margin.x = 0.5f;
+    if (margin.y == 0)
+        margin.y = 0.5f;
+    setView(mBoundsMin - margin, mBoundsMax + margin);
+}
+
+void ScatterPlot::stopIndexer() {
+    mCancelIndexer = true;
+    if (mIndexer.joinable())
+        mIndexer.join();
+}
+
+void ScatterPlot::buildGrid() {
+    std::unique_ptr<PickGrid> grid(new PickGrid());
+    size_t count = mPositions.size();
+
+    /* Roughly four points per cell for uniformly distributed data */
+    int res = std::min(std::max((int) std::sqrt(count / 4.0), 1), 2048);
+    grid->resolution = Vector2i(res);
+    grid->origin = mBoundsMin;
+    grid->cellSize = glm::max((mBoundsMax - mBoundsMin) / (float) res, Vector2f(1e-20f));
+
+    /* Counting sort of the points by cell */
+    std::vector<uint32_t> cells(count);
+    grid->cellStart.assign((size_t) res * res + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        Vector2i c = glm::clamp(Vector2i((mPositions[i] - grid->origin) / grid->cellSize),
+                                Vector2i(0), Vector2i(res - 1));
+        cells[i] = (uint32_t) (c.y * res + c.x);
+        grid->cellStart[cells[i] + 1]++;
+        if ((i & 0xFFFFF) == 0 && mCancelIndexer)
+            return;
+    }
+    for (size_t i = 1; i < grid->cellStart.size(); ++i)
+        grid->cellStart[i] += grid->cellStart[i - 1];
+
+    std::vector<uint32_t> cursor(grid->cellStart.begin(), grid->cellStart.end() - 1);
+    grid->indices.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        grid->indices[cursor[cells[i]]++] = (uint32_t) i;
+
+    std::lock_guard<std::mutex> guard(mGridMutex);
+    mPendingGrid = std::move(grid);
+}
+
+bool ScatterPlot::pickingReady() {
+    if (!mGrid) {
+        std::lock_guard<std::mutex> guard(mGridMutex);
+        mGrid = std::move(mPendingGrid);
+    }
+    return (bool) mGrid;
+}
+
+Vector2f ScatterPlot::toData(const Vector2i &p) const {
+    Vector2f rel = Vector2f(p - mPos) / glm::max(Vector2f(mSize), Vector2f(1.f));
+    return Vector2f(mViewMin.x + rel.x * (mViewMax.x - mViewMin.x),
+                    mViewMax.y - rel.y * (mViewMax.y - mViewMin.y));
+}
+
+Vector2f ScatterPlot::toScreen(const Vector2f &v) const {
+    Vector2f rel((v.x - mViewMin.x) / (mViewMax.x - mViewMin.x),
+                 (mViewMax.y - v.y) / (mViewMax.y - mViewMin.y));
+    return Vector2f(mPos) + rel * Vector2f(mSize);
+}
+
+int ScatterPlot::pick(const Vector2i &p, float radius) {
+    if (!pickingReady() || mSize.x <= 0 || mSize.y <= 0)
+        return -1;
+
+    const PickGrid &grid = *mGrid;
+    Vector2f center = toData(p);
+    Vector2f perPixel = (mViewMax - mViewMin) / Vector2f(mSize);
+    Vector2f extent = perPixel * radius;
+
+    Vector2f c0 = glm::floor((center - extent - grid.origin) / grid.cellSize);
+    Vector2f c1 = glm::floor((center + extent - grid.origin) / grid.cellSize);
+    if (c1.x < 0 || c1.y < 0 || c0.x >= grid.resolution.x || c0.y >= grid.resolution.y)
+        return -1;
+    Vector2i i0 = glm::max(Vector2i(c0), Vector2i(0));
+    Vector2i i1 = glm::min(Vector2i(c1), grid.resolution - 1);
+
+    int best = -1;
+    float bestDist = radius * radius;
+    for (int y = i0.y; y <= i1.y; ++y) {
+        for (int x = i0.x; x <= i1.x; ++x) {
+            uint32_t cell = (uint32_t) (y * grid.resolution.x + x);
+            for (uint32_t k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; ++k) {
+                uint32_t index = grid.indices[k];
+                Vector2f d = (mPositions[index] - center) / perPixel;
+                float dist = glm::dot(d, d);
+                if (dist <= bestDist) {
+                    bestDist = dist;
+                    best = (int) index;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+void ScatterPlot::uploadPoints() {
+    mShader.bind();
+    mShader.uploadAttrib("position", mPositions);
+
+    /* Integral attributes are uploaded as normalized, so colors arrive in [0, 1] */
+    if (!mPendingColors.empty()) {
+        mShader.uploadAttrib<uint8_t, 4>("color", mPendingColors);
+    } else if (mShader.hasAttrib("color")) {
+        mShader.freeAttrib("color");
+        glDisableVertexAttribArray(mShader.attrib("color"));
+    }
+
+    if (!mPendingSizes.empty()) {
+        mShader.uploadAttrib("size", mPendingSizes);
+    } else if (mShader.hasAttrib("size")) {
+        mShader.freeAttrib("size");
+        glDisableVertexAttribArray(mShader.attrib("size"));
+    }
+
+    /* The GPU holds the only copy of colors and sizes; positions are kept for picking */
+    std::vector<uint8_t>().swap(mPendingColors);
+    std::vector<float>().swap(mPendingSizes);
+    mUploadPending = false;
+}
+
+void ScatterPlot::renderPoints(NVGcontext *ctx) {
+    float ratio = screen()->pixelRatio();
+    if (mOffscreen.prepare(ctx, mSize, ratio, NVG_IMAGE_PREMULTIPLIED))
+        mDirty = true;
+
+    if (mShader.name().empty())
+        mShader.init("scatterplot", scatterVertexShader, scatterFragmentShader);
+    if (mUploadPending) {
+        uploadPoints();
+        mDirty = true;
+    }
+    if (!mDirty)
+        return;
+
+    mOffscreen.begin();
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    GLState::enable(GL_BLEND);
+    GLState::blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::enable(GL_PROGRAM_POINT_SIZE);
+
+    /* Texture row 0 is shown at the top, so the y axis is flipped */
+    Vector2f extent = mViewMax - mViewMin;
+    mShader.bind();
+    mShader.setUniform("scale", Vector2f(2.f / extent.x, -2.f / extent.y));
+    mShader.setUniform("offset", Vector2f(-1.f - 2.f * mViewMin.x / extent.x,
+                                          1.f + 2.f * mViewMin.y / extent.y));
+    mShader.setUniform("pixelRatio", ratio);
+
+    /* Constant values for attributes without a buffer */
+    if (!mShader.hasAttrib("color"))
+        glVertexAttrib4fv(mShader.attrib("color"), &mPointColor[0]);
+    if (!mShader.hasAttrib("size"))
+        glVertexAttrib1f(mShader.attrib("size"), mPointSize);
+
+    mShader.drawArray(GL_POINTS, 0, (uint32_t) mPositions.size());
+
+    GLState::disable(GL_PROGRAM_POINT_SIZE);
+    mOffscreen.end();
+
+    mDirty = false;
+}
+
+Vector2i ScatterPlot::preferredSize(NVGcontext *) {
+    return Vector2i(300, 300);
+}
+
+bool ScatterPlot::mouseButtonEvent(const Vector2i &p, int button, bool down, int modifiers) {
+    Widget::mouseButtonEvent(p, button, down, modifiers);
+    return true;
+}
+
+bool ScatterPlot::mouseMotionEvent(const Vector2i &p, const Vector2i & /* rel */,
+                                   int /* button */, int /* modifiers */) {
+    int index = pick(p, mPointSize * 0.5f + 3.f);
+    if (index != mHoverIndex) {
+        mHoverIndex = index;
+        if (mHoverCallback)
+            mHoverCallback(index);
+    }
+    return true;
+}
+
+bool ScatterPlot::mouseDragEvent(const Vector2i & /* p */, const Vector2i &rel,
+                                 int /* button */, int /* modifiers */) {
+    Vector2f perPixel = (mViewMax - mViewMin) / glm::max(Vector2f(mSize), Vector2f(1.f));
+    Vector2f shift(-rel.x * perPixel.x, rel.y * perPixel.y);
+    setView(mViewMin + shift, mViewMax + shift);
+    return true;
+}
+
+bool ScatterPlot::mouseEnterEvent(const Vector2i &p, bool enter) {
+    Widget::mouseEnterEvent(p, enter);
+    if (!enter && mHoverIndex != -1) {
+        mHoverIndex = -1;
+        if (mHoverCallback)
+            mHoverCallback(-1);
+    }
+    return true;
+}
+
+bool ScatterPlot::scrollEvent(const Vector2i &p, const Vector2f &rel) {
+    Vector2f center = toData(p);
+    float scale = std::pow(1.2f, -rel.y);
+    setView(center + (mViewMin - center) * scale, center + (mViewMax - center) * scale);
+    return true;
+}
+
+void ScatterPlot::draw(NVGcontext *ctx) {
+    Widget::draw(ctx);
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillColor(ctx, mBackgroundColor);
+    nvgFill(ctx);
+
+    if (!mPositions.empty() || mUploadPending) {
+        renderPoints(ctx);
+        NVGpaint paint = mOffscreen.paint(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+        nvgBeginPath(ctx);
+        nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+        nvgFillPaint(ctx, paint);
+        nvgFill(ctx);
+    }
+
+    if (mHoverIndex >= 0 && mHoverIndex < (int) mPositions.size()) {
+        const Vector2f &v = mPositions[mHoverIndex];
+        Vector2f s = toScreen(v);
+
+        nvgBeginPath(ctx);
+        nvgCircle(ctx, s.x, s.y, mPointSize * 0.5f + 3.f);
+        nvgStrokeColor(ctx, Color(255, 255));
+        nvgStroke(ctx);
+
+        char buf[64];
+        snprintf(buf, sizeof(buf), "#%i: (%g, %g)", mHoverIndex, v.x, v.y);
+        nvgFontFace(ctx, "sans");
+        nvgFontSize(ctx, 14.0f);
+        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
+        float width = nvgTextBounds(ctx, 0, 0, buf, NULL, NULL);
+        float tx = std::min(s.x + 6, mPos.x + mSize.x - width - 4);
+        float ty = std::max(s.y - 6, mPos.y + 18.f);
+        nvgBeginPath(ctx);
+        nvgRoundedRect(ctx, tx - 3, ty - 17, width + 6, 18, 3);
+        nvgFillColor(ctx, Color(0, 200));
+        nvgFill(ctx);
+        nvgFillColor(ctx, Color(240, 255));
+        nvgText(ctx, tx, ty, buf, NULL);
+    }
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgStrokeColor(ctx, Color(100, 255));
+    nvgStroke(ctx);
+}
+
+NAMESPACE_END(nanogui)
@@ -16,6 +16,9 @@
 #include <nanogui/opengl.h>
 #include <nanogui/window.h>
 #include <nanogui/popup.h>
+#include <nanogui/imagecache.h>
+#include <nanogui/glrendertarget.h>
+#include <nanogui/screenrecorder.h>
 #include <iostream>
 #include <map>
 
@@ -211,13 +214,25 @@ void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct) {
 }
 
 Screen::~Screen() {
+    /* Queries, buffers, render targets and images belong to this context */
+    if (mGLFWWindow)
+        glfwMakeContextCurrent(mGLFWWindow);
+
     __nanogui_screens.erase(mGLFWWindow);
+    GLState::release(mGLFWWindow);
     for (int i=0; i < (int) Cursor::CursorCount; ++i) {
         if (mCursors[i])
             glfwDestroyCursor(mCursors[i]);
     }
-    if (mNVGContext)
+    if (mGpuTimer)
+        mGpuTimer->free();
+    if (mRecorder)
+        mRecorder->finish();
+    if (mNVGContext) {
+        GLRenderTargetPool::release(mNVGContext);
+        ImageCache::release(mNVGContext);
         nvgDeleteGL3(mNVGContext);
+    }
     if (mGLFWWindow && mShutdownGLFWOnDestruct)
         glfwDestroyWindow(mGLFWWindow);
 }
@@ -245,13 +260,58 @@ void Screen::setSize(const Vector2i &size) {
     glfwSetWindowSize(mGLFWWindow, size.x, size.y);
 }
 
+GLRenderTargetPool *Screen::renderTargetPool() {
+    return GLRenderTargetPool::get(mNVGContext);
+}
+
+void Screen::setGpuTiming(bool enabled) {
+    if (enabled == (bool) mGpuTimer)
+        return;
+    if (enabled) {
+        mGpuTimer = makeref<GLTimer>();
+        mGpuPhases[0] = mGpuTimer->phase("drawContents");
+        mGpuPhases[1] = mGpuTimer->phase("widgets");
+        mGpuPhases[2] = mGpuTimer->phase("swap");
+    } else {
+        glfwMakeContextCurrent(mGLFWWindow);
+        mGpuTimer->free();
+        mGpuTimer = nullptr;
+    }
+}
+
+void Screen::setRecorder(ref<ScreenRecorder> recorder) {
+    if (recorder == mRecorder)
+        return;
+    if (mRecorder) {
+        glfwMakeContextCurrent(mGLFWWindow);
+        mRecorder->finish();
+    }
+    mRecorder = recorder;
+}
+
 void Screen::drawAll() {
+    /* Everything below, including the per-context state tracker and the
+       timer queries, acts on the current context */
+    glfwMakeContextCurrent(mGLFWWindow);
+
+    GLState::beginFrame();
+    if (mGpuTimer)
+        mGpuTimer->beginFrame();
+
     glClearColor(mBackground[0], mBackground[1], mBackground[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    drawContents();
+    {
+        GLTimer::Scope scope(mGpuTimer.get(), mGpuPhases[0]);
+        drawContents();
+    }
+
     drawWidgets();
 
+    if (mRecorder && mVisible)
+        mRecorder->capture(mFBSize);
+
+    GLTimer::Scope scope(mGpuTimer.get(), mGpuPhases[2]);
     glfwSwapBuffers(mGLFWWindow);
 }
 
@@ -262,10 +322,18 @@ void Screen::drawWidgets() {
     glfwMakeContextCurrent(mGLFWWindow);
     glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
     glfwGetWindowSize(mGLFWWindow, &mSize[0], &mSize[1]);
-    glViewport(0, 0, mFBSize[0], mFBSize[1]);
+
+    /* Widgets only change the OpenGL state through the tracker, so redundant
+       calls can be skipped; entering the scope forgets what drawContents()
+       may have changed */
+    GLState::Scope tracked;
+    GLState::viewport(0, 0, mFBSize[0], mFBSize[1]);
 
     /* Calculate pixel ratio for hi-dpi devices. */
     mPixelRatio = (float) mFBSize[0] / (float) mSize[0];
+    imageCache()->beginFrame();
+    if (GLRenderTargetPool *pool = GLRenderTargetPool::get(mNVGContext, false))
+        pool->beginFrame();
     nvgBeginFrame(mNVGContext, mSize[0], mSize[1], mPixelRatio);
 
     draw(mNVGContext);
@@ -312,7 +380,13 @@ void Screen::drawWidgets() {
         }
     }
 
-    nvgEndFrame(mNVGContext);
+    {
+        GLTimer::Scope scope(mGpuTimer.get(), mGpuPhases[1]);
+        nvgEndFrame(mNVGContext);
+    }
+
+    /* NanoVG sets up its own state without the tracker, which is fine since
+       the tracked scope ends here */
 }
 
 bool Screen::keyboardEvent(int key, int scancode, int action, int modifiers) {
@@ -512,7 +586,8 @@ void Screen::disposeWindow(ref<Window> window) {
 
 void Screen::centerWindow(ref<Window> window) {
     if (window->size() == Vector2i(0)) {
-        window->setSize(window->preferredSize(mNVGContext));
+        LayoutPass pass;
+        window->setSize(window->measure(mNVGContext));
         window->performLayout(mNVGContext);
     }
     window->setPosition((mSize - window->size()) / 2);
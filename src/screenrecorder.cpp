@@ -0,0 +1,387 @@
+/*
+    src/screenrecorder.cpp -- Records the frames shown by a screen to
+    disk without stalling the render loop
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/screenrecorder.h>
+#include <nanogui/glutil.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+NAMESPACE_BEGIN(nanogui)
+
+static double currentTime() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+    struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+    static const Table table;
+    for (size_t i = 0; i < size; ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t adler32(uint32_t adler, const uint8_t *data, size_t size) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+        /* Largest run for which the sums cannot overflow before the modulo */
+        size_t run = std::min(size, (size_t) 5552);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+/* Writes PNG chunks and keeps track of their checksums */
+struct PNGWriter {
+    FILE *file;
+    uint32_t crc = 0;
+    bool success = true;
+
+    PNGWriter(FILE *file) : file(file) { }
+
+    void put(const void *data, size_t size) {
+        success &= fwrite(data, 1, size, file) == size;
+        crc = crc32(crc, (const uint8_t *) data, size);
+    }
+
+    void put32(uint32_t value) {
+        uint8_t bytes[4] = { (uint8_t) (value >> 24), (uint8_t) (value >> 16),
+                             (uint8_t) (value >> 8), (uint8_t) value };
+        put(bytes, 4);
+    }
+
+    void beginChunk(const char *type, uint32_t length) {
+        put32(length);
+        crc = 0xFFFFFFFFu;
+        put(type, 4);
+    }
+
+    void endChunk() {
+        put32(~crc);
+    }
+};
+
+ScreenRecorder::ScreenRecorder(const std::string &prefix, Format format, int depth)
+    : mPrefix(prefix), mFormat(format), mSlots(std::max(depth, 1)), mFrame(0),
+      mWritten(0), mStop(false) {
+    mWorker = std::thread([this]() { worker(); });
+}
+
+ScreenRecorder::~ScreenRecorder() {
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mStop = true;
+    }
+    mCondition.notify_all();
+    mWorker.join();
+}
+
+std::string ScreenRecorder::fileName(uint64_t frame) const {
+    char number[32];
+    snprintf(number, sizeof(number), "%06llu", (unsigned long long) frame);
+    return mPrefix + number + (mFormat == Format::PNG ? ".png" : ".raw");
+}
+
+void ScreenRecorder::capture(const Vector2i &size) {
+    double start = currentTime();
+
+    reclaim();
+
+    /* Hand completed readbacks to the writer, oldest first */
+    while (!mReading.empty()) {
+        Slot &slot = mSlots[mReading.front()];
+        /* The first poll flushes, so that the fence is guaranteed to signal eventually */
+        GLenum result = glClientWaitSync(slot.fence, slot.flushed ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        slot.flushed = true;
+        if (result == GL_WAIT_FAILED)
+            throw std::runtime_error("ScreenRecorder::capture(): glClientWaitSync() failed!");
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            break;
+        bool mapped = submit(mReading.front());
+        mReading.pop_front();
+        if (!mapped)
+            throw std::runtime_error("ScreenRecorder: could not map a pixel pack buffer!");
+    }
+
+    int index = -1;
+    for (size_t i = 0; i < mSlots.size() && index < 0; ++i)
+        if (mSlots[i].state == SlotState::Free)
+            index = (int) i;
+
+    if (index < 0 || size.x <= 0 || size.y <= 0) {
+        if (index < 0)
+            mStatistics.dropped++;
+    } else {
+        Slot &slot = mSlots[index];
+        size_t bytes = (size_t) size.x * (size_t) size.y * 4;
+        if (slot.buffer == 0)
+            glGenBuffers(1, &slot.buffer);
+        GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (bytes != slot.capacity) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+
+        GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        /* A bound pixel pack buffer would redirect glReadPixels() calls of other code */
+        GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.flushed = false;
+        slot.size = size;
+        slot.frame = mFrame++;
+        slot.state = SlotState::Reading;
+        mReading.push_back(index);
+        mStatistics.captured++;
+    }
+
+    mStatistics.lastTime = currentTime() - start;
+    mStatistics.maxTime = std::max(mStatistics.maxTime, mStatistics.lastTime);
+}
+
+bool ScreenRecorder::submit(int index) {
+    Slot &slot = mSlots[index];
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    size_t bytes = (size_t) slot.size.x * (size_t) slot.size.y * 4;
+    const void *ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!ptr) {
+        slot.state = SlotState::Free;
+        return false;
+    }
+
+    slot.state = SlotState::Writing;
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mJobs.push_back(Job{ index, (const uint8_t *) ptr, slot.size, slot.frame });
+    }
+    mCondition.notify_all();
+    return true;
+}
+
+void ScreenRecorder::reclaim() {
+    std::vector<int> done;
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        done.swap(mDone);
+        mStatistics.written = mWritten;
+    }
+    for (int index : done) {
+        Slot &slot = mSlots[index];
+        GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        slot.state = SlotState::Free;
+    }
+    if (!done.empty())
+        GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ScreenRecorder::finish() {
+    /* Also runs from ~Screen(), so failures drop the frame instead of throwing */
+    while (!mReading.empty()) {
+        Slot &slot = mSlots[mReading.front()];
+        GLenum result;
+        do {
+            result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+
+        const char *error = nullptr;
+        if (result == GL_WAIT_FAILED) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            slot.state = SlotState::Free;
+            error = "ScreenRecorder::finish(): glClientWaitSync() failed!";
+        } else if (!submit(mReading.front())) {
+            error = "ScreenRecorder: could not map a pixel pack buffer!";
+        }
+        mReading.pop_front();
+
+        if (error) {
+            mStatistics.dropped++;
+            std::lock_guard<std::mutex> guard(mMutex);
+            mError = error;
+        }
+    }
+
+    while (true) {
+        reclaim();
+        bool writing = false;
+        for (const Slot &slot : mSlots)
+            writing |= slot.state == SlotState::Writing;
+        if (!writing)
+            break;
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]() { return !mDone.empty(); });
+    }
+
+    for (Slot &slot : mSlots) {
+        if (slot.buffer) {
+            GLState::forget(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slot = Slot();
+    }
+}
+
+ScreenRecorder::Statistics ScreenRecorder::statistics() {
+    std::lock_guard<std::mutex> guard(mMutex);
+    mStatistics.written = mWritten;
+    return mStatistics;
+}
+
+std::string ScreenRecorder::error() {
+    std::lock_guard<std::mutex> guard(mMutex);
+    return mError;
+}
+
+void ScreenRecorder::worker() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+            if (mStop)
+                return;
+            job = mJobs.front();
+            mJobs.pop_front();
+        }
+
+        std::string error;
+        try {
+            if (mFormat == Format::PNG)
+                writePNG(fileName(job.frame), job.data, job.size);
+            else
+                writeRaw(fileName(job.frame), job.data, job.size);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(mMutex);
+            mDone.push_back(job.slot);
+            if (error.empty())
+                mWritten++;
+            else
+                mError = error;
+        }
+        mCondition.notify_all();
+    }
+}
+
+void ScreenRecorder::writePNG(const std::string &fileName, const uint8_t *data,
+                              const Vector2i &size) {
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("ScreenRecorder: could not create \"" + fileName + "\"!");
+
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    PNGWriter png(file);
+    png.put(signature, 8);
+
+    png.beginChunk("IHDR", 13);
+    png.put32((uint32_t) size.x);
+    png.put32((uint32_t) size.y);
+    const uint8_t format[5] = { 8, 2, 0, 0, 0 }; /* 8 bit RGB, no interlacing */
+    png.put(format, 5);
+    png.endChunk();
+
+    /* A zlib stream of stored deflate blocks: each row is a filter byte
+       followed by the pixels, and blocks hold at most 65535 bytes */
+    size_t rowSize = 1 + 3 * (size_t) size.x;
+    size_t total = rowSize * (size_t) size.y;
+    size_t blocks = std::max((total + 65534) / 65535, (size_t) 1);
+    png.beginChunk("IDAT", (uint32_t) (2 + 5 * blocks + total + 4));
+    const uint8_t header[2] = { 0x78, 0x01 };
+    png.put(header, 2);
+
+    size_t remaining = total, blockLeft = 0;
+    uint32_t adler = 1;
+    auto emit = [&](const uint8_t *bytes, size_t count) {
+        while (count > 0) {
+            if (blockLeft == 0) {
+                blockLeft = std::min(remaining, (size_t) 65535);
+                uint16_t len = (uint16_t) blockLeft, nlen = (uint16_t) ~len;
+                uint8_t block[5] = { (uint8_t) (remaining == blockLeft ? 1 : 0),
+                                     (uint8_t) len, (uint8_t) (len >> 8),
+                                     (uint8_t) nlen, (uint8_t) (nlen >> 8) };
+                png.put(block, 5);
+            }
+            size_t n = std::min(count, blockLeft);
+            png.put(bytes, n);
+            adler = adler32(adler, bytes, n);
+            bytes += n; count -= n;
+            blockLeft -= n; remaining -= n;
+        }
+    };
+
+    /* OpenGL stores the bottom row first */
+    std::vector<uint8_t> row(rowSize);
+    for (int y = size.y - 1; y >= 0; --y) {
+        const uint8_t *src = data + (size_t) y * (size_t) size.x * 4;
+        row[0] = 0;
+        for (int x = 0; x < size.x; ++x)
+            for (int c = 0; c < 3; ++c)
+                row[1 + 3 * x + c] = src[4 * x + c];
+        emit(row.data(), rowSize);
+    }
+    png.put32(adler);
+    png.endChunk();
+
+    png.beginChunk("IEND", 0);
+    png.endChunk();
+
+    bool success = png.success;
+    success &= fclose(file) == 0;
+    if (!success)
+        throw std::runtime_error("ScreenRecorder: could not write \"" + fileName + "\"!");
+}
+
+void ScreenRecorder::writeRaw(const std::string &fileName, const uint8_t *data,
+                              const Vector2i &size) {
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("ScreenRecorder: could not create \"" + fileName + "\"!");
+
+    size_t rowSize = (size_t) size.x * 4;
+    bool success = true;
+    for (int y = size.y - 1; y >= 0; --y)
+        success &= fwrite(data + (size_t) y * rowSize, 1, rowSize, file) == rowSize;
+    success &= fclose(file) == 0;
+    if (!success)
+        throw std::runtime_error("ScreenRecorder: could not write \"" + fileName + "\"!");
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,357 @@
+/*
+    src/sparklinegrid.cpp -- Grid of small area charts (sparklines)
+    rendered with a single instanced draw call
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/sparklinegrid.h>
+#include <nanogui/screen.h>
+#include <nanogui/opengl.h>
+#include <limits>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* One instance per sparkline: a triangle strip alternating between the
+   value and the baseline of each sample. The oldest sample is at 'head'. */
+static const char *sparklineVertexShader =
+    "#version 330\n"
+    "uniform samplerBuffer samples;\n"
+    "uniform samplerBuffer ranges;\n"
+    "uniform int seriesCount, historyLength, head, filled;\n"
+    "uniform int firstCell, columns;\n"
+    "uniform vec2 cellSize, cellPitch, origin, targetSize;\n"
+    "uniform float labelHeight;\n"
+    "out float depth;\n"
+    "void main() {\n"
+    "    int cell = firstCell + gl_InstanceID;\n"
+    "    int i = gl_VertexID >> 1;\n"
+    "    float t = 0.0;\n"
+    "    if (i >= historyLength - filled) {\n"
+    "        float v = texelFetch(samples, ((head + i) % historyLength) * seriesCount + cell).r;\n"
+    "        vec2 r = texelFetch(ranges, cell).rg;\n"
+    "        t = r.y > r.x ? clamp((v - r.x) / (r.y - r.x), 0.0, 1.0) : 0.5;\n"
+    "    }\n"
+    "    vec2 base = origin + vec2(cell % columns, cell / columns) * cellPitch;\n"
+    "    float bottom = base.y + cellSize.y;\n"
+    "    float top = bottom - t * (cellSize.y - labelHeight);\n"
+    "    bool isTop = (gl_VertexID & 1) == 0;\n"
+    "    vec2 p = vec2(base.x + cellSize.x * float(i) / float(historyLength - 1),\n"
+    "                  isTop ? top : bottom);\n"
+    "    depth = isTop ? 0.0 : bottom - top;\n"
+    "    gl_Position = vec4(p / targetSize * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}";
+
+/* Line color within ~1.5 pixels of the value, fill color below it */
+static const char *sparklineFragmentShader =
+    "#version 330\n"
+    "uniform vec4 fillColor, lineColor;\n"
+    "in float depth;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    vec4 c = mix(lineColor, fillColor, clamp(depth - 0.5, 0.0, 1.0));\n"
+    "    color = vec4(c.rgb * c.a, c.a);\n"
+    "}";
+
+static const float sparklineLabelHeight = 14.f;
+
+SparklineGrid::SparklineGrid(ref<Widget> parent, int series, int length)
+    : Widget(parent), mSeriesCount(0), mLength(0), mHead(0), mFilled(0),
+      mPendingColumns(0), mRangesDirty(false), mReallocate(false),
+      mCellSize(120, 36), mSpacing(4), mSampleBuffer(0), mSampleTexture(0),
+      mRangeBuffer(0), mRangeTexture(0), mDirty(true) {
+    mFillColor = Color(255, 192, 0, 64);
+    mLineColor = Color(255, 192, 0, 255);
+    mBackgroundColor = Color(20, 128);
+    mTextColor = Color(240, 192);
+    resize(series, length);
+}
+
+SparklineGrid::~SparklineGrid() {
+    if (!mOffscreen.releaseIfAlive())
+        return;
+    if (mSampleTexture) {
+        GLuint textures[2] = { mSampleTexture, mRangeTexture };
+        GLuint buffers[2] = { mSampleBuffer, mRangeBuffer };
+        glDeleteTextures(2, textures);
+        glDeleteBuffers(2, buffers);
+    }
+    mShader.free();
+}
+
+void SparklineGrid::resize(int series, int length) {
+    if (series < 0 || length < 2)
+        throw std::runtime_error("SparklineGrid::resize(): invalid size!");
+    mSeriesCount = series;
+    mLength = length;
+    mNames.assign(series, std::string());
+    mValues.assign((size_t) series * length, 0.f);
+    mRanges.assign(series, Vector2f(0.f, 1.f));
+    mAutoRange.assign(series, 1);
+    mRescan.assign(series, 0);
+    mHead = mFilled = mPendingColumns = 0;
+    mReallocate = mRangesDirty = mDirty = true;
+}
+
+void SparklineGrid::push(const float *values) {
+    if (mSeriesCount == 0)
+        return;
+
+    float *column = &mValues[(size_t) mHead * mSeriesCount];
+    bool evict = mFilled == mLength;
+    for (int s = 0; s < mSeriesCount; ++s) {
+        float old = column[s], value = values[s];
+        column[s] = value;
+        if (!mAutoRange[s])
+            continue;
+        Vector2f &range = mRanges[s];
+        if (mFilled == 0) {
+            range = Vector2f(value);
+        } else {
+            /* An extremum leaving the window requires a rescan of the series */
+            if (evict && (old <= range.x || old >= range.y))
+                mRescan[s] = 1;
+            range.x = std::min(range.x, value);
+            range.y = std::max(range.y, value);
+        }
+    }
+
+    mHead = (mHead + 1) % mLength;
+    mFilled = std::min(mFilled + 1, mLength);
+    mPendingColumns = std::min(mPendingColumns + 1, mLength);
+    mRangesDirty = mDirty = true;
+}
+
+float SparklineGrid::latest(int series) const {
+    if (mFilled == 0)
+        return std::numeric_limits<float>::quiet_NaN();
+    return mValues[(size_t) ((mHead + mLength - 1) % mLength) * mSeriesCount + series];
+}
+
+void SparklineGrid::setRange(int series, const Vector2f &range) {
+    mRanges[series] = range;
+    mAutoRange[series] = 0;
+    mRescan[series] = 0;
+    mRangesDirty = mDirty = true;
+}
+
+void SparklineGrid::setAutoRange(int series) {
+    mAutoRange[series] = 1;
+    mRescan[series] = 1;
+    mRangesDirty = mDirty = true;
+}
+
+int SparklineGrid::gridColumns() const {
+    int width = mSize.x > 0 ? mSize.x : 4 * (mCellSize.x + mSpacing) + mSpacing;
+    return std::max(1, (width - mSpacing) / (mCellSize.x + mSpacing));
+}
+
+Vector2i SparklineGrid::preferredSize(NVGcontext *) {
+    int columns = gridColumns();
+    int rows = (mSeriesCount + columns - 1) / columns;
+    Vector2i pitch = mCellSize + Vector2i(mSpacing);
+    return Vector2i(std::min(columns, std::max(mSeriesCount, 1)) * pitch.x,
+                    rows * pitch.y) + Vector2i(mSpacing);
+}
+
+void SparklineGrid::visibleRegion(Vector2i &min, Vector2i &max) const {
+    Vector2i offset = absolutePosition();
+    min = offset;
+    max = offset + mSize;
+    for (ref<const Widget> w = parent(); w; w = w->parent()) {
+        Vector2i p = w->absolutePosition();
+        min = glm::max(min, p);
+        max = glm::min(max, p + w->size());
+    }
+    min -= offset;
+    max = glm::max(max - offset, min);
+}
+
+void SparklineGrid::uploadData() {
+    if (mReallocate) {
+        if (!mSampleTexture) {
+            glGenBuffers(1, &mSampleBuffer);
+            glGenBuffers(1, &mRangeBuffer);
+            glGenTextures(1, &mSampleTexture);
+            glGenTextures(1, &mRangeTexture);
+        }
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, mSampleBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(mValues.size(), (size_t) 1) * sizeof(float),
+                     mValues.empty() ? nullptr : mValues.data(), GL_DYNAMIC_DRAW);
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, mRangeBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(mRanges.size(), (size_t) 1) * sizeof(Vector2f),
+                     nullptr, GL_DYNAMIC_DRAW);
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, mSampleTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, mSampleBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, mRangeTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, mRangeBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        mPendingColumns = 0;
+        mRangesDirty = true;
+        mReallocate = false;
+    }
+
+    if (mPendingColumns > 0) {
+        /* The new columns are contiguous, except when they wrap around */
+        size_t columnSize = (size_t) mSeriesCount * sizeof(float);
+        int first = (mHead - mPendingColumns + mLength) % mLength;
+        int count = std::min(mPendingColumns, mLength - first);
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, mSampleBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, first * columnSize, count * columnSize,
+                        &mValues[(size_t) first * mSeriesCount]);
+        if (count < mPendingColumns)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, (mPendingColumns - count) * columnSize,
+                            mValues.data());
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, 0);
+        mPendingColumns = 0;
+    }
+
+    for (int s = 0; s < mSeriesCount; ++s) {
+        if (!mRescan[s])
+            continue;
+        Vector2f range(std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+        for (int i = 0; i < mFilled; ++i) {
+            float value = mValues[(size_t) i * mSeriesCount + s];
+            range.x = std::min(range.x, value);
+            range.y = std::max(range.y, value);
+        }
+        mRanges[s] = mFilled > 0 ? range : Vector2f(0.f, 1.f);
+        mRescan[s] = 0;
+        mRangesDirty = true;
+    }
+
+    if (mRangesDirty && mSeriesCount > 0) {
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, mRangeBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, mRanges.size() * sizeof(Vector2f), mRanges.data());
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    mRangesDirty = false;
+}
+
+void SparklineGrid::renderCharts(NVGcontext *ctx, const Vector2i &min, const Vector2i &max) {
+    /* The shader works in logical coordinates; only the viewport is scaled */
+    Vector2i extent = max - min;
+    if (mOffscreen.prepare(ctx, extent, screen()->pixelRatio(), NVG_IMAGE_PREMULTIPLIED))
+        mDirty = true;
+
+    if (!mDirty && min == mRenderedMin && max == mRenderedMax)
+        return;
+
+    if (mShader.name().empty())
+        mShader.init("sparklinegrid", sparklineVertexShader, sparklineFragmentShader);
+    uploadData();
+
+    int columns = gridColumns();
+    Vector2i pitch = mCellSize + Vector2i(mSpacing);
+    int firstRow = std::max(0, (min.y - mSpacing) / pitch.y);
+    int lastRow = (max.y - mSpacing) / pitch.y + 1;
+    int firstCell = std::min(firstRow * columns, mSeriesCount);
+    int lastCell = std::min(lastRow * columns, mSeriesCount);
+
+    mOffscreen.begin();
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    GLState::enable(GL_BLEND);
+    GLState::blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (lastCell > firstCell) {
+        mShader.bind();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, mSampleTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, mRangeTexture);
+        mShader.setUniform("samples", 0);
+        mShader.setUniform("ranges", 1);
+        mShader.setUniform("seriesCount", mSeriesCount);
+        mShader.setUniform("historyLength", mLength);
+        mShader.setUniform("head", mHead);
+        mShader.setUniform("filled", mFilled);
+        mShader.setUniform("firstCell", firstCell);
+        mShader.setUniform("columns", columns);
+        mShader.setUniform("cellSize", Vector2f(mCellSize));
+        mShader.setUniform("cellPitch", Vector2f(pitch));
+        mShader.setUniform("origin", Vector2f(Vector2i(mSpacing) - min));
+        mShader.setUniform("targetSize", Vector2f(glm::max(extent, Vector2i(1))));
+        mShader.setUniform("labelHeight", sparklineLabelHeight);
+        mShader.setUniform("fillColor", Vector4f(mFillColor));
+        mShader.setUniform("lineColor", Vector4f(mLineColor));
+
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * mLength, lastCell - firstCell);
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    mOffscreen.end();
+
+    mRenderedMin = min;
+    mRenderedMax = max;
+    mDirty = false;
+}
+
+void SparklineGrid::draw(NVGcontext *ctx) {
+    Widget::draw(ctx);
+
+    Vector2i min, max;
+    visibleRegion(min, max);
+    if (mSeriesCount == 0 || glm::any(glm::greaterThanEqual(min, max)))
+        return;
+
+    int columns = gridColumns();
+    Vector2i pitch = mCellSize + Vector2i(mSpacing);
+    int firstRow = std::max(0, (min.y - mSpacing) / pitch.y);
+    int lastRow = (max.y - mSpacing) / pitch.y + 1;
+    int firstCell = std::min(firstRow * columns, mSeriesCount);
+    int lastCell = std::min(lastRow * columns, mSeriesCount);
+
+    /* Cell backgrounds as a single path */
+    nvgBeginPath(ctx);
+    for (int cell = firstCell; cell < lastCell; ++cell) {
+        Vector2i p = mPos + Vector2i(mSpacing) + Vector2i(cell % columns, cell / columns) * pitch;
+        nvgRect(ctx, p.x, p.y, mCellSize.x, mCellSize.y);
+    }
+    nvgFillColor(ctx, mBackgroundColor);
+    nvgFill(ctx);
+
+    renderCharts(ctx, min, max);
+    Vector2i size = max - min;
+    NVGpaint paint = mOffscreen.paint(ctx, mPos.x + min.x, mPos.y + min.y,
+                                      size.x, size.y);
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x + min.x, mPos.y + min.y, size.x, size.y);
+    nvgFillPaint(ctx, paint);
+    nvgFill(ctx);
+
+    /* Labels: font state is set up once for all names, then for all values */
+    nvgFontFace(ctx, "sans");
+    nvgFontSize(ctx, 13.0f);
+    nvgFillColor(ctx, mTextColor);
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    for (int cell = firstCell; cell < lastCell; ++cell) {
+        if (mNames[cell].empty())
+            continue;
+        Vector2i p = mPos + Vector2i(mSpacing) + Vector2i(cell % columns, cell / columns) * pitch;
+        nvgText(ctx, p.x + 2, p.y + 1, mNames[cell].c_str(), NULL);
+    }
+
+    if (mFilled > 0) {
+        nvgTextAlign(ctx, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+        char buf[32];
+        for (int cell = firstCell; cell < lastCell; ++cell) {
+            Vector2i p = mPos + Vector2i(mSpacing) + Vector2i(cell % columns, cell / columns) * pitch;
+            snprintf(buf, sizeof(buf), "%.4g", latest(cell));
+            nvgText(ctx, p.x + mCellSize.x - 2, p.y + 1, buf, NULL);
+        }
+    }
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,369 @@
+/*
+    src/videoview.cpp -- Widget which displays a live stream of frames
+    (video playback, camera feeds) submitted from arbitrary threads
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/videoview.h>
+#include <nanogui/opengl.h>
+#include <cstring>
+
+#define NANOVG_GL3 1
+#include <nanovg_gl.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+static const char *convertFragmentShader =
+    "#version 330\n"
+    "uniform sampler2D planeY, planeU, planeV;\n"
+    "uniform int interleaved;\n"
+    "uniform vec4 coeffs; /* (V->R, U->G, V->G, U->B) */\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    float y = texture(planeY, uv).r;\n"
+    "    vec2 c = interleaved != 0 ? texture(planeU, uv).rg\n"
+    "                              : vec2(texture(planeU, uv).r, texture(planeV, uv).r);\n"
+    "    y = (y - 16.0 / 255.0) * (255.0 / 219.0);\n"
+    "    c = (c - 128.0 / 255.0) * (255.0 / 224.0);\n"
+    "    vec3 rgb = vec3(y + coeffs.x * c.y,\n"
+    "                    y - coeffs.y * c.x - coeffs.z * c.y,\n"
+    "                    y + coeffs.w * c.x);\n"
+    "    color = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+    "}";
+
+VideoView::VideoView(ref<Widget> parent, int bufferCount)
+    : Widget(parent), mSlots(std::max(bufferCount, 2)), mFallbackSize(0),
+      mFallbackFormat(PixelFormat::RGBA8), mFallbackSequence(0),
+      mHasFallback(false), mRequestedSize(0),
+      mRequestedFormat(PixelFormat::RGBA8), mSequence(0), mContext(nullptr),
+      mImage(0), mFrameSize(0),
+      mFrameFormat(PixelFormat::RGBA8), mColorSpace(ColorSpace::BT709),
+      mDirty(false), mDisplayedFrames(0), mDroppedFrames(0) { }
+
+VideoView::~VideoView() {
+    if (!mOffscreen.releaseIfAlive(mContext))
+        return;
+
+    for (Slot &slot : mSlots) {
+        if (!slot.pbo)
+            continue;
+        if (slot.ptr) {
+            GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (mImage)
+        nvgDeleteImage(mContext, mImage);
+    for (int i = 0; i < 3; ++i)
+        mPlanes[i].free();
+    mConvertShader.free();
+}
+
+size_t VideoView::frameBytes(const Vector2i &size, PixelFormat format) {
+    size_t luma = (size_t) size.x * (size_t) size.y;
+    size_t chroma = (size_t) ((size.x + 1) / 2) * (size_t) ((size.y + 1) / 2);
+    switch (format) {
+        case PixelFormat::YUV420P:
+        case PixelFormat::NV12:
+            return luma + 2 * chroma;
+        default:
+            return 4 * luma;
+    }
+}
+
+void VideoView::pushFrame(const uint8_t *data, const Vector2i &size, PixelFormat format) {
+    size_t bytes = frameBytes(size, format);
+    Slot *target = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mRequestedSize = size;
+        mRequestedFormat = format;
+        for (Slot &slot : mSlots) {
+            if (slot.state == SlotState::Mapped && slot.size == size &&
+                slot.format == format) {
+                slot.state = SlotState::Writing;
+                target = &slot;
+                break;
+            }
+        }
+    }
+
+    if (target) {
+        /* Copy straight into the mapped pixel buffer */
+        memcpy(target->ptr, data, bytes);
+
+        std::lock_guard<std::mutex> guard(mMutex);
+        for (Slot &slot : mSlots) {
+            if (slot.state == SlotState::Ready) {
+                /* Superseded, still mapped: recycle it right away */
+                slot.state = SlotState::Mapped;
+                mDroppedFrames++;
+            }
+        }
+        target->sequence = ++mSequence;
+        target->state = SlotState::Ready;
+    } else {
+        /* No buffer of this layout is mapped yet (first frame, layout
+           change, or the UI thread is behind): keep a CPU copy */
+        std::vector<uint8_t> copy(data, data + bytes);
+
+        std::lock_guard<std::mutex> guard(mMutex);
+        if (mHasFallback)
+            mDroppedFrames++;
+        mFallback.swap(copy);
+        mFallbackSize = size;
+        mFallbackFormat = format;
+        mFallbackSequence = ++mSequence;
+        mHasFallback = true;
+    }
+
+    /* Wake up the main loop so that the frame is shown */
+    glfwPostEmptyEvent();
+}
+
+void VideoView::initPlanes(const Vector2i &size, PixelFormat format) {
+    Vector2i chroma((size.x + 1) / 2, (size.y + 1) / 2);
+
+    switch (format) {
+        case PixelFormat::RGBA8:
+            mPlanes[0].init(size, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+            mPlanes[1].free();
+            mPlanes[2].free();
+            break;
+
+        case PixelFormat::YUV420P:
+            mPlanes[0].init(size, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+            mPlanes[1].init(chroma, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+            mPlanes[2].init(chroma, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+            break;
+
+        case PixelFormat::NV12:
+            mPlanes[0].init(size, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+            mPlanes[1].init(chroma, GL_RG8, GL_RG, GL_UNSIGNED_BYTE);
+            mPlanes[2].free();
+            break;
+    }
+
+    if (format == PixelFormat::RGBA8) {
+        /* Shown directly: wrap the plane texture in a NanoVG handle */
+        mOffscreen.release();
+        if (size != mFrameSize || format != mFrameFormat || !mImage) {
+            if (mImage)
+                nvgDeleteImage(mContext, mImage);
+            mImage = nvglCreateImageFromHandleGL3(mContext, mPlanes[0].id(), size.x,
+                                                  size.y, NVG_IMAGE_NODELETE);
+        }
+    } else if (mImage) {
+        /* Converted into the offscreen target in draw() */
+        nvgDeleteImage(mContext, mImage);
+        mImage = 0;
+    }
+
+    mFrameSize = size;
+    mFrameFormat = format;
+}
+
+void VideoView::uploadPlanes(const uint8_t *data) {
+    size_t luma = (size_t) mFrameSize.x * (size_t) mFrameSize.y;
+    size_t chroma = (size_t) mPlanes[1].size().x * (size_t) mPlanes[1].size().y;
+
+    mPlanes[0].update(data);
+    if (mFrameFormat == PixelFormat::YUV420P) {
+        mPlanes[1].update(data + luma);
+        mPlanes[2].update(data + luma + chroma);
+    } else if (mFrameFormat == PixelFormat::NV12) {
+        mPlanes[1].update(data + luma);
+    }
+}
+
+bool VideoView::uploadFrame() {
+    Slot *ready = nullptr;
+    std::vector<uint8_t> fallback;
+    Vector2i fallbackSize;
+    PixelFormat fallbackFormat = PixelFormat::RGBA8;
+
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        for (Slot &slot : mSlots)
+            if (slot.state == SlotState::Ready)
+                ready = &slot;
+
+        if (mHasFallback) {
+            if (ready && ready->sequence > mFallbackSequence) {
+                mDroppedFrames++;
+            } else {
+                if (ready) {
+                    ready->state = SlotState::Mapped;
+                    mDroppedFrames++;
+                    ready = nullptr;
+                }
+                fallback.swap(mFallback);
+                fallbackSize = mFallbackSize;
+                fallbackFormat = mFallbackFormat;
+            }
+            mHasFallback = false;
+        }
+
+        if (ready)
+            ready->state = SlotState::Free;
+    }
+
+    if (ready) {
+        /* Asynchronous transfer from the pixel buffer into the textures */
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, ready->pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        ready->ptr = nullptr;
+        initPlanes(ready->size, ready->format);
+        uploadPlanes(nullptr);
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else if (!fallback.empty()) {
+        initPlanes(fallbackSize, fallbackFormat);
+        uploadPlanes(fallback.data());
+    } else {
+        return false;
+    }
+
+    mDisplayedFrames++;
+    return true;
+}
+
+void VideoView::mapSlots() {
+    std::vector<Slot *> slots;
+    Vector2i size;
+    PixelFormat format;
+
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        size = mRequestedSize;
+        format = mRequestedFormat;
+        if (size.x <= 0 || size.y <= 0)
+            return;
+        for (Slot &slot : mSlots) {
+            if (slot.state == SlotState::Mapped &&
+                (slot.size != size || slot.format != format))
+                slot.state = SlotState::Free; /* Stale layout, take it back */
+            if (slot.state == SlotState::Free)
+                slots.push_back(&slot);
+        }
+    }
+
+    if (slots.empty())
+        return;
+
+    size_t bytes = frameBytes(size, format);
+    for (Slot *slot : slots) {
+        if (!slot->pbo)
+            glGenBuffers(1, &slot->pbo);
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+        if (slot->ptr) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            slot->ptr = nullptr;
+        }
+        if (slot->capacity != bytes) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            slot->capacity = bytes;
+        }
+        /* Invalidation lets the driver orphan storage that is still being
+           read by an earlier upload instead of waiting for it */
+        slot->ptr = (uint8_t *) glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        slot->size = size;
+        slot->format = format;
+    }
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    std::lock_guard<std::mutex> guard(mMutex);
+    for (Slot *slot : slots)
+        if (slot->ptr)
+            slot->state = SlotState::Mapped;
+}
+
+void VideoView::convert() {
+    if (mConvertShader.name().empty())
+        mConvertShader.init("videoview_convert",
+                            GLOffscreenTarget::fullscreenVertexShader(),
+                            convertFragmentShader);
+
+    mOffscreen.begin();
+
+    bool interleaved = mFrameFormat == PixelFormat::NV12;
+    Vector4f coeffs = mColorSpace == ColorSpace::BT601
+                          ? Vector4f(1.402f, 0.344136f, 0.714136f, 1.772f)
+                          : Vector4f(1.5748f, 0.187324f, 0.468124f, 1.8556f);
+
+    mConvertShader.bind();
+    mPlanes[0].bind(0);
+    mPlanes[1].bind(1);
+    if (!interleaved)
+        mPlanes[2].bind(2);
+    mConvertShader.setUniform("planeY", 0);
+    mConvertShader.setUniform("planeU", 1);
+    mConvertShader.setUniform("planeV", interleaved ? 1 : 2);
+    mConvertShader.setUniform("interleaved", interleaved ? 1 : 0);
+    mConvertShader.setUniform("coeffs", coeffs);
+    GLOffscreenTarget::drawFullscreen(mConvertShader);
+    if (!interleaved)
+        mPlanes[2].release(2);
+    mPlanes[1].release(1);
+    mPlanes[0].release(0);
+
+    mOffscreen.end();
+}
+
+Vector2i VideoView::preferredSize(NVGcontext *) {
+    if (mFrameSize.x > 0 && mFrameSize.y > 0)
+        return mFrameSize;
+    return Vector2i(320, 180);
+}
+
+void VideoView::draw(NVGcontext *ctx) {
+    mContext = ctx;
+
+    bool uploaded = uploadFrame();
+    bool converted = mFrameFormat != PixelFormat::RGBA8 && mFrameSize.x > 0 &&
+                     mFrameSize.y > 0;
+    if (converted && mOffscreen.prepare(ctx, mFrameSize))
+        mDirty = true;
+    if (uploaded || mDirty) {
+        if (converted)
+            convert();
+        mDirty = false;
+    }
+    mapSlots();
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillColor(ctx, Color(0, 255));
+    nvgFill(ctx);
+
+    if ((converted ? !mOffscreen.image() : !mImage) || mFrameSize.x <= 0 ||
+        mFrameSize.y <= 0)
+        return;
+
+    /* Fit the frame into the widget, preserving its aspect ratio */
+    float scale = std::min(mSize.x / (float) mFrameSize.x,
+                           mSize.y / (float) mFrameSize.y);
+    float w = mFrameSize.x * scale, h = mFrameSize.y * scale;
+    float x = mPos.x + (mSize.x - w) * 0.5f, y = mPos.y + (mSize.y - h) * 0.5f;
+
+    NVGpaint imgPaint = converted ? mOffscreen.paint(ctx, x, y, w, h)
+                                  : nvgImagePattern(ctx, x, y, w, h, 0, mImage, 1.0f);
+    nvgBeginPath(ctx);
+    nvgRect(ctx, x, y, w, h);
+    nvgFillPaint(ctx, imgPaint);
+    nvgFill(ctx);
+}
+
+NAMESPACE_END(nanogui)
@@ -34,11 +34,9 @@ void VScrollPanel::performLayout(NVGcontext *ctx) {
 		return;
 
 	ref<Widget> child = mChildren[0];
-	mChildPreferredHeight = child->preferredSize(ctx).y;
-	child->setPosition(Vector2i(0, 0));
-
-	child->setSize(child->preferredSize(ctx));
-	child->performLayout(ctx);
+	Vector2i childSize = child->measure(ctx);
+	mChildPreferredHeight = childSize.y;
+	child->arrange(ctx, Vector2i(0, 0), childSize);
 }
 
 
@@ -88,7 +86,7 @@ Vector2i VScrollPanel::preferredSize(NVGcontext *ctx) {
 
 	ref<Widget>  child = mChildren[0];
 
-	Vector2i preferredSize = child->preferredSize(ctx) + Vector2i(totalScrollWidth, 0);
+	Vector2i preferredSize = child->measure(ctx) + Vector2i(totalScrollWidth, 0);
 
 	if (preferredSize.y > maxHeight) {
 		preferredSize.y = maxHeight;
@@ -0,0 +1,247 @@
+/*
+    src/waterfall.cpp -- Scrolling heatmap for spectrograms and other
+    waterfall displays
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/waterfall.h>
+#include <nanogui/screen.h>
+#include <nanogui/opengl.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* 'head' is the next row to be written, so the newest row is head - 1.
+   Rows wrap around (GL_REPEAT), which implements the scrolling. */
+static const char *waterfallFragmentShader =
+    "#version 330\n"
+    "uniform sampler2D data;\n"
+    "uniform sampler2D lut;\n"
+    "uniform float head, historyLength, filled;\n"
+    "uniform vec2 range;\n"
+    "uniform int horizontal;\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    float bin = horizontal != 0 ? 1.0 - uv.y : uv.x;\n"
+    "    float age = horizontal != 0 ? 1.0 - uv.x : uv.y;\n"
+    "    float rowsBack = age * (historyLength - 1.0);\n"
+    "    if (rowsBack > filled - 1.0)\n"
+    "        discard;\n"
+    "    float v = texture(data, vec2(bin, (head - 0.5 - rowsBack) / historyLength)).r;\n"
+    "    float t = clamp((v - range.x) / (range.y - range.x), 0.0, 1.0);\n"
+    "    color = texture(lut, vec2(t * (255.0 / 256.0) + 0.5 / 256.0, 0.5));\n"
+    "}";
+
+/* Polynomial fits of the 'Viridis' and 'Turbo' color maps */
+static Vector3f viridis(float x) {
+    const Vector3f c[7] = {
+        Vector3f(0.2777273272f, 0.0054073445f, 0.3340998053f),
+        Vector3f(0.1050930431f, 1.4046135299f, 1.3845901626f),
+        Vector3f(-0.3308618287f, 0.2148475595f, 0.0950951630f),
+        Vector3f(-4.6342304990f, -5.7991009734f, -19.3324409563f),
+        Vector3f(6.2282699363f, 14.1799333668f, 56.6905526007f),
+        Vector3f(4.7763849977f, -13.7451453777f, -65.3530326334f),
+        Vector3f(-5.4354558559f, 4.6458526122f, 26.3124352496f)
+    };
+    Vector3f result = c[6];
+    for (int i = 5; i >= 0; --i)
+        result = result * x + c[i];
+    return result;
+}
+
+static Vector3f turbo(float x) {
+    const float r[6] = { 0.13572138f, 4.61539260f, -42.66032258f, 132.13108234f, -152.94239396f, 59.28637943f };
+    const float g[6] = { 0.09140261f, 2.19418839f, 4.84296658f, -14.18503333f, 4.27729857f, 2.82956604f };
+    const float b[6] = { 0.10667330f, 12.64194608f, -60.58204836f, 110.36276771f, -89.90310912f, 27.34824973f };
+    Vector3f result(r[5], g[5], b[5]);
+    for (int i = 4; i >= 0; --i)
+        result = result * x + Vector3f(r[i], g[i], b[i]);
+    return result;
+}
+
+Waterfall::Waterfall(ref<Widget> parent, int bins, int history)
+    : Widget(parent), mBins(0), mHistory(0), mWakeupPending(false), mHead(0),
+      mFilled(0), mRange(0.f, 1.f), mOrientation(Orientation::Vertical),
+      mReallocate(true),
+      mLutDirty(true), mDirty(true) {
+    mBackgroundColor = Color(20, 128);
+    resize(bins, history);
+    setColormap(Colormap::Viridis);
+}
+
+Waterfall::~Waterfall() {
+    if (!mOffscreen.releaseIfAlive())
+        return;
+    mData.free();
+    mLutTexture.free();
+    mShader.free();
+}
+
+void Waterfall::resize(int bins, int history) {
+    if (bins < 1 || history < 2)
+        throw std::runtime_error("Waterfall::resize(): invalid size!");
+    std::lock_guard<std::mutex> guard(mMutex);
+    mBins = bins;
+    mHistory = history;
+    mPending.clear();
+    mHead = mFilled = 0;
+    mReallocate = mDirty = true;
+}
+
+void Waterfall::pushRow(const float *values) {
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mPending.insert(mPending.end(), values, values + mBins);
+
+        /* Rows which would be overwritten before they are shown are dropped */
+        size_t limit = (size_t) mBins * mHistory;
+        if (mPending.size() > limit)
+            mPending.erase(mPending.begin(), mPending.end() - limit);
+    }
+    if (!mWakeupPending.exchange(true))
+        glfwPostEmptyEvent();
+}
+
+void Waterfall::setRange(const Vector2f &range) {
+    if (!(range.y > range.x))
+        throw std::runtime_error("Waterfall::setRange(): invalid range!");
+    mRange = range;
+    mDirty = true;
+}
+
+void Waterfall::setColormap(Colormap colormap) {
+    mLut.resize(256 * 4);
+    for (int i = 0; i < 256; ++i) {
+        float x = i / 255.f;
+        Vector3f c;
+        switch (colormap) {
+            case Colormap::Viridis: c = viridis(x); break;
+            case Colormap::Turbo: c = turbo(x); break;
+            default: c = Vector3f(x); break;
+        }
+        for (int j = 0; j < 3; ++j)
+            mLut[4 * i + j] = (uint8_t) std::min(std::max(c[j] * 255.f + 0.5f, 0.f), 255.f);
+        mLut[4 * i + 3] = 255;
+    }
+    mLutDirty = mDirty = true;
+}
+
+void Waterfall::setColormap(const std::vector<Color> &colors) {
+    if (colors.size() < 2)
+        throw std::runtime_error("Waterfall::setColormap(): need at least two colors!");
+    mLut.resize(256 * 4);
+    for (int i = 0; i < 256; ++i) {
+        float pos = i / 255.f * (colors.size() - 1);
+        size_t k = std::min((size_t) pos, colors.size() - 2);
+        float w = pos - k;
+        for (int j = 0; j < 4; ++j) {
+            float value = colors[k][j] * (1 - w) + colors[k + 1][j] * w;
+            mLut[4 * i + j] = (uint8_t) std::min(std::max(value * 255.f + 0.5f, 0.f), 255.f);
+        }
+    }
+    mLutDirty = mDirty = true;
+}
+
+void Waterfall::uploadRows() {
+    mWakeupPending = false;
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mUploading.swap(mPending);
+        mPending.clear();
+    }
+
+    if (mReallocate) {
+        mData.init(Vector2i(mBins, mHistory), GL_R32F, GL_RED, GL_FLOAT);
+        glBindTexture(GL_TEXTURE_2D, mData.id());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        mReallocate = false;
+    }
+
+    /* Write the new rows at the head, in at most two contiguous blocks */
+    int rows = (int) (mUploading.size() / mBins);
+    const float *data = mUploading.data();
+    while (rows > 0) {
+        int count = std::min(rows, mHistory - mHead);
+        mData.update(Vector2i(0, mHead), Vector2i(mBins, count), data);
+        data += (size_t) count * mBins;
+        rows -= count;
+        mHead = (mHead + count) % mHistory;
+        mFilled = std::min(mFilled + count, mHistory);
+        mDirty = true;
+    }
+    mUploading.clear();
+
+    if (mLutDirty) {
+        mLutTexture.init(Vector2i(256, 1), GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, mLut.data());
+        mLutDirty = false;
+    }
+}
+
+void Waterfall::renderHeatmap(NVGcontext *ctx) {
+    if (mOffscreen.prepare(ctx, mSize, screen()->pixelRatio(), NVG_IMAGE_PREMULTIPLIED))
+        mDirty = true;
+
+    uploadRows();
+    if (!mDirty)
+        return;
+
+    if (mShader.name().empty())
+        mShader.init("waterfall", GLOffscreenTarget::fullscreenVertexShader(),
+                     waterfallFragmentShader);
+
+    mOffscreen.begin();
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    mShader.bind();
+    mData.bind(0);
+    mLutTexture.bind(1);
+    mShader.setUniform("data", 0);
+    mShader.setUniform("lut", 1);
+    mShader.setUniform("head", (float) mHead);
+    mShader.setUniform("historyLength", (float) mHistory);
+    mShader.setUniform("filled", (float) mFilled);
+    mShader.setUniform("range", mRange);
+    mShader.setUniform("horizontal", mOrientation == Orientation::Horizontal ? 1 : 0);
+    GLOffscreenTarget::drawFullscreen(mShader);
+    mLutTexture.release(1);
+    mData.release(0);
+    mOffscreen.end();
+
+    mDirty = false;
+}
+
+Vector2i Waterfall::preferredSize(NVGcontext *) {
+    return Vector2i(300, 200);
+}
+
+void Waterfall::draw(NVGcontext *ctx) {
+    Widget::draw(ctx);
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillColor(ctx, mBackgroundColor);
+    nvgFill(ctx);
+
+    renderHeatmap(ctx);
+    NVGpaint paint = mOffscreen.paint(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgFillPaint(ctx, paint);
+    nvgFill(ctx);
+
+    nvgBeginPath(ctx);
+    nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
+    nvgStrokeColor(ctx, Color(100, 255));
+    nvgStroke(ctx);
+}
+
+NAMESPACE_END(nanogui)
@@ -49,27 +49,71 @@ int Widget::fontSize() const {
 }
 
 Vector2i Widget::preferredSize(NVGcontext *ctx){
-    if (mLayout)
+    if (mLayout) {
+        LayoutPass pass;
+        /* Through the previous entry point, so that layouts overriding it
+           are honored; the default forwards to measure() */
         return mLayout->preferredSize(ctx, shared_from_this());
-    else
+    } else {
         return mSize;
+    }
 }
 
 void Widget::performLayout(NVGcontext *ctx) {
+    LayoutPass pass;
     if (mLayout) {
         mLayout->performLayout(ctx, shared_from_this());
     } else {
         for (auto c : mChildren) {
-            Vector2i pref = c->preferredSize(ctx), fix = c->fixedSize();
-            c->setSize(Vector2i(
-                fix[0] ? fix[0] : pref[0],
-                fix[1] ? fix[1] : pref[1]
-            ));
+            c->setSize(c->measure(ctx));
             c->performLayout(ctx);
         }
     }
 }
 
+Vector2i Widget::measure(NVGcontext *ctx, const LayoutConstraints &constraints) {
+    LayoutPass pass;
+    if (mMeasurePass != LayoutPass::current()) {
+        mMeasureCache.clear();
+        mMeasurePass = LayoutPass::current();
+    }
+    for (const auto &entry : mMeasureCache)
+        if (entry.first == constraints)
+            return entry.second;
+
+    /* Subclasses override preferredSize(), which hands the constraints to
+       the layout (if any) through measureConstraints() */
+    const LayoutConstraints *previous = mMeasuring;
+    mMeasuring = &constraints;
+    Vector2i size;
+    try {
+        size = preferredSize(ctx);
+    } catch (...) {
+        mMeasuring = previous;
+        throw;
+    }
+    mMeasuring = previous;
+
+    size = constraints.constrain(size);
+    for (int i = 0; i < 2; ++i)
+        if (mFixedSize[i])
+            size[i] = mFixedSize[i];
+
+    mMeasureCache.emplace_back(constraints, size);
+    return size;
+}
+
+const LayoutConstraints &Widget::measureConstraints() const {
+    static const LayoutConstraints unconstrained;
+    return mMeasuring ? *mMeasuring : unconstrained;
+}
+
+void Widget::arrange(NVGcontext *ctx, const Vector2i &pos, const Vector2i &size) {
+    setPosition(pos);
+    setSize(size);
+    performLayout(ctx);
+}
+
 ref<Widget> Widget::findWidget(const Vector2i &p) {
     for (auto it = mChildren.rbegin(); it != mChildren.rend(); ++it) {
         ref<Widget> child = *it;
@@ -166,6 +210,19 @@ ref<Window> Widget::window() {
     }
 }
 
+ref<Screen> Widget::screen() {
+    ref<Widget> widget = shared_from_this();
+    while (true) {
+        if (!widget)
+            throw std::runtime_error(
+                "Widget:internal error (could not find parent screen)");
+        ref<Screen> screen = dynamic_pointer_cast<Screen>(widget);
+        if (screen)
+            return screen;
+        widget = widget->parent();
+    }
+}
+
 void Widget::requestFocus() {
     ref<Widget> widget = shared_from_this();
     while (widget->parent())